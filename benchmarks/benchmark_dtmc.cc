@@ -0,0 +1,116 @@
+#include "dtmc.hh"
+#include "label_trace.hh"
+#include "markov_random.hh"
+#include "trace_pipeline.hh"
+
+#include <benchmark/benchmark.h>
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+using namespace org::mcss;
+
+namespace {
+
+// range(0) states
+void BM_DtmcNext(benchmark::State &state) {
+  Dtmc dtmc(state.range(0));
+  dtmc.InitRandom();
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(dtmc.Next());
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_DtmcNext)->ArgName("states")->RangeMultiplier(4)->Range(2, 512);
+
+// range(0) outcomes
+void BM_ChooseDirichlet(benchmark::State &state) {
+  MarkovRandom rand(5);
+  Eigen::VectorXd p = rand.RandomStochasticVector(state.range(0));
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(rand.ChooseDirichlet(p));
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_ChooseDirichlet)
+    ->ArgName("outcomes")
+    ->RangeMultiplier(4)
+    ->Range(2, 512);
+
+// range(0) trace length, range(1) alphabet size
+void BM_LabelTraceFromStr(benchmark::State &state) {
+  MarkovRandom rand(5);
+  LabelTrace source;
+  for (int t = 0; t < state.range(0); t++) {
+    source.Append(rand.ChooseUniform(state.range(1)));
+  }
+  auto str = source.ToStr();
+  for (auto _ : state) {
+    LabelTrace trace(str);
+    benchmark::DoNotOptimize(trace.size());
+  }
+  state.SetBytesProcessed(state.iterations() * str.size());
+}
+BENCHMARK(BM_LabelTraceFromStr)
+    ->ArgNames({"T", "alphabet"})
+    ->ArgsProduct({{1 << 10, 1 << 16}, {4, 1000}});
+
+// uniform random states, length long
+LabelTrace RandomStates(const int &state_count, const int &length) {
+  MarkovRandom rand(5);
+  LabelTrace trace;
+  for (int t = 0; t < length; t++) {
+    trace.Append(rand.ChooseUniform(state_count));
+  }
+  return trace;
+}
+
+// range(0) states, mapped onto 4 labels; per-element hash lookups, then a second pass counting transitions
+void BM_MapLabelsUnorderedMap(benchmark::State &state) {
+  auto states = RandomStates(state.range(0), 1 << 16);
+  std::unordered_map<int, int> label;
+  for (int s = 0; s < state.range(0); s++) {
+    label[s] = s % 4;
+  }
+  for (auto _ : state) {
+    LabelTrace out;
+    for (size_t t = 0; t < states.size(); t++) {
+      out.Append(label.at(states[t]));
+    }
+    Eigen::MatrixXd transitions = Eigen::MatrixXd::Zero(4, 4);
+    for (size_t t = 1; t < out.size(); t++) {
+      transitions(out[t - 1], out[t]) += 1;
+    }
+    benchmark::DoNotOptimize(transitions.data());
+  }
+  state.SetItemsProcessed(state.iterations() * states.size());
+}
+BENCHMARK(BM_MapLabelsUnorderedMap)
+    ->ArgName("states")
+    ->RangeMultiplier(16)
+    ->Range(16, 4096);
+
+void BM_TracePipeline(benchmark::State &state) {
+  auto states = RandomStates(state.range(0), 1 << 16);
+  std::vector<int> labels(state.range(0));
+  for (int s = 0; s < state.range(0); s++) {
+    labels[s] = s % 4;
+  }
+  TracePipeline pipeline(labels, 4);
+  LabelTrace out;
+  out.Reserve(states.size());
+  TraceStats stats;
+  for (auto _ : state) {
+    out.Flush();
+    pipeline.Run(states, out, stats);
+    benchmark::DoNotOptimize(stats.transitions().data());
+  }
+  state.SetItemsProcessed(state.iterations() * states.size());
+}
+BENCHMARK(BM_TracePipeline)
+    ->ArgName("states")
+    ->RangeMultiplier(16)
+    ->Range(16, 4096);
+
+} // namespace
@@ -0,0 +1,385 @@
+#include "gaussian_hmm.hh"
+#include "hmm.hh"
+#include "hmm_kernel.hh"
+#include "model_file.hh"
+#include "parametric_hmm.hh"
+
+#include <benchmark/benchmark.h>
+
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <vector>
+
+using namespace org::mcss;
+
+namespace {
+
+// exposes the passes Fit is built from
+class BenchmarkHmm : public Hmm {
+public:
+  using Hmm::Backward;
+  using Hmm::Expectation;
+  using Hmm::Forward;
+  using Hmm::Hmm;
+};
+
+struct Setup {
+  std::unique_ptr<BenchmarkHmm> model;
+  LabelTrace trace;
+  HmmWorkspace ws;
+};
+
+// range(0) states, range(1) alphabet size, range(2) trace length
+std::unique_ptr<Setup> MakeSetup(const benchmark::State &state) {
+  auto setup = std::make_unique<Setup>();
+  setup->model = std::make_unique<BenchmarkHmm>(state.range(0), state.range(1));
+  setup->model->InitRandom();
+  HmmWorkspace sim_ws(17);
+  for (int t = 0; t < state.range(2); t++) {
+    setup->trace.Append(setup->model->Next(sim_ws));
+  }
+  // sizes the workspace buffers
+  setup->model->Posterior(setup->trace, setup->ws);
+  return setup;
+}
+
+void ModelArgs(benchmark::internal::Benchmark *b) {
+  b->ArgNames({"states", "alphabet", "T"})
+      ->ArgsProduct({{2, 8, 32}, {4, 32}, {1 << 10, 1 << 14}});
+}
+
+void BM_HmmForward(benchmark::State &state) {
+  auto setup = MakeSetup(state);
+  for (auto _ : state) {
+    setup->model->Forward(setup->trace, setup->ws);
+    benchmark::DoNotOptimize(setup->ws.scale().data());
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(2));
+}
+BENCHMARK(BM_HmmForward)->Apply(ModelArgs);
+
+void BM_HmmBackward(benchmark::State &state) {
+  auto setup = MakeSetup(state);
+  for (auto _ : state) {
+    setup->model->Backward(setup->trace, setup->ws);
+    benchmark::DoNotOptimize(setup->ws.beta().data());
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(2));
+}
+BENCHMARK(BM_HmmBackward)->Apply(ModelArgs);
+
+void BM_HmmExpectation(benchmark::State &state) {
+  auto setup = MakeSetup(state);
+  for (auto _ : state) {
+    setup->model->Expectation(setup->trace, setup->ws);
+    benchmark::DoNotOptimize(setup->ws.sigma_xi().data());
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(2));
+}
+BENCHMARK(BM_HmmExpectation)->Apply(ModelArgs);
+
+// ten plain baum-welch iterations from the same starting point
+void BM_HmmFit(benchmark::State &state) {
+  auto setup = MakeSetup(state);
+  FitOptions options;
+  options.max_iters = 10;
+  options.eps = 0;
+  for (auto _ : state) {
+    state.PauseTiming();
+    BenchmarkHmm model(*setup->model);
+    state.ResumeTiming();
+    model.Fit(setup->trace, setup->ws, options);
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(2) *
+                          options.max_iters);
+}
+BENCHMARK(BM_HmmFit)
+    ->ArgNames({"states", "alphabet", "T"})
+    ->ArgsProduct({{2, 8}, {4}, {1 << 12}})
+    ->Unit(benchmark::kMillisecond);
+
+// segmented forward-backward, range(3) pool threads = segments
+void BM_HmmPosteriorSegmented(benchmark::State &state) {
+  auto setup = MakeSetup(state);
+  Mylibpp::ThreadPool pool(state.range(3));
+  setup->ws.Parallelize(&pool, state.range(3));
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(
+        setup->model->Posterior(setup->trace, setup->ws).data());
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(2));
+}
+BENCHMARK(BM_HmmPosteriorSegmented)
+    ->ArgNames({"states", "alphabet", "T", "threads"})
+    ->ArgsProduct({{2, 8}, {4}, {1 << 16}, {1, 2, 4, 8}})
+    ->UseRealTime()
+    ->Unit(benchmark::kMillisecond);
+
+// independent posteriors, one per worker, each in a workspace of its own.
+// range(2) is long enough for alpha, beta and gamma to overflow the caches,
+// so this measures memory bandwidth. range(4) pins workers and groups them
+// by NUMA node; range(5) allocates each workspace in on_worker_start, on the
+// worker's node, instead of on the main thread.
+void BM_HmmPosteriorPlacement(benchmark::State &state) {
+  auto setup = MakeSetup(state);
+  const int workers = state.range(3);
+  std::vector<std::unique_ptr<HmmWorkspace>> ws(workers);
+  auto touch = [&setup, &ws](const int &worker) {
+    ws[worker] = std::make_unique<HmmWorkspace>();
+    setup->model->Posterior(setup->trace, *ws[worker]);
+  };
+  Mylibpp::PoolOptions options;
+  options.pool_size = workers;
+  options.pin = options.numa = state.range(4);
+  if (state.range(5)) {
+    options.on_worker_start = [&touch](const int &worker, const int &) {
+      touch(worker);
+    };
+  }
+  Mylibpp::ThreadPool pool(options);
+  if (!state.range(5)) {
+    for (int worker = 0; worker < workers; worker++) {
+      touch(worker);
+    }
+  }
+  std::vector<std::future<void>> done(workers);
+  for (auto _ : state) {
+    for (int worker = 0; worker < workers; worker++) {
+      done[worker] = pool.SubmitTaskOnNode(pool.worker_node(worker), [&]() {
+        auto &own = *ws[Mylibpp::ThreadPool::CurrentWorker()];
+        benchmark::DoNotOptimize(
+            setup->model->Posterior(setup->trace, own).data());
+      });
+    }
+    for (auto &task : done) {
+      task.get();
+    }
+  }
+  // alpha, beta and gamma, each written once and read once
+  state.SetBytesProcessed(state.iterations() * workers * 6 * sizeof(double) *
+                          state.range(0) * state.range(2));
+}
+BENCHMARK(BM_HmmPosteriorPlacement)
+    ->ArgNames({"states", "alphabet", "T", "threads", "pin", "first_touch"})
+    ->ArgsProduct({{8}, {4}, {1 << 17}, {1, 2}, {0, 1}, {0, 1}})
+    ->UseRealTime()
+    ->Unit(benchmark::kMillisecond);
+
+// float against double, same model and trace
+template <typename Scalar>
+void BM_HmmKernelLogLikelihood(benchmark::State &state) {
+  auto setup = MakeSetup(state);
+  HmmKernel<Scalar> kernel(*setup->model);
+  HmmKernelWorkspace<Scalar> ws;
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(kernel.LogLikelihood(setup->trace, ws));
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(2));
+}
+BENCHMARK_TEMPLATE(BM_HmmKernelLogLikelihood, float)->Apply(ModelArgs);
+BENCHMARK_TEMPLATE(BM_HmmKernelLogLikelihood, double)->Apply(ModelArgs);
+
+template <typename Scalar>
+void BM_HmmKernelPosterior(benchmark::State &state) {
+  auto setup = MakeSetup(state);
+  HmmKernel<Scalar> kernel(*setup->model);
+  HmmKernelWorkspace<Scalar> ws;
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(kernel.Posterior(setup->trace, ws).data());
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(2));
+}
+BENCHMARK_TEMPLATE(BM_HmmKernelPosterior, float)->Apply(ModelArgs);
+BENCHMARK_TEMPLATE(BM_HmmKernelPosterior, double)->Apply(ModelArgs);
+
+// BM_HmmFit with the E-step in float, range(3) FitPrecision
+void BM_HmmFitPrecision(benchmark::State &state) {
+  auto setup = MakeSetup(state);
+  FitOptions options;
+  options.max_iters = 10;
+  options.eps = 0;
+  options.precision = static_cast<FitPrecision>(state.range(3));
+  for (auto _ : state) {
+    state.PauseTiming();
+    BenchmarkHmm model(*setup->model);
+    state.ResumeTiming();
+    model.Fit(setup->trace, setup->ws, options);
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(2) *
+                          options.max_iters);
+}
+BENCHMARK(BM_HmmFitPrecision)
+    ->ArgNames({"states", "alphabet", "T", "mixed"})
+    ->ArgsProduct({{2, 32}, {4}, {1 << 12}, {0, 1}})
+    ->Unit(benchmark::kMillisecond);
+
+// the lambda/mu chain of examples/apprx.cc, states 1 and 2 share a label
+bool BuildChain(const Eigen::VectorXd &theta, HmmParameters &value,
+                std::vector<HmmParameters> *jacobian) {
+  value.initial_p << 1, 0, 0;
+  value.transition_p << 1 - theta(0) - theta(1), theta(0), theta(1), theta(2),
+      1 - theta(2), 0, theta(3), 0, 1 - theta(3);
+  value.emission_p << 1, 0, 0, 1, 0, 1;
+  if ((value.transition_p.array() < 0).any()) {
+    return false;
+  }
+  if (jacobian) {
+    auto &d = *jacobian;
+    d[0].transition_p(0, 0) = d[1].transition_p(0, 0) = -1;
+    d[0].transition_p(0, 1) = d[1].transition_p(0, 2) = 1;
+    d[2].transition_p(1, 0) = d[3].transition_p(2, 0) = 1;
+    d[2].transition_p(1, 1) = d[3].transition_p(2, 2) = -1;
+  }
+  return true;
+}
+
+struct ChainSetup {
+  LabelTrace trace;
+  Eigen::VectorXd start = Eigen::Vector4d(0.2, 0.2, 0.3, 0.6);
+  HmmParameters value;
+};
+
+// range(0) trace length
+std::unique_ptr<ChainSetup> MakeChainSetup(const benchmark::State &state) {
+  auto setup = std::make_unique<ChainSetup>();
+  setup->value.Resize(3, 2);
+  BuildChain(Eigen::Vector4d(0.1, 0.3, 0.2, 0.7), setup->value, nullptr);
+  Hmm chain(3, 2, setup->value.initial_p, setup->value.transition_p,
+            setup->value.emission_p);
+  HmmWorkspace sim_ws(17);
+  for (int t = 0; t < state.range(0); t++) {
+    setup->trace.Append(chain.Next(sim_ws));
+  }
+  BuildChain(setup->start, setup->value, nullptr);
+  return setup;
+}
+
+// rates fit directly by L-BFGS, against Baum-Welch over the whole
+// transition matrix from the same start; passes counts forward-backward
+// passes over the trace
+void BM_ChainFitLbfgs(benchmark::State &state) {
+  auto setup = MakeChainSetup(state);
+  ParametricHmm model(3, 2, 4, BuildChain);
+  HmmWorkspace ws;
+  for (auto _ : state) {
+    Eigen::VectorXd theta = setup->start;
+    model.Fit(setup->trace, ws, theta);
+  }
+  state.counters["passes"] = model.evaluations();
+  state.counters["log_likelihood"] = model.log_likelihood();
+}
+BENCHMARK(BM_ChainFitLbfgs)
+    ->ArgName("T")
+    ->Arg(1 << 12)
+    ->Arg(1 << 15)
+    ->Unit(benchmark::kMillisecond);
+
+// range(1) FitAcceleration
+void BM_ChainFitEm(benchmark::State &state) {
+  auto setup = MakeChainSetup(state);
+  FitOptions options;
+  options.max_iters = 5000;
+  options.eps = 1e-6;
+  options.acceleration = static_cast<FitAcceleration>(state.range(1));
+  HmmWorkspace ws;
+  for (auto _ : state) {
+    Hmm model(3, 2, setup->value.initial_p, setup->value.transition_p,
+              setup->value.emission_p);
+    model.Fit(setup->trace, ws, options);
+  }
+  state.counters["passes"] = ws.em_steps();
+  state.counters["log_likelihood"] = ws.log_likelihood();
+}
+BENCHMARK(BM_ChainFitEm)
+    ->ArgNames({"T", "squarem"})
+    ->ArgsProduct({{1 << 12, 1 << 15}, {0, 1}})
+    ->Unit(benchmark::kMillisecond);
+
+class BenchmarkGaussianHmm : public GaussianHmm {
+public:
+  using GaussianHmm::Emission;
+  using GaussianHmm::GaussianHmm;
+};
+
+struct GaussianSetup {
+  std::unique_ptr<BenchmarkGaussianHmm> model;
+  RealTrace trace;
+  GaussianHmmWorkspace ws;
+};
+
+// range(0) states, range(1) mixture components, range(2) dimension,
+// range(3) trace length
+std::unique_ptr<GaussianSetup> MakeGaussianSetup(const benchmark::State &state) {
+  auto setup = std::make_unique<GaussianSetup>();
+  setup->trace = RealTrace(state.range(2));
+  MarkovRandom rand(17);
+  for (int i = 0; i < state.range(2) * state.range(3); i++) {
+    setup->trace.Append(rand.RandomNormal(0, 1));
+  }
+  setup->model = std::make_unique<BenchmarkGaussianHmm>(
+      state.range(0), state.range(2), state.range(1));
+  setup->model->InitRandom(setup->trace);
+  setup->model->Posterior(setup->trace, setup->ws);
+  return setup;
+}
+
+void GaussianArgs(benchmark::internal::Benchmark *b) {
+  b->ArgNames({"states", "components", "dim", "T"})
+      ->ArgsProduct({{2, 8}, {1, 4}, {1, 8}, {1 << 14}});
+}
+
+// log b_j(o_t) for the whole trace
+void BM_GaussianHmmEmission(benchmark::State &state) {
+  auto setup = MakeGaussianSetup(state);
+  for (auto _ : state) {
+    setup->model->Emission(setup->trace, setup->ws);
+    benchmark::DoNotOptimize(setup->ws.log_emission().data());
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(3));
+}
+BENCHMARK(BM_GaussianHmmEmission)->Apply(GaussianArgs);
+
+void BM_GaussianHmmPosterior(benchmark::State &state) {
+  auto setup = MakeGaussianSetup(state);
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(
+        setup->model->Posterior(setup->trace, setup->ws).data());
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(3));
+}
+BENCHMARK(BM_GaussianHmmPosterior)->Apply(GaussianArgs);
+
+// map a saved model and read one transition row, range(0) states
+void BM_ModelFileOpen(benchmark::State &state) {
+  auto path = std::string("benchmark_model_file.bin");
+  Hmm model(state.range(0), 64);
+  model.InitRandom();
+  ModelFile::Save(path, model);
+  for (auto _ : state) {
+    ModelFile file;
+    file.Open(path);
+    benchmark::DoNotOptimize(file.transition_p().row(0).sum());
+  }
+  std::remove(path.c_str());
+}
+BENCHMARK(BM_ModelFileOpen)->ArgName("states")->Arg(64)->Arg(1024);
+
+void BM_ModelFileSampleTransition(benchmark::State &state) {
+  auto path = std::string("benchmark_model_file.bin");
+  Hmm model(state.range(0), 64);
+  model.InitRandom();
+  ModelFile::Save(path, model);
+  ModelFile file;
+  file.Open(path);
+  MarkovRandom rand(17);
+  int s = 0;
+  for (auto _ : state) {
+    s = file.SampleTransition(s, rand);
+    benchmark::DoNotOptimize(s);
+  }
+  std::remove(path.c_str());
+}
+BENCHMARK(BM_ModelFileSampleTransition)->ArgName("states")->Arg(64)->Arg(1024);
+
+} // namespace
@@ -0,0 +1,88 @@
+#include "hmm.hh"
+#include "logger.hh"
+
+#include <benchmark/benchmark.h>
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace org::mcss;
+
+namespace {
+
+Logger &SharedLogger() {
+  static Logger logger("/dev/null");
+  return logger;
+}
+
+// Small model refit in a loop to keep cores busy the way a training run does
+class Trainers {
+private:
+  std::atomic<bool> stop_ = false;
+  std::vector<std::thread> threads_;
+
+public:
+  Trainers(const int &count) {
+    for (int i = 0; i < count; i++) {
+      threads_.emplace_back([this]() {
+        Hmm model(4, 6);
+        model.InitRandom();
+        HmmWorkspace ws;
+        LabelTrace trace;
+        for (int t = 0; t < 2000; t++) {
+          trace.Append(model.Next(ws));
+        }
+        while (!stop_) {
+          model.Fit(trace, ws, 1);
+          SharedLogger().LogInfo("iteration loglik ", ws.log_likelihood());
+        }
+      });
+    }
+  }
+  ~Trainers() {
+    stop_ = true;
+    for (auto &thread : threads_) {
+      thread.join();
+    }
+  }
+};
+
+void BM_LogString(benchmark::State &state) {
+  auto &logger = SharedLogger();
+  std::string mesg = "Loglikelihood: " + std::to_string(-1234.5678);
+  for (auto _ : state) {
+    logger.LogInfo(mesg);
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_LogString)->ThreadRange(1, 8)->UseRealTime();
+
+void BM_LogDeferred(benchmark::State &state) {
+  auto &logger = SharedLogger();
+  int i = 0;
+  for (auto _ : state) {
+    logger.LogInfo("iteration ", i++, " loglik ", -1234.5678, " aic ", 2480.1);
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_LogDeferred)->ThreadRange(1, 8)->UseRealTime();
+
+// ns per log call while range(0) threads run EM iterations and log as well
+void BM_LogDuringFit(benchmark::State &state) {
+  std::unique_ptr<Trainers> trainers;
+  if (state.thread_index() == 0) {
+    trainers = std::make_unique<Trainers>(state.range(0));
+  }
+  auto &logger = SharedLogger();
+  int i = 0;
+  for (auto _ : state) {
+    logger.LogInfo("iteration ", i++, " loglik ", -1234.5678);
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_LogDuringFit)->Arg(1)->Arg(4)->Threads(1)->Threads(4)->UseRealTime();
+
+} // namespace
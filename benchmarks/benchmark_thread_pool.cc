@@ -0,0 +1,42 @@
+#include "my_thread_pool.h"
+
+#include <benchmark/benchmark.h>
+
+#include <future>
+#include <vector>
+
+namespace {
+
+// range(0) pool threads, range(1) tasks per batch
+void BM_SubmitTaskThroughput(benchmark::State &state) {
+  Mylibpp::ThreadPool pool(state.range(0));
+  std::vector<std::future<int>> futures(state.range(1));
+  for (auto _ : state) {
+    for (auto &future : futures) {
+      future = pool.SubmitTask([](const int &i) { return i + 1; }, 1);
+    }
+    for (auto &future : futures) {
+      benchmark::DoNotOptimize(future.get());
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(1));
+}
+BENCHMARK(BM_SubmitTaskThroughput)
+    ->ArgNames({"threads", "tasks"})
+    ->ArgsProduct({{1, 2, 4, 8}, {1000}})
+    ->UseRealTime();
+
+// round trip of a single task, range(0) pool threads
+void BM_SubmitTaskLatency(benchmark::State &state) {
+  Mylibpp::ThreadPool pool(state.range(0));
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(pool.SubmitTask([]() { return 1; }).get());
+  }
+}
+BENCHMARK(BM_SubmitTaskLatency)
+    ->ArgName("threads")
+    ->RangeMultiplier(2)
+    ->Range(1, 8)
+    ->UseRealTime();
+
+} // namespace
@@ -0,0 +1,74 @@
+#!/usr/bin/env python3
+"""Compare two sets of Google Benchmark JSON results.
+
+Usage: compare.py <baseline> <contender> [--threshold PCT] [--metric real_time|cpu_time]
+
+Both arguments may be a single JSON file or a directory of them, as written
+by the benchmark_json target. Prints the relative change per benchmark and
+exits with status 1 if any benchmark got slower by more than the threshold.
+"""
+
+import argparse
+import json
+import os
+import sys
+
+
+def load(path):
+    files = [path]
+    if os.path.isdir(path):
+        files = sorted(
+            os.path.join(path, f) for f in os.listdir(path) if f.endswith(".json")
+        )
+    results = {}
+    for f in files:
+        with open(f) as fp:
+            data = json.load(fp)
+        for bench in data.get("benchmarks", []):
+            # prefer the median when repetitions were aggregated
+            if bench.get("run_type") == "aggregate":
+                if bench.get("aggregate_name") != "median":
+                    continue
+                name = bench["run_name"]
+            else:
+                name = bench["name"]
+            results[name] = bench
+    return results
+
+
+def main():
+    parser = argparse.ArgumentParser()
+    parser.add_argument("baseline")
+    parser.add_argument("contender")
+    parser.add_argument("--threshold", type=float, default=5.0,
+                        help="regression threshold in percent")
+    parser.add_argument("--metric", default="real_time",
+                        choices=["real_time", "cpu_time"])
+    args = parser.parse_args()
+
+    baseline = load(args.baseline)
+    contender = load(args.contender)
+    regressions = 0
+    width = max([len(n) for n in baseline] + [9])
+    print(f"{'Benchmark':<{width}} {'baseline':>12} {'contender':>12} {'change':>8}")
+    for name in sorted(baseline):
+        if name not in contender:
+            print(f"{name:<{width}} {'':>12} {'missing':>12}")
+            continue
+        old = baseline[name][args.metric]
+        new = contender[name][args.metric]
+        unit = baseline[name].get("time_unit", "ns")
+        change = (new - old) / old * 100 if old else 0.0
+        mark = ""
+        if change > args.threshold:
+            mark = "  REGRESSION"
+            regressions += 1
+        print(f"{name:<{width}} {old:>10.1f}{unit} {new:>10.1f}{unit} "
+              f"{change:>+7.1f}%{mark}")
+    for name in sorted(set(contender) - set(baseline)):
+        print(f"{name:<{width}} {'new':>12}")
+    return 1 if regressions else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -1,27 +1,29 @@
+#include <algorithm>
+#include <fstream>
 #include <iterator>
 #include <memory>
 #include <string>
-#include <unordered_map>
+#include <thread>
 
-#include "hmm.h"
-#include "labelled_dtmc.h"
-#include "logger.h"
-#include "trace_file.h"
+#include "birth_death_chain.hh"
+#include "hmm.hh"
+#include "labelled_dtmc.hh"
+#include "logger.hh"
+#include "my_thread_pool.h"
+#include "parametric_hmm.hh"
+#include "sweep.hh"
+#include "trace_file.hh"
+#include "trace_pipeline.hh"
 
 using namespace org::mcss;
 
 static Logger logger;
 
 std::shared_ptr<Dtmc> CreateSampleDtmc(const std::vector<double> &params) {
-  double lambda_1 = params[0];
-  double lambda_2 = params[1];
-  double mu_1 = params[2];
-  double mu_2 = params[3];
-  Eigen::VectorXd init_p(3);
-  init_p << 1.0, 0, 0;
-  Eigen::MatrixXd trans_p(3, 3);
-  trans_p << 1 - (lambda_1 + lambda_2), lambda_1, lambda_2, mu_1, 1 - mu_1, 0,
-      mu_2, 0, 1 - mu_2;
+  Eigen::VectorXd init_p;
+  Eigen::MatrixXd trans_p;
+  BuildBirthDeathTransitions(Eigen::Map<const Eigen::Vector4d>(params.data()),
+                             init_p, trans_p);
   return std::make_shared<Dtmc>(3, init_p, trans_p);
 }
 
@@ -34,17 +36,11 @@ LabelTrace Simulate(std::shared_ptr<Dtmc> model) {
 }
 
 LabelTrace MapLabels(const LabelTrace& trace) {
-  // Map trace of state to label
-  std::unordered_map<int, int> label;
-  label.insert(std::pair<int, int>(0, 0));
-  // state 1 and 2 has the same label
-  label.insert(std::pair<int, int>(1, 1));
-  label.insert(std::pair<int, int>(2, 1));
-  // Make label trace
+  // Map trace of state to label; state 1 and 2 has the same label
+  TracePipeline pipeline({0, 1, 1}, 2);
   LabelTrace new_trace;
-  for (auto i = 0; i < trace.size(); i++) {
-    new_trace.Append(label.at(trace[i]));
-  }
+  TraceStats stats;
+  pipeline.Run(trace, new_trace, stats);
   return new_trace;
 }
 
@@ -60,10 +56,26 @@ std::shared_ptr<Hmm> FitTargetModel(const LabelTrace &trace) {
   label << 1, 0, 0, 1;
   test_model->initial_p(init);
   test_model->emission_p(label);
-  test_model->Fit(trace, 1e-4);
+  HmmWorkspace ws;
+  test_model->Fit(trace, ws, 1000, 1e-4);
   return test_model;
 }
 
+// lambda_1, lambda_2, mu_1, mu_2 fit directly, by L-BFGS on the likelihood
+Eigen::VectorXd FitRates(const LabelTrace &trace) {
+  ParametricHmm model(3, 2, 4, BuildBirthDeathChain);
+  HmmWorkspace ws;
+  // mu_1 != mu_2, states 1 and 2 are interchangeable otherwise
+  Eigen::VectorXd theta = Eigen::Vector4d(0.2, 0.2, 0.3, 0.6);
+  if (!model.Fit(trace, ws, theta)) {
+    logger.LogError("Rates: start outside the domain");
+  }
+  logger.LogInfo("Rates after ", model.evaluations(),
+                 " forward-backward passes, log-likelihood ",
+                 model.log_likelihood());
+  return theta;
+}
+
 void Experiment(const std::vector<double> &params) {
   auto dtmc = CreateSampleDtmc(params);
   logger.LogInfo("Original DTMC: " + dtmc->Str());
@@ -73,6 +85,37 @@ void Experiment(const std::vector<double> &params) {
   logger.LogInfo("Trace to fit: " + label_trace.ToStr());
   auto test_model = FitTargetModel(label_trace);
   logger.LogInfo("HMM after fitting \n" + test_model->Str());
+  auto rates = FitRates(label_trace);
+  logger.LogInfo("Rates fitted directly: lambda_1 ", rates(0), " lambda_2 ",
+                 rates(1), " mu_1 ", rates(2), " mu_2 ", rates(3));
+}
+
+// The experiment above over point_count random parameter vectors, all
+// threads, written to apprx_sweep.csv
+void SweepExperiment(const int &point_count) {
+  auto design = SweepDesign::Random(
+      {"lambda_1", "lambda_2", "mu_1", "mu_2"},
+      Eigen::Vector4d(0.05, 0.05, 0.05, 0.05),
+      Eigen::Vector4d(0.45, 0.45, 0.95, 0.95), point_count, 1);
+  Sweep sweep(
+      3, BuildBirthDeathTransitions, {0, 1, 1},
+      [](MarkovRandom &) -> std::unique_ptr<Hmm> {
+        auto model = std::make_unique<LabelledDtmc>(2, 2, std::vector<int>{0, 1});
+        Eigen::VectorXd init(2);
+        init << 1, 0;
+        model->initial_p(init);
+        model->dtmc().transition_p(Eigen::MatrixXd::Constant(2, 2, 0.5));
+        return model;
+      });
+  SweepOptions options;
+  options.workers = std::max(1u, std::thread::hardware_concurrency());
+  options.fit.max_iters = 1000;
+  options.fit.eps = 1e-4;
+  Mylibpp::ThreadPool pool(options.workers);
+  auto table = sweep.Run(design, options, pool);
+  std::ofstream out("apprx_sweep.csv");
+  table.WriteCsv(out);
+  logger.LogInfo("Swept ", table.rows(), " points into apprx_sweep.csv");
 }
 
 int main(int argc, char *argv[]) {
@@ -80,11 +123,17 @@ int main(int argc, char *argv[]) {
   logger.SetLogFile(log_file);
   logger.LogInfo("Start logging...");
 
+  if (argc > 1 && std::string(argv[1]) == "--sweep") {
+    SweepExperiment(argc > 2 ? std::stoi(argv[2]) : 1000);
+    logger.Dump();
+    return EXIT_SUCCESS;
+  }
+
   std::vector<double> params;
   if (argc == 1) {
     params = std::vector<double>({0.4, 0.5, 0.7, 0.8});
   } else {
-    for (int i = 0; i < argc; i++) {
+    for (int i = 1; i < argc; i++) {
       try {
         params.push_back(std::stod(argv[i]));
       } catch (const std::exception &ex) {
@@ -0,0 +1,48 @@
+#ifndef __BIRTH_DEATH_CHAIN_H__
+#define __BIRTH_DEATH_CHAIN_H__
+
+#include <Eigen/Eigen>
+
+#include <vector>
+
+#include "parametric_hmm.hh"
+
+// The three-state chain apprx.cc approximates, shared with the tests. From
+// state 0 the chain moves to 1 at rate lambda_1 and to 2 at lambda_2, and
+// returns at mu_1 and mu_2; theta = (lambda_1, lambda_2, mu_1, mu_2).
+// States 1 and 2 share a label, labels {0, 1, 1}.
+namespace org::mcss {
+// as a ParametricHmm::Builder over 3 states and 2 labels
+inline bool BuildBirthDeathChain(const Eigen::VectorXd &theta,
+                                 HmmParameters &value,
+                                 std::vector<HmmParameters> *jacobian) {
+  value.initial_p << 1, 0, 0;
+  value.transition_p << 1 - (theta(0) + theta(1)), theta(0), theta(1),
+      theta(2), 1 - theta(2), 0, theta(3), 0, 1 - theta(3);
+  value.emission_p << 1, 0, 0, 1, 0, 1;
+  if ((value.transition_p.array() < 0).any()) {
+    return false;
+  }
+  if (jacobian) {
+    auto &d = *jacobian;
+    d[0].transition_p(0, 0) = d[1].transition_p(0, 0) = -1;
+    d[0].transition_p(0, 1) = d[1].transition_p(0, 2) = 1;
+    d[2].transition_p(1, 0) = d[3].transition_p(2, 0) = 1;
+    d[2].transition_p(1, 1) = d[3].transition_p(2, 2) = -1;
+  }
+  return true;
+}
+
+// the chain alone, as a Sweep::Builder
+inline void BuildBirthDeathTransitions(const Eigen::VectorXd &theta,
+                                       Eigen::VectorXd &initial_p,
+                                       Eigen::MatrixXd &transition_p) {
+  HmmParameters value;
+  value.Resize(3, 2);
+  BuildBirthDeathChain(theta, value, nullptr);
+  initial_p = value.initial_p;
+  transition_p = value.transition_p;
+}
+}  // namespace org::mcss
+
+#endif  // __BIRTH_DEATH_CHAIN_H__
@@ -0,0 +1,145 @@
+#ifndef __LINE_SOCKET_H__
+#define __LINE_SOCKET_H__
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstring>
+#include <string>
+
+// Newline framed request/response over a unix or localhost tcp stream
+// socket, shared by the inference server and its load generator. Every
+// function returns -1 / false on failure and leaves errno set.
+namespace line_socket {
+inline int ListenUnix(const std::string &path) {
+  auto fd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (fd < 0) {
+    return -1;
+  }
+  sockaddr_un addr{};
+  addr.sun_family = AF_UNIX;
+  std::strncpy(addr.sun_path, path.c_str(), sizeof(addr.sun_path) - 1);
+  ::unlink(path.c_str());
+  if (::bind(fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) != 0 ||
+      ::listen(fd, SOMAXCONN) != 0) {
+    ::close(fd);
+    return -1;
+  }
+  return fd;
+}
+
+// loopback only, the server is not meant to be reachable from outside
+inline int ListenTcp(const int &port) {
+  auto fd = ::socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (fd < 0) {
+    return -1;
+  }
+  int on = 1;
+  ::setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+  sockaddr_in addr{};
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(port);
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  if (::bind(fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) != 0 ||
+      ::listen(fd, SOMAXCONN) != 0) {
+    ::close(fd);
+    return -1;
+  }
+  return fd;
+}
+
+inline int ConnectUnix(const std::string &path) {
+  auto fd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (fd < 0) {
+    return -1;
+  }
+  sockaddr_un addr{};
+  addr.sun_family = AF_UNIX;
+  std::strncpy(addr.sun_path, path.c_str(), sizeof(addr.sun_path) - 1);
+  if (::connect(fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) != 0) {
+    ::close(fd);
+    return -1;
+  }
+  return fd;
+}
+
+inline int ConnectTcp(const int &port) {
+  auto fd = ::socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (fd < 0) {
+    return -1;
+  }
+  sockaddr_in addr{};
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(port);
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  if (::connect(fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) != 0) {
+    ::close(fd);
+    return -1;
+  }
+  // one small request at a time, do not wait to coalesce
+  int on = 1;
+  ::setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+  return fd;
+}
+
+inline bool SendAll(const int &fd, const std::string &data) {
+  size_t sent = 0;
+  while (sent < data.size()) {
+    auto n = ::send(fd, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+    if (n < 0 && errno == EINTR) {
+      continue;
+    }
+    if (n <= 0) {
+      return false;
+    }
+    sent += n;
+  }
+  return true;
+}
+
+// Buffered reader handing out one line at a time, without the newline
+class LineReader {
+ private:
+  int fd_;
+  std::string buffer_;
+  size_t begin_ = 0;
+
+ public:
+  static constexpr size_t kMaxLine = 1 << 24;
+
+  explicit LineReader(const int &fd) : fd_(fd) {}
+
+  // false on eof, error, or a line longer than kMaxLine
+  bool ReadLine(std::string &line) {
+    while (true) {
+      auto end = buffer_.find('\n', begin_);
+      if (end != std::string::npos) {
+        line.assign(buffer_, begin_, end - begin_);
+        begin_ = end + 1;
+        return true;
+      }
+      if (buffer_.size() - begin_ > kMaxLine) {
+        return false;
+      }
+      buffer_.erase(0, begin_);
+      begin_ = 0;
+      char chunk[1 << 16];
+      auto n = ::recv(fd_, chunk, sizeof(chunk), 0);
+      if (n < 0 && errno == EINTR) {
+        continue;
+      }
+      if (n <= 0) {
+        return false;
+      }
+      buffer_.append(chunk, n);
+    }
+  }
+};
+}  // namespace line_socket
+
+#endif  // __LINE_SOCKET_H__
@@ -0,0 +1,188 @@
+// Closed-loop load generator for the inference server: every connection
+// sends its next request as soon as the previous one is answered.
+//
+//   loadgen (--unix PATH | --tcp PORT) --model NAME [--op score|decode]
+//           [--connections N] [--requests N] [--length T] [--seed S]
+//
+// Prints client-side qps and p50/p99/max latency, then the server's own
+// counters.
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "label_trace.hh"
+#include "line_socket.hh"
+#include "markov_random.hh"
+
+using namespace org::mcss;
+using Clock = std::chrono::steady_clock;
+
+namespace {
+struct Options {
+  std::string unix_path;
+  int tcp_port = 0;
+  std::string model;
+  std::string op = "score";
+  int connections = 4;
+  int requests = 1000;
+  int length = 256;
+  int seed = 1;
+};
+
+int Connect(const Options &options) {
+  return options.unix_path.empty()
+             ? line_socket::ConnectTcp(options.tcp_port)
+             : line_socket::ConnectUnix(options.unix_path);
+}
+
+// one request and its answer, false if the connection broke
+bool Call(const int &fd, line_socket::LineReader &reader,
+          const std::string &request, std::string &reply) {
+  return line_socket::SendAll(fd, request + "\n") && reader.ReadLine(reply);
+}
+
+void Usage() {
+  std::cerr << "usage: loadgen (--unix PATH | --tcp PORT) --model NAME "
+               "[--op score|decode] [--connections N] [--requests N] "
+               "[--length T] [--seed S]"
+            << std::endl;
+}
+}  // namespace
+
+int main(int argc, char *argv[]) {
+  Options options;
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    if (i + 1 >= argc) {
+      Usage();
+      return EXIT_FAILURE;
+    }
+    std::string value = argv[++i];
+    if (arg == "--unix") {
+      options.unix_path = value;
+    } else if (arg == "--tcp") {
+      options.tcp_port = std::atoi(value.c_str());
+    } else if (arg == "--model") {
+      options.model = value;
+    } else if (arg == "--op") {
+      options.op = value;
+    } else if (arg == "--connections") {
+      options.connections = std::max(1, std::atoi(value.c_str()));
+    } else if (arg == "--requests") {
+      options.requests = std::max(1, std::atoi(value.c_str()));
+    } else if (arg == "--length") {
+      options.length = std::max(1, std::atoi(value.c_str()));
+    } else if (arg == "--seed") {
+      options.seed = std::atoi(value.c_str());
+    } else {
+      Usage();
+      return EXIT_FAILURE;
+    }
+  }
+  if ((options.unix_path.empty() && options.tcp_port == 0) ||
+      options.model.empty()) {
+    Usage();
+    return EXIT_FAILURE;
+  }
+
+  // the alphabet of the model, to draw valid traces
+  int alphabet_count;
+  {
+    auto fd = Connect(options);
+    if (fd < 0) {
+      std::cerr << "cannot connect to the server" << std::endl;
+      return EXIT_FAILURE;
+    }
+    line_socket::LineReader reader(fd);
+    std::string reply, status;
+    int state_count;
+    std::istringstream in;
+    if (!Call(fd, reader, "info " + options.model, reply) ||
+        !(in.str(reply), in >> status >> state_count >> alphabet_count) ||
+        status != "ok") {
+      std::cerr << "server: " << reply << std::endl;
+      return EXIT_FAILURE;
+    }
+    ::close(fd);
+  }
+
+  // a few distinct traces per connection, generated up front
+  static constexpr int kTracesPerConnection = 16;
+  std::vector<std::vector<std::string>> requests(options.connections);
+  MarkovRandom rand(options.seed);
+  for (auto &connection : requests) {
+    for (int k = 0; k < kTracesPerConnection; k++) {
+      LabelTrace trace;
+      for (int t = 0; t < options.length; t++) {
+        trace.Append(rand.ChooseUniform(alphabet_count));
+      }
+      connection.push_back(options.op + " " + options.model + " " +
+                           trace.ToStr());
+    }
+  }
+
+  std::vector<std::vector<double>> latencies_us(options.connections);
+  std::atomic<int> errors = 0;
+  std::vector<std::thread> clients;
+  auto start = Clock::now();
+  for (int c = 0; c < options.connections; c++) {
+    clients.emplace_back([&, c]() {
+      auto fd = Connect(options);
+      if (fd < 0) {
+        errors += options.requests;
+        return;
+      }
+      line_socket::LineReader reader(fd);
+      std::string reply;
+      latencies_us[c].reserve(options.requests);
+      for (int i = 0; i < options.requests; i++) {
+        auto sent = Clock::now();
+        if (!Call(fd, reader, requests[c][i % kTracesPerConnection], reply)) {
+          errors += options.requests - i;
+          break;
+        }
+        latencies_us[c].push_back(
+            std::chrono::duration<double, std::micro>(Clock::now() - sent)
+                .count());
+        if (reply.compare(0, 3, "ok ") != 0) {
+          errors++;
+        }
+      }
+      ::close(fd);
+    });
+  }
+  for (auto &client : clients) {
+    client.join();
+  }
+  auto elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+
+  std::vector<double> all;
+  for (const auto &connection : latencies_us) {
+    all.insert(all.end(), connection.begin(), connection.end());
+  }
+  std::sort(all.begin(), all.end());
+  auto at = [&all](const double &q) {
+    return all.empty() ? 0.0 : all[static_cast<size_t>(q * (all.size() - 1))];
+  };
+  std::cout << "requests " << all.size() << " errors " << errors << std::endl;
+  std::cout << "qps " << all.size() / elapsed << std::endl;
+  std::cout << "latency_us p50 " << at(0.50) << " p99 " << at(0.99) << " max "
+            << at(1.0) << std::endl;
+
+  auto fd = Connect(options);
+  if (fd >= 0) {
+    line_socket::LineReader reader(fd);
+    std::string reply;
+    if (Call(fd, reader, "stats", reply)) {
+      std::cout << "server " << reply << std::endl;
+    }
+    ::close(fd);
+  }
+  return errors == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -2,62 +2,31 @@
 #include <iostream>
 #include <iterator>
 #include <memory>
-#include <unordered_map>
 
-#include "hmm.h"
-#include "logger.h"
+#include "hmm.hh"
+#include "logger.hh"
+#include "trace_corpus.hh"
 
-#define PANIC -1
 #define OK 0
 
 using namespace org::mcss;
 
 static Logger logger;
 
-int ReadTraceFile(const std::string &fpath, int &alphabet_count,
-                  std::string &trace_str) {
-  auto ifs = std::ifstream(fpath);
-  if (ifs.is_open()) {
-    auto line = std::string("");
-    int i = 0;
-    while (std::getline(ifs, line)) {
-      if (i == 0) {
-        alphabet_count = std::stoi(line);
-      } else if (i == 1) {
-        trace_str = line;
-      } else {
-        break;
-      }
-      i++;
-    }
-    return OK;
-  } else {
-    return PANIC;
-  }
-}
-
-int FitKStateModel(const int &state_count, const std::string &trace_file) {
-  int alphabet_count = 0;
-  auto trace_str = std::string("");
-  if (ReadTraceFile(trace_file, alphabet_count, trace_str) != OK) {
-    logger.LogError("Panic: File error " + trace_file);
-    return PANIC;
-  }
-  logger.LogInfo("+++ Hidden states: " + std::to_string(state_count));
-  logger.LogInfo("Using data file to train: " + trace_file);
-  logger.LogInfo("Label count: " + std::to_string(alphabet_count));
-  auto trace = LabelTrace(trace_str);
-  logger.LogInfo("Trace: " + trace.ToStr().substr(0, 10) + "... of size " +
-                 std::to_string(trace.size()));
+int FitKStateModel(const int &state_count, const TraceCorpus &corpus) {
+  logger.LogInfo("+++ Hidden states: ", state_count);
 
-  auto test_model = std::make_unique<Hmm>(state_count, alphabet_count);
-  test_model->InitRandom();
+  auto test_model = std::make_unique<Hmm>(state_count, corpus.alphabet_count());
+  test_model->InitFromCounts(corpus);
   logger.LogInfo("Test model before fitting \n" + test_model->Str());
-  test_model->Fit(trace, 1000, 1e-4);
+  HmmWorkspace ws;
+  FitOptions options;
+  options.eps = 1e-4;
+  test_model->Fit(corpus, ws, options);
   logger.LogInfo("Test model after fitting \n" + test_model->Str());
-  logger.LogInfo("Loglikelihood: " +
-                 std::to_string(test_model->log_likelihood()));
-  logger.LogInfo("AIC: " + std::to_string(test_model->aic()));
+  logger.LogInfo("Iterations: ", ws.last_iter());
+  logger.LogInfo("Loglikelihood: ", ws.log_likelihood());
+  logger.LogInfo("AIC: ", ws.aic());
 
   return OK;
 }
@@ -72,9 +41,18 @@ int main(int argc, char **argv) {
   logger.SetLogFile(log_file);
   logger.LogInfo("Start logging...");
   auto trace_file = std::string(argv[1]);
+  // parsed once, shared by the fits of every state count
+  TraceCorpus corpus;
+  if (!corpus.Load(trace_file)) {
+    logger.LogError("Panic: File error " + trace_file);
+    return EXIT_FAILURE;
+  }
+  logger.LogInfo("Using data file to train: " + trace_file);
+  logger.LogInfo("Label count: ", corpus.alphabet_count());
+  logger.LogInfo("Trace of size ", corpus.size());
   for (int i = 2; i < argc; i++) {
     auto state_count = std::stoi(argv[i]);
-    FitKStateModel(state_count, trace_file);
+    FitKStateModel(state_count, corpus);
   }
 
   return EXIT_SUCCESS;
@@ -1,6 +1,510 @@
+// Local inference daemon: scores and decodes label traces against Hmm
+// models loaded from ModelFile images or generated at random.
+//
+//   server [--unix PATH] [--tcp PORT] [--threads N] [--batch N]
+//          [--log FILE] [--random NAME:STATES:ALPHABET[:SEED]]...
+//          [NAME=MODEL_FILE]...
+//
+// Startup, periodic qps/p50/p99 and shutdown lines go to FILE, server.log
+// by default.
+//
+// One request per line, answered with "ok ..." or "err <reason>":
+//
+//   score <model> <trace>    log-likelihood of the comma separated trace
+//   decode <model> <trace>   viterbi path
+//   info <model>             state and alphabet counts, model version
+//   fit <model> <trace>      refit a copy of the model on the trace and
+//                            swap it in, answers the new version; "err
+//                            model changed" if the model was replaced
+//                            while fitting
+//   reload <model> <file>    swap in the Hmm of a model file
+//   stats                    requests, qps, p50/p99 latency, mean batch
+//
+// Requests for the same model are queued and drained in batches by pool
+// tasks, each worker reusing one thread-local workspace, so a burst against
+// one model costs a single task switch and no allocations per request.
+// Models live in a ModelRegistry: fit and reload publish a new model while
+// traffic continues, batches already running finish on the old one.
+#include <poll.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <csignal>
+#include <cstdlib>
+#include <deque>
+#include <future>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "hmm.hh"
+#include "line_socket.hh"
+#include "logger.hh"
+#include "model_file.hh"
+#include "model_registry.hh"
 #include "my_thread_pool.h"
 
-int main() {
-  Mylibpp::ThreadPool<std::function<void()>> pool(3);
+using namespace org::mcss;
+using Clock = std::chrono::steady_clock;
+
+static Logger logger;
+static std::atomic<bool> stopping = false;
+
+namespace {
+enum class Op { kScore, kDecode };
+
+struct Request {
+  Op op;
+  LabelTrace trace;
+  Clock::time_point arrival;
+  std::promise<std::string> reply;
+};
+
+// Latencies of the last kWindow requests, and totals since start
+class LatencyStats {
+ private:
+  static constexpr size_t kWindow = 1 << 16;
+
+  std::mutex lock_;
+  std::vector<double> window_;
+  size_t next_ = 0;
+  uint64_t count_ = 0;
+  uint64_t batches_ = 0;
+  Clock::time_point start_ = Clock::now();
+
+ public:
+  struct Snapshot {
+    uint64_t count;
+    double elapsed_s;
+    double p50_us;
+    double p99_us;
+    double mean_batch;
+  };
+
+  void Record(const std::vector<double> &latencies_us) {
+    std::lock_guard<std::mutex> guard(lock_);
+    for (const auto &latency : latencies_us) {
+      if (window_.size() < kWindow) {
+        window_.push_back(latency);
+      } else {
+        window_[next_] = latency;
+      }
+      next_ = (next_ + 1) % kWindow;
+    }
+    count_ += latencies_us.size();
+    batches_++;
+  }
+
+  Snapshot Take() {
+    std::vector<double> sorted;
+    Snapshot snapshot{};
+    {
+      std::lock_guard<std::mutex> guard(lock_);
+      sorted = window_;
+      snapshot.count = count_;
+      snapshot.mean_batch = batches_ ? double(count_) / batches_ : 0;
+    }
+    snapshot.elapsed_s =
+        std::chrono::duration<double>(Clock::now() - start_).count();
+    if (!sorted.empty()) {
+      auto at = [&sorted](const double &q) {
+        auto k = static_cast<size_t>(q * (sorted.size() - 1));
+        std::nth_element(sorted.begin(), sorted.begin() + k, sorted.end());
+        return sorted[k];
+      };
+      snapshot.p50_us = at(0.50);
+      snapshot.p99_us = at(0.99);
+    }
+    return snapshot;
+  }
+};
+
+// The queue of pending requests for one model name. Up to max_drainers pool
+// tasks work the queue at once; a new one is started for an idle queue, or
+// when the backlog exceeds one batch per running task. Every batch runs on
+// the model published when it was taken.
+class ModelQueue {
+ private:
+  std::string name_;
+  const ModelRegistry &registry_;
+  std::mutex lock_;
+  std::deque<std::unique_ptr<Request>> pending_;
+  int drainers_ = 0;
+
+ public:
+  ModelQueue(const std::string &name, const ModelRegistry &registry)
+      : name_(name), registry_(registry) {}
+
+  void Submit(std::unique_ptr<Request> request, Mylibpp::ThreadPool &pool,
+              LatencyStats &stats, const int &batch,
+              const int &max_drainers) {
+    bool start;
+    {
+      std::lock_guard<std::mutex> guard(lock_);
+      pending_.push_back(std::move(request));
+      start = drainers_ < max_drainers &&
+              (drainers_ == 0 ||
+               pending_.size() > static_cast<size_t>(drainers_ * batch));
+      if (start) {
+        drainers_++;
+      }
+    }
+    if (start) {
+      pool.SubmitTask([this, &stats, batch]() { Drain(stats, batch); });
+    }
+  }
+
+  void Drain(LatencyStats &stats, const int &batch) {
+    thread_local HmmWorkspace ws;
+    std::vector<std::unique_ptr<Request>> taken;
+    std::vector<double> latencies_us;
+    while (true) {
+      taken.clear();
+      {
+        std::lock_guard<std::mutex> guard(lock_);
+        while (!pending_.empty() && taken.size() < static_cast<size_t>(batch)) {
+          taken.push_back(std::move(pending_.front()));
+          pending_.pop_front();
+        }
+        if (taken.empty()) {
+          drainers_--;
+          return;
+        }
+      }
+      latencies_us.clear();
+      auto snapshot = registry_.Acquire();
+      const auto *model = snapshot.find(name_);
+      for (auto &request : taken) {
+        std::ostringstream reply;
+        reply.precision(17);
+        if (!model) {
+          reply << "err unknown model " << name_;
+        } else if (request->op == Op::kScore) {
+          reply << "ok " << model->LogLikelihood(request->trace, ws);
+        } else {
+          reply << "ok " << model->Decode(request->trace, ws).ToStr();
+        }
+        request->reply.set_value(reply.str());
+        latencies_us.push_back(std::chrono::duration<double, std::micro>(
+                                   Clock::now() - request->arrival)
+                                   .count());
+      }
+      stats.Record(latencies_us);
+    }
+  }
+};
+
+class Server {
+ private:
+  int threads_;
+  int batch_;
+  ModelRegistry registry_;
+  // fixed at startup, the models behind the names change
+  std::map<std::string, std::unique_ptr<ModelQueue>> queues_;
+  LatencyStats stats_;
+
+  // one detached handler thread per connection
+  std::mutex connections_lock_;
+  std::condition_variable connections_closed_;
+  std::set<int> connections_;
+
+  // last, so that its workers are joined before the queues go away
+  Mylibpp::ThreadPool pool_;
+
+  std::string Handle(const std::string &line) {
+    std::istringstream in(line);
+    std::string op, name, trace_str;
+    in >> op >> name >> trace_str;
+    if (op == "stats") {
+      auto s = stats_.Take();
+      std::ostringstream reply;
+      reply << "ok requests=" << s.count << " qps=" << s.count / s.elapsed_s
+            << " p50_us=" << s.p50_us << " p99_us=" << s.p99_us
+            << " mean_batch=" << s.mean_batch;
+      return reply.str();
+    }
+    auto found = queues_.find(name);
+    auto snapshot = registry_.Acquire();
+    const auto *model = snapshot.find(name);
+    if (found == queues_.end() || !model) {
+      return "err unknown model " + name;
+    }
+    if (op == "info") {
+      std::ostringstream reply;
+      reply << "ok " << model->state_count() << " " << model->alphabet_count()
+            << " " << snapshot.version();
+      return reply.str();
+    }
+    if (op == "reload") {
+      return Reload(name, *model, trace_str);
+    }
+    if (op != "score" && op != "decode" && op != "fit") {
+      return "err unknown request " + op;
+    }
+    auto request = std::make_unique<Request>();
+    request->op = op == "score" ? Op::kScore : Op::kDecode;
+    request->trace.FromStr(trace_str);
+    if (request->trace.size() == 0) {
+      return "err empty trace";
+    }
+    for (const auto &label : request->trace.container()) {
+      if (label < 0 || label >= model->alphabet_count()) {
+        return "err label out of range";
+      }
+    }
+    if (op == "fit") {
+      // fit a copy with the snapshot released: holding it for the whole fit
+      // would keep every catalog published meanwhile from being reclaimed
+      auto next = std::make_shared<Hmm>(*model);
+      auto expected = snapshot.version(name);
+      { auto released = std::move(snapshot); }
+      return Refit(name, std::move(next), expected, request->trace);
+    }
+    request->arrival = Clock::now();
+    auto reply = request->reply.get_future();
+    found->second->Submit(std::move(request), pool_, stats_, batch_, threads_);
+    return reply.get();
+  }
+
+  // Refits and reloads run on the connection's thread, off the pool, so
+  // that the drainers keep serving the model being replaced. Replacements
+  // keep the alphabet, traces already checked against it stay valid.
+  // The fit publishes only over the version it started from, a reload or
+  // another fit that came first wins.
+  std::string Refit(const std::string &name, std::shared_ptr<Hmm> next,
+                    const uint64_t &expected, const LabelTrace &trace) {
+    HmmWorkspace ws;
+    FitOptions options;
+    options.max_iters = 100;
+    options.acceleration = FitAcceleration::kSquarem;
+    next->Fit(trace, ws, options);
+    if (!std::isfinite(ws.log_likelihood())) {
+      return "err fit diverged, model kept";
+    }
+    auto version = registry_.Publish(name, next, expected);
+    if (!version) {
+      return "err model changed";
+    }
+    std::ostringstream reply;
+    reply.precision(17);
+    reply << "ok " << version << " " << ws.log_likelihood();
+    return reply.str();
+  }
+
+  std::string Reload(const std::string &name, const Hmm &model,
+                     const std::string &path) {
+    ModelFile file;
+    std::unique_ptr<Hmm> next;
+    if (!file.Open(path) || !(next = file.LoadHmm())) {
+      return "err cannot load an Hmm from " + path;
+    }
+    if (next->alphabet_count() != model.alphabet_count()) {
+      return "err alphabet differs";
+    }
+    return "ok " + std::to_string(registry_.Publish(name, std::move(next)));
+  }
+
+  void Serve(const int &fd) {
+    line_socket::LineReader reader(fd);
+    std::string line;
+    while (!stopping && reader.ReadLine(line)) {
+      if (!line_socket::SendAll(fd, Handle(line) + "\n")) {
+        break;
+      }
+    }
+    std::lock_guard<std::mutex> guard(connections_lock_);
+    connections_.erase(fd);
+    ::close(fd);
+    connections_closed_.notify_all();
+  }
+
+ public:
+  Server(const int &threads, const int &batch)
+      : threads_(threads), batch_(batch), pool_(threads) {}
+
+  void AddModel(const std::string &name, std::unique_ptr<Hmm> model) {
+    logger.LogInfo("Model ", name, ": ", model->state_count(), " states, ",
+                   model->alphabet_count(), " labels");
+    registry_.Publish(name, std::move(model));
+    queues_[name] = std::make_unique<ModelQueue>(name, registry_);
+  }
+
+  // accept on every listening socket until stopping, logging the counters
+  // every ten seconds
+  void Run(const std::vector<int> &listeners) {
+    std::vector<pollfd> fds;
+    for (const auto &fd : listeners) {
+      fds.push_back({fd, POLLIN, 0});
+    }
+    auto last_log = Clock::now();
+    uint64_t last_count = 0;
+    while (!stopping) {
+      auto ready = ::poll(fds.data(), fds.size(), 200);
+      for (size_t i = 0; ready > 0 && i < fds.size(); i++) {
+        if (!(fds[i].revents & POLLIN)) {
+          continue;
+        }
+        auto fd = ::accept4(fds[i].fd, nullptr, nullptr, SOCK_CLOEXEC);
+        if (fd < 0) {
+          continue;
+        }
+        {
+          std::lock_guard<std::mutex> guard(connections_lock_);
+          connections_.insert(fd);
+        }
+        std::thread(&Server::Serve, this, fd).detach();
+      }
+      if (Clock::now() - last_log > std::chrono::seconds(10)) {
+        auto s = stats_.Take();
+        auto interval =
+            std::chrono::duration<double>(Clock::now() - last_log).count();
+        logger.LogInfo("served ", s.count, " qps ",
+                       (s.count - last_count) / interval, " p50_us ", s.p50_us,
+                       " p99_us ", s.p99_us, " mean_batch ", s.mean_batch);
+        last_log = Clock::now();
+        last_count = s.count;
+      }
+    }
+    {
+      std::unique_lock<std::mutex> lock(connections_lock_);
+      for (const auto &fd : connections_) {
+        ::shutdown(fd, SHUT_RDWR);
+      }
+      connections_closed_.wait(lock, [this]() { return connections_.empty(); });
+    }
+    auto s = stats_.Take();
+    logger.LogInfo("Stopped after ", s.count, " requests, p50_us ", s.p50_us,
+                   " p99_us ", s.p99_us);
+  }
+};
+
+// NAME:STATES:ALPHABET[:SEED], the same model every run when seeded
+std::unique_ptr<Hmm> RandomModel(const std::string &spec, std::string &name) {
+  std::istringstream in(spec);
+  std::string field;
+  std::vector<std::string> fields;
+  while (std::getline(in, field, ':')) {
+    fields.push_back(field);
+  }
+  if (fields.size() < 3) {
+    return nullptr;
+  }
+  name = fields[0];
+  auto state_count = std::atoi(fields[1].c_str());
+  auto alphabet_count = std::atoi(fields[2].c_str());
+  if (state_count <= 0 || alphabet_count <= 0) {
+    return nullptr;
+  }
+  auto model = std::make_unique<Hmm>(state_count, alphabet_count);
+  if (fields.size() > 3) {
+    auto seed = std::atoi(fields[3].c_str());
+    model->rand().reset(seed);
+    model->dtmc().rand().reset(seed);
+  }
+  model->InitRandom();
+  return model;
+}
+
+void Usage() {
+  std::cerr << "usage: server [--unix PATH] [--tcp PORT] [--threads N] "
+               "[--batch N] [--log FILE] "
+               "[--random NAME:STATES:ALPHABET[:SEED]]... [NAME=MODEL_FILE]..."
+            << std::endl;
+}
+}  // namespace
+
+int main(int argc, char *argv[]) {
+  std::string unix_path;
+  int tcp_port = 0;
+  int threads = std::max(1u, std::thread::hardware_concurrency());
+  int batch = 32;
+  std::string log_file = "server.log";
+  std::vector<std::pair<std::string, std::unique_ptr<Hmm>>> models;
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    auto value = [&]() { return i + 1 < argc ? std::string(argv[++i]) : ""; };
+    if (arg == "--unix") {
+      unix_path = value();
+    } else if (arg == "--tcp") {
+      tcp_port = std::atoi(value().c_str());
+    } else if (arg == "--threads") {
+      threads = std::max(1, std::atoi(value().c_str()));
+    } else if (arg == "--batch") {
+      batch = std::max(1, std::atoi(value().c_str()));
+    } else if (arg == "--log") {
+      log_file = value();
+    } else if (arg == "--random") {
+      std::string name;
+      auto model = RandomModel(value(), name);
+      if (!model) {
+        Usage();
+        return EXIT_FAILURE;
+      }
+      models.emplace_back(name, std::move(model));
+    } else if (arg.find('=') != std::string::npos) {
+      auto name = arg.substr(0, arg.find('='));
+      auto path = arg.substr(arg.find('=') + 1);
+      ModelFile file;
+      std::unique_ptr<Hmm> model;
+      if (!file.Open(path) || !(model = file.LoadHmm())) {
+        std::cerr << "cannot load an Hmm from " << path << std::endl;
+        return EXIT_FAILURE;
+      }
+      models.emplace_back(name, std::move(model));
+    } else {
+      Usage();
+      return EXIT_FAILURE;
+    }
+  }
+  if ((unix_path.empty() && tcp_port == 0) || models.empty()) {
+    Usage();
+    return EXIT_FAILURE;
+  }
+
+  logger.SetLogFile(log_file);
+
+  std::vector<int> listeners;
+  if (!unix_path.empty()) {
+    auto fd = line_socket::ListenUnix(unix_path);
+    if (fd < 0) {
+      std::cerr << "cannot listen on " << unix_path << std::endl;
+      return EXIT_FAILURE;
+    }
+    listeners.push_back(fd);
+  }
+  if (tcp_port != 0) {
+    auto fd = line_socket::ListenTcp(tcp_port);
+    if (fd < 0) {
+      std::cerr << "cannot listen on port " << tcp_port << std::endl;
+      return EXIT_FAILURE;
+    }
+    listeners.push_back(fd);
+  }
+
+  std::signal(SIGINT, [](int) { stopping = true; });
+  std::signal(SIGTERM, [](int) { stopping = true; });
+
+  Server server(threads, batch);
+  for (auto &[name, model] : models) {
+    server.AddModel(name, std::move(model));
+  }
+  logger.LogInfo("Serving with ", threads, " threads, batches of ", batch);
+  server.Run(listeners);
+  for (const auto &fd : listeners) {
+    ::close(fd);
+  }
+  if (!unix_path.empty()) {
+    ::unlink(unix_path.c_str());
+  }
+  logger.Dump();
   return EXIT_SUCCESS;
-}
\ No newline at end of file
+}
@@ -1,9 +1,9 @@
-#include "hmm.h"
+#include "hmm.hh"
+#include "trace_pipeline.hh"
 #include <fstream>
 #include <iostream>
 #include <iterator>
 #include <memory>
-#include <unordered_map>
 
 using namespace org::mcss;
 
@@ -30,19 +30,14 @@ void GenerateTrace(const std::string &fpath, const int &n_steps) {
   auto orig_dtmc = std::make_shared<Dtmc>(states_count, init_p, transition_p);
   std::cout << "Original DTMC parameters: \n" << orig_dtmc->Str() << std::endl;
 
-  // Map trace of state to label
-  std::unordered_map<int, int> label;
-  label.insert(std::pair<int, int>(0, 0));
-  label.insert(std::pair<int, int>(1, 1));
-  // state 3 and 4 has the same label
-  label.insert(std::pair<int, int>(2, 2));
-  label.insert(std::pair<int, int>(3, 2));
-  // Make label trace
-  LabelTrace rtrace;
+  // Map trace of state to label; state 3 and 4 has the same label
+  TracePipeline pipeline({0, 1, 2, 2}, 3);
+  LabelTrace strace, rtrace;
+  TraceStats stats;
   for (auto i = 0; i < n_steps; i++) {
-    auto s = orig_dtmc->Next();
-    rtrace.Append(label.at(s));
+    strace.Append(orig_dtmc->Next());
   }
+  pipeline.Run(strace, rtrace, stats);
   SaveTrace(fpath, 3, rtrace);
 }
 
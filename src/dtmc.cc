@@ -1,5 +1,8 @@
 #include "dtmc.hh"
 
+#include <unsupported/Eigen/IterativeSolvers>
+
+#include <limits>
 #include <string>
 #include <sstream>
 
@@ -38,7 +41,7 @@ int Dtmc::Next() {
   return current_state_;
 }
 
-std::string Dtmc::Str() {
+std::string Dtmc::Str() const {
   std::stringstream ss;
   ss << "Initial distribution: \n"
      << initial_p_ << std::endl
@@ -46,3 +49,269 @@ std::string Dtmc::Str() {
      << transition_p_ << std::endl;
   return ss.str();
 }
+
+namespace {
+using SparseMatrix = Eigen::SparseMatrix<double>;
+using SparseRowMatrix = Eigen::SparseMatrix<double, Eigen::RowMajor>;
+}  // namespace
+
+Eigen::VectorXd Dtmc::Stationary(const SolverOptions &options,
+                                 SolverStats *stats) const {
+  SolverStats local_stats;
+  auto &st = stats ? *stats : local_stats;
+  st = SolverStats();
+  // column j of P, i.e. the predecessors of j
+  SparseRowMatrix pt = transition_p_.transpose().sparseView();
+  Eigen::VectorXd pi = Eigen::VectorXd::Constant(state_count_, 1.0 / state_count_);
+  Eigen::VectorXd next(state_count_);
+
+  if (options.method == StationaryMethod::kGmres) {
+    // (P^T - I) pi = 0, with the last equation replaced by sum(pi) = 1
+    std::vector<Eigen::Triplet<double>> triplets;
+    for (int j = 0; j < state_count_ - 1; j++) {
+      for (SparseRowMatrix::InnerIterator it(pt, j); it; ++it) {
+        triplets.emplace_back(j, it.col(), it.value());
+      }
+      triplets.emplace_back(j, j, -1.0);
+    }
+    for (int i = 0; i < state_count_; i++) {
+      triplets.emplace_back(state_count_ - 1, i, 1.0);
+    }
+    SparseMatrix a(state_count_, state_count_);
+    a.setFromTriplets(triplets.begin(), triplets.end());
+    Eigen::VectorXd b = Eigen::VectorXd::Zero(state_count_);
+    b(state_count_ - 1) = 1;
+    Eigen::GMRES<SparseMatrix, Eigen::IncompleteLUT<double>> solver;
+    solver.setTolerance(options.tol);
+    solver.setMaxIterations(options.max_iters);
+    solver.compute(a);
+    pi = solver.solveWithGuess(b, pi);
+    pi = pi.cwiseMax(0);
+    pi /= pi.sum();
+    st.iters = solver.iterations();
+    next.noalias() = pt * pi;
+    st.residual = (next - pi).lpNorm<1>();
+    st.converged = st.residual <= options.tol;
+    return pi;
+  }
+
+  for (st.iters = 1; st.iters <= options.max_iters; st.iters++) {
+    if (options.method == StationaryMethod::kPower) {
+      next.noalias() = pt * pi;
+      st.residual = (next - pi).lpNorm<1>();
+      pi = next / next.sum();
+    } else {
+      // pi_j (1 - p_jj) = sum_i!=j pi_i p_ij, in place
+      for (int j = 0; j < state_count_; j++) {
+        auto sum = 0.0;
+        auto diagonal = 0.0;
+        for (SparseRowMatrix::InnerIterator it(pt, j); it; ++it) {
+          if (it.col() == j) {
+            diagonal = it.value();
+          } else {
+            sum += it.value() * pi(it.col());
+          }
+        }
+        if (diagonal < 1) {
+          pi(j) = sum / (1 - diagonal);
+        }
+      }
+      pi /= pi.sum();
+      next.noalias() = pt * pi;
+      st.residual = (next - pi).lpNorm<1>();
+    }
+    if (st.residual <= options.tol) {
+      st.converged = true;
+      break;
+    }
+  }
+  return pi;
+}
+
+Eigen::MatrixXd Dtmc::TransitionPower(const long long &n,
+                                      const double &tol) const {
+  Eigen::MatrixXd result = Eigen::MatrixXd::Identity(state_count_, state_count_);
+  Eigen::MatrixXd base = transition_p_;
+  Eigen::MatrixXd squared(state_count_, state_count_);
+  for (auto k = n; k > 0; k >>= 1) {
+    if (k & 1) {
+      result = result * base;
+    }
+    if (k > 1) {
+      squared.noalias() = base * base;
+      if (tol > 0 && (squared - base).cwiseAbs().maxCoeff() < tol) {
+        // further powers stay at the limit
+        result = result * squared;
+        break;
+      }
+      base.swap(squared);
+    }
+  }
+  return result;
+}
+
+Eigen::VectorXd Dtmc::Transient(const long long &n, const double &tol) const {
+  return Transient(initial_p_, n, tol);
+}
+
+Eigen::VectorXd Dtmc::Transient(const Eigen::VectorXd &p0, const long long &n,
+                                const double &tol) const {
+  if (n < state_count_) {
+    // n vector steps are cheaper than log(n) matrix products
+    Eigen::VectorXd p = p0;
+    for (long long k = 0; k < n; k++) {
+      p = transition_p_.transpose() * p;
+    }
+    return p;
+  }
+  return TransitionPower(n, tol).transpose() * p0;
+}
+
+std::vector<int> Dtmc::AbsorbingStates() const {
+  std::vector<int> absorbing;
+  for (int i = 0; i < state_count_; i++) {
+    if (transition_p_(i, i) == 1.0) {
+      absorbing.push_back(i);
+    }
+  }
+  return absorbing;
+}
+
+std::vector<bool> Dtmc::CanReach(const std::vector<int> &target) const {
+  std::vector<bool> reach(state_count_, false);
+  std::vector<int> frontier;
+  for (const auto &s : target) {
+    reach[s] = true;
+    frontier.push_back(s);
+  }
+  while (!frontier.empty()) {
+    auto j = frontier.back();
+    frontier.pop_back();
+    for (int i = 0; i < state_count_; i++) {
+      if (!reach[i] && transition_p_(i, j) > 0) {
+        reach[i] = true;
+        frontier.push_back(i);
+      }
+    }
+  }
+  return reach;
+}
+
+Eigen::MatrixXd Dtmc::SolveRestricted(const std::vector<int> &subset,
+                                      const Eigen::MatrixXd &rhs) const {
+  int n = subset.size();
+  std::vector<int> index(state_count_, -1);
+  for (int k = 0; k < n; k++) {
+    index[subset[k]] = k;
+  }
+  std::vector<Eigen::Triplet<double>> triplets;
+  for (int k = 0; k < n; k++) {
+    triplets.emplace_back(k, k, 1.0);
+    for (int j = 0; j < state_count_; j++) {
+      auto p = transition_p_(subset[k], j);
+      if (p != 0 && index[j] >= 0) {
+        triplets.emplace_back(k, index[j], -p);
+      }
+    }
+  }
+  SparseMatrix a(n, n);
+  a.setFromTriplets(triplets.begin(), triplets.end());
+  Eigen::SparseLU<SparseMatrix> solver;
+  solver.compute(a);
+  return solver.solve(rhs);
+}
+
+Eigen::VectorXd Dtmc::HittingProbabilities(const std::vector<int> &target) const {
+  auto reach = CanReach(target);
+  std::vector<bool> in_target(state_count_, false);
+  for (const auto &s : target) {
+    in_target[s] = true;
+  }
+  std::vector<int> transient;
+  for (int i = 0; i < state_count_; i++) {
+    if (reach[i] && !in_target[i]) {
+      transient.push_back(i);
+    }
+  }
+  // h = P_tt h + P_t,target 1 on states that may still reach the target
+  Eigen::VectorXd rhs = Eigen::VectorXd::Zero(transient.size());
+  for (int k = 0; k < transient.size(); k++) {
+    for (const auto &s : target) {
+      rhs(k) += transition_p_(transient[k], s);
+    }
+  }
+  Eigen::VectorXd h = Eigen::VectorXd::Zero(state_count_);
+  for (const auto &s : target) {
+    h(s) = 1;
+  }
+  if (!transient.empty()) {
+    Eigen::VectorXd x = SolveRestricted(transient, rhs);
+    for (int k = 0; k < transient.size(); k++) {
+      h(transient[k]) = x(k);
+    }
+  }
+  return h;
+}
+
+Eigen::VectorXd Dtmc::HittingTimes(const std::vector<int> &target) const {
+  static constexpr double kSureEps = 1e-10;
+  auto probability = HittingProbabilities(target);
+  std::vector<bool> in_target(state_count_, false);
+  for (const auto &s : target) {
+    in_target[s] = true;
+  }
+  std::vector<int> sure;
+  Eigen::VectorXd k =
+      Eigen::VectorXd::Constant(state_count_, std::numeric_limits<double>::infinity());
+  for (int i = 0; i < state_count_; i++) {
+    if (in_target[i]) {
+      k(i) = 0;
+    } else if (probability(i) >= 1 - kSureEps) {
+      sure.push_back(i);
+    }
+  }
+  // k = 1 + P_ss k, states hitting the target surely only move among
+  // themselves and the target
+  if (!sure.empty()) {
+    Eigen::VectorXd x =
+        SolveRestricted(sure, Eigen::VectorXd::Ones(sure.size()));
+    for (int i = 0; i < sure.size(); i++) {
+      k(sure[i]) = x(i);
+    }
+  }
+  return k;
+}
+
+Eigen::MatrixXd Dtmc::AbsorptionProbabilities() const {
+  auto absorbing = AbsorbingStates();
+  auto reach = CanReach(absorbing);
+  std::vector<bool> is_absorbing(state_count_, false);
+  for (const auto &s : absorbing) {
+    is_absorbing[s] = true;
+  }
+  std::vector<int> transient;
+  for (int i = 0; i < state_count_; i++) {
+    if (reach[i] && !is_absorbing[i]) {
+      transient.push_back(i);
+    }
+  }
+  Eigen::MatrixXd b = Eigen::MatrixXd::Zero(state_count_, absorbing.size());
+  for (int a = 0; a < absorbing.size(); a++) {
+    b(absorbing[a], a) = 1;
+  }
+  if (transient.empty()) {
+    return b;
+  }
+  // B = (I - Q)^-1 R, one factorisation for all absorbing states
+  Eigen::MatrixXd r(transient.size(), absorbing.size());
+  for (int k = 0; k < transient.size(); k++) {
+    for (int a = 0; a < absorbing.size(); a++) {
+      r(k, a) = transition_p_(transient[k], absorbing[a]);
+    }
+  }
+  Eigen::MatrixXd x = SolveRestricted(transient, r);
+  for (int k = 0; k < transient.size(); k++) {
+    b.row(transient[k]) = x.row(k);
+  }
+  return b;
+}
@@ -1,11 +1,27 @@
 #ifndef __DTMC_H__
 #define __DTMC_H__
 
-#include "markov.h"
-#include "markov_random.h"
+#include "markov.hh"
+#include "markov_random.hh"
 #include <string>
+#include <vector>
 
 namespace org::mcss {
+enum class StationaryMethod { kPower, kGaussSeidel, kGmres };
+
+struct SolverOptions {
+  // stop when the L1 residual |pi P - pi| falls below tol
+  double tol = 1e-12;
+  int max_iters = 10000;
+  StationaryMethod method = StationaryMethod::kGaussSeidel;
+};
+
+struct SolverStats {
+  int iters = 0;
+  double residual = 0;
+  bool converged = false;
+};
+
 class Dtmc : public Markov {
 private:
   MarkovRandom rand_;
@@ -19,23 +35,52 @@ private:
 
 protected:
   int Jump();
+  // states with a path into target, target included
+  std::vector<bool> CanReach(const std::vector<int> &target) const;
+  // solve (I - P restricted to subset) x = rhs
+  Eigen::MatrixXd SolveRestricted(const std::vector<int> &subset,
+                                  const Eigen::MatrixXd &rhs) const;
 
 public:
   Dtmc(int state_count);
   Dtmc(int state_count, const Eigen::VectorXd &initial_p,
        const Eigen::MatrixXd &transition_p);
-  std::string Str();
+  std::string Str() const;
   void InitRandom();
 
   // markov trace stream
   int Next() override;
 
-  const int &state_count() { return state_count_; }
+  // Analysis. The iterative solvers work on a sparse copy of the transition
+  // matrix. Power iteration needs an aperiodic chain; Gauss-Seidel and GMRES
+  // need an irreducible one for the answer to be unique.
+  Eigen::VectorXd Stationary(const SolverOptions &options = SolverOptions(),
+                             SolverStats *stats = nullptr) const;
+  // P^n by repeated squaring, stops early once the power has converged to
+  // within tol (max abs change of one squaring); tol = 0 disables that
+  Eigen::MatrixXd TransitionPower(const long long &n,
+                                  const double &tol = 0) const;
+  // distribution after n steps from the initial distribution
+  Eigen::VectorXd Transient(const long long &n, const double &tol = 0) const;
+  Eigen::VectorXd Transient(const Eigen::VectorXd &p0, const long long &n,
+                            const double &tol = 0) const;
+  std::vector<int> AbsorbingStates() const;
+  // probability of ever reaching any state of target, from every state
+  Eigen::VectorXd HittingProbabilities(const std::vector<int> &target) const;
+  // expected steps to reach target, infinity where it is not reached almost
+  // surely, 0 on target
+  Eigen::VectorXd HittingTimes(const std::vector<int> &target) const;
+  // row i: probability of being absorbed in each of AbsorbingStates()
+  Eigen::MatrixXd AbsorptionProbabilities() const;
+
+  // drives InitRandom and Next
+  MarkovRandom &rand() { return rand_; }
+  const int &state_count() const { return state_count_; }
   void state_count(const int &c) { state_count_ = c; }
-  const Eigen::VectorXd &initial_p() { return initial_p_; }
+  const Eigen::VectorXd &initial_p() const { return initial_p_; }
   void initial_p(const Eigen::VectorXd &v) { initial_p_ = v; }
-  const Eigen::MatrixXd &transition_p() { return transition_p_; };
-  void transition_p(const Eigen::VectorXd &m) { transition_p_ = m; }
+  const Eigen::MatrixXd &transition_p() const { return transition_p_; };
+  void transition_p(const Eigen::MatrixXd &m) { transition_p_ = m; }
   const int &current_state() override { return current_state_; };
   const int &previous_state() override { return previous_state_; };
 };
@@ -0,0 +1,298 @@
+#include "gaussian_hmm.hh"
+
+#include <cmath>
+#include <limits>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "scaled_passes.hh"
+
+using namespace org::mcss;
+
+namespace {
+// emission likelihoods, or their logs, one column per time step; see
+// scaled_passes.hh
+struct EmissionColumns {
+  const Eigen::MatrixXd &emission;
+  auto operator()(const int &t) const { return emission.col(t); }
+};
+}  // namespace
+
+GaussianHmm::GaussianHmm(const int &state_count, const int &dimension,
+                         const int &component_count)
+    : dtmc_(state_count), dimension_(dimension),
+      component_count_(component_count) {
+  weight_ = Eigen::MatrixXd::Constant(state_count, component_count,
+                                      1.0 / component_count);
+  mean_ = Eigen::MatrixXd::Zero(dimension, state_count * component_count);
+  variance_ = Eigen::MatrixXd::Ones(dimension, state_count * component_count);
+}
+
+GaussianHmm::GaussianHmm(const Eigen::VectorXd &initial_p,
+                         const Eigen::MatrixXd &transition_p,
+                         const Eigen::MatrixXd &weight,
+                         const Eigen::MatrixXd &mean,
+                         const Eigen::MatrixXd &variance)
+    : dtmc_(initial_p.size(), initial_p, transition_p),
+      dimension_(mean.rows()), component_count_(weight.cols()) {
+  weight_ = weight;
+  mean_ = mean;
+  variance_ = variance;
+}
+
+std::string GaussianHmm::Str() const {
+  std::stringstream ss;
+  ss << dtmc_.Str() << std::endl;
+  ss << "Dimension: " << dimension_ << std::endl;
+  ss << "Mixture weights: \n" << weight_ << std::endl;
+  ss << "Means: \n" << mean_ << std::endl;
+  ss << "Variances: \n" << variance_ << std::endl;
+  return ss.str();
+}
+
+// Simulate trace
+Eigen::VectorXf GaussianHmm::Next(GaussianHmmWorkspace &ws) const {
+  int state;
+  if (ws.current_state_ == GaussianHmmWorkspace::kBeginState) {
+    state = ws.rand_.ChooseDirichlet(dtmc_.initial_p());
+  } else {
+    state = ws.rand_.ChooseDirichlet(
+        dtmc_.transition_p().row(ws.current_state_).transpose());
+  }
+  ws.current_state_ = state;
+  auto k = state * component_count_ +
+           ws.rand_.ChooseDirichlet(weight_.row(state).transpose());
+  Eigen::VectorXf frame(dimension_);
+  for (int d = 0; d < dimension_; d++) {
+    frame(d) = ws.rand_.RandomNormal(mean_(d, k), std::sqrt(variance_(d, k)));
+  }
+  return frame;
+}
+
+void GaussianHmm::InitRandom(const RealTrace &observation) {
+  dtmc_.InitRandom();
+  auto state_count = dtmc_.state_count();
+  auto T = observation.size();
+  weight_ = rand_.RandomStochasticMatrix(state_count, component_count_);
+  Eigen::MatrixXd frames = observation.matrix().cast<double>();
+  Eigen::VectorXd center = frames.rowwise().mean();
+  Eigen::VectorXd spread =
+      ((frames.colwise() - center).rowwise().squaredNorm() / T)
+          .cwiseMax(kMinVariance);
+  for (int k = 0; k < state_count * component_count_; k++) {
+    mean_.col(k) = frames.col(rand_.ChooseUniform(T));
+    variance_.col(k) = spread;
+  }
+}
+
+// With precision Q = 1 / variance, the exponent of every component at every
+// frame is -(Q^T (o .* o) - 2 (Q .* mean)^T o + sum(Q .* mean^2)) / 2, i.e.
+// two (components x dimension) * (dimension x T) products. The mixture of
+// each state is then reduced with a column-wise log-sum-exp.
+void GaussianHmm::Emission(const RealTrace &observation,
+                           GaussianHmmWorkspace &ws) const {
+  static const double kLog2Pi = std::log(2 * M_PI);
+  auto state_count = dtmc_.state_count();
+  auto M = component_count_;
+  auto &frames = ws.frames_;
+  auto &log_density = ws.log_density_;
+  auto &log_emission = ws.log_emission_;
+
+  frames = observation.matrix().cast<double>();
+  ws.squares_ = frames.cwiseAbs2();
+  Eigen::MatrixXd precision = variance_.cwiseInverse();
+  Eigen::MatrixXd weighted_mean = precision.cwiseProduct(mean_);
+  Eigen::VectorXd log_norm =
+      weight_.transpose().reshaped().array().log() -
+      0.5 * (dimension_ * kLog2Pi + variance_.array().log().colwise().sum() +
+             weighted_mean.cwiseProduct(mean_).colwise().sum().array())
+                .transpose();
+  log_density.noalias() = -0.5 * precision.transpose() * ws.squares_;
+  log_density.noalias() += weighted_mean.transpose() * frames;
+  log_density.colwise() += log_norm;
+
+  if (M == 1) {
+    log_emission = log_density;
+  } else {
+    for (int j = 0; j < state_count; j++) {
+      auto components = log_density.middleRows(j * M, M);
+      Eigen::RowVectorXd top = components.colwise().maxCoeff();
+      log_emission.row(j) =
+          top.array() + (components.rowwise() - top)
+                            .array()
+                            .exp()
+                            .colwise()
+                            .sum()
+                            .log();
+    }
+  }
+  ws.offset_ = log_emission.colwise().maxCoeff().transpose();
+  ws.emission_ =
+      (log_emission.rowwise() - ws.offset_.transpose()).array().exp();
+}
+
+// Scaled forward pass on the shifted emissions, see scaled_passes.hh;
+// log P(O) = sum_t log(scale_t) + offset_t
+void GaussianHmm::Forward(GaussianHmmWorkspace &ws) const {
+  ScaledForward(dtmc_.initial_p(), dtmc_.transition_p(),
+                EmissionColumns{ws.emission_}, 0, ws.emission_.cols(),
+                ws.weight_, ws.alpha_, ws.scale_);
+}
+
+// Backward pass scaled with the forward factors
+void GaussianHmm::Backward(GaussianHmmWorkspace &ws) const {
+  auto T = ws.emission_.cols();
+  // basis step
+  ws.beta_.col(T - 1).setOnes();
+  ScaledBackward(dtmc_.transition_p(), EmissionColumns{ws.emission_},
+                 ws.scale_, 0, T, ws.beta_, ws.weight_);
+}
+
+const Eigen::MatrixXd &GaussianHmm::Posterior(const RealTrace &observation,
+                                              GaussianHmmWorkspace &ws) const {
+  auto T = observation.size();
+  ws.Reserve(state_count(), component_count_, dimension_, T);
+  Emission(observation, ws);
+  Forward(ws);
+  Backward(ws);
+  ws.gamma_ = ws.alpha_.cwiseProduct(ws.beta_);
+  ws.gamma_ = ws.gamma_.array().rowwise() / ws.gamma_.colwise().sum().array();
+  return ws.gamma_;
+}
+
+double GaussianHmm::LogLikelihood(const RealTrace &observation,
+                                  GaussianHmmWorkspace &ws) const {
+  auto T = observation.size();
+  ws.Reserve(state_count(), component_count_, dimension_, T);
+  Emission(observation, ws);
+  Forward(ws);
+  ws.log_likelihood_ = ws.scale_.array().log().sum() + ws.offset_.sum();
+  return ws.log_likelihood_;
+}
+
+// Transition counts, plus the posterior of every
+// mixture component: gamma_j(t) w_jm N_jm(o_t) / b_j(o_t)
+void GaussianHmm::Expectation(const RealTrace &observation,
+                              GaussianHmmWorkspace &ws) const {
+  auto T = observation.size();
+  auto state_count = this->state_count();
+  auto M = component_count_;
+
+  Posterior(observation, ws);
+  auto &sigma_xi = ws.sigma_xi_;
+  TransitionCounts(EmissionColumns{ws.emission_}, ws.alpha_, ws.beta_,
+                   ws.scale_, 0, T - 1, ws.weight_, sigma_xi);
+  sigma_xi = sigma_xi.cwiseProduct(dtmc_.transition_p());
+
+  auto &responsibility = ws.responsibility_;
+  if (M == 1) {
+    responsibility = ws.gamma_;
+    return;
+  }
+  responsibility.resize(state_count * M, T);
+  for (int j = 0; j < state_count; j++) {
+    responsibility.middleRows(j * M, M) =
+        (ws.log_density_.middleRows(j * M, M).rowwise() -
+         ws.log_emission_.row(j))
+            .array()
+            .exp()
+            .rowwise() *
+        ws.gamma_.row(j).array();
+  }
+}
+
+double GaussianHmm::Maximization(const RealTrace &observation,
+                                 GaussianHmmWorkspace &ws) {
+  auto T = observation.size();
+  auto state_count = this->state_count();
+  auto M = component_count_;
+  const auto &gamma = ws.gamma_;
+  const auto &responsibility = ws.responsibility_;
+
+  Eigen::VectorXd new_initial = gamma.rowwise().sum() / T;
+  Eigen::MatrixXd new_transition =
+      ws.sigma_xi_.array().colwise() / ws.sigma_xi_.rowwise().sum().array();
+
+  Eigen::VectorXd occupancy = responsibility.rowwise().sum();
+  Eigen::MatrixXd new_weight =
+      Eigen::Map<const Eigen::MatrixXd>(occupancy.data(), M, state_count)
+          .transpose();
+  new_weight = new_weight.array().colwise() / gamma.rowwise().sum().array();
+  Eigen::MatrixXd new_mean = ws.frames_ * responsibility.transpose();
+  Eigen::MatrixXd new_variance = ws.squares_ * responsibility.transpose();
+  for (int k = 0; k < state_count * M; k++) {
+    if (occupancy(k) > 0) {
+      new_mean.col(k) /= occupancy(k);
+      new_variance.col(k) = (new_variance.col(k) / occupancy(k) -
+                             new_mean.col(k).cwiseAbs2())
+                                .cwiseMax(kMinVariance);
+    } else {
+      new_mean.col(k) = mean_.col(k);
+      new_variance.col(k) = variance_.col(k);
+    }
+  }
+
+  auto norm_diff = 0.0;
+  norm_diff += (new_initial - dtmc_.initial_p()).norm();
+  norm_diff += (new_transition - dtmc_.transition_p()).norm();
+  norm_diff += (new_weight - weight_).norm();
+  norm_diff += (new_mean - mean_).norm();
+  norm_diff += (new_variance - variance_).norm();
+
+  dtmc_.initial_p(new_initial);
+  dtmc_.transition_p(new_transition);
+  weight_ = new_weight;
+  mean_ = new_mean;
+  variance_ = new_variance;
+
+  return norm_diff;
+}
+
+void GaussianHmm::Fit(const RealTrace &observation, GaussianHmmWorkspace &ws,
+                      const int &max_iters, const double &eps) {
+  FitOptions options;
+  options.max_iters = max_iters;
+  options.eps = eps;
+  Fit(observation, ws, options);
+}
+
+bool GaussianHmm::Fit(const RealTrace &observation, GaussianHmmWorkspace &ws,
+                      const FitOptions &options) {
+  if (options.acceleration != FitAcceleration::kNone ||
+      options.precision != FitPrecision::kDouble) {
+    return false;
+  }
+  auto previous_ll = -std::numeric_limits<double>::infinity();
+  ws.last_iter_ = 0;
+  for (int i = 0; i < options.max_iters; ws.last_iter_ = ++i) {
+    Expectation(observation, ws);
+    ws.log_likelihood_ = ws.scale_.array().log().sum() + ws.offset_.sum();
+    auto norm_diff = Maximization(observation, ws);
+    FitIteration iteration;
+    iteration.iter = i + 1;
+    iteration.em_steps = 1;
+    iteration.log_likelihood = ws.log_likelihood_;
+    iteration.param_delta = norm_diff;
+    if (!ObserveIteration(options, iteration) || norm_diff <= options.eps ||
+        (options.log_likelihood_eps > 0 &&
+         ws.log_likelihood_ - previous_ll < options.log_likelihood_eps)) {
+      ws.last_iter_ = i + 1;
+      break;
+    }
+    previous_ll = ws.log_likelihood_;
+  }
+  LogLikelihood(observation, ws);
+  return true;
+}
+
+// Observation explanation: viterbi, in log space
+LabelTrace GaussianHmm::Decode(const RealTrace &observation,
+                               GaussianHmmWorkspace &ws) const {
+  auto T = observation.size();
+  ws.Reserve(state_count(), component_count_, dimension_, T);
+  Emission(observation, ws);
+  return ViterbiPath(dtmc_.initial_p(), dtmc_.transition_p(),
+                     EmissionColumns{ws.log_emission_}, T, ws.log_transition_,
+                     ws.delta_, ws.psi_);
+}
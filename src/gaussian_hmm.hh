@@ -0,0 +1,167 @@
+#ifndef __GAUSSIAN_HMM_H__
+#define __GAUSSIAN_HMM_H__
+
+#include <Eigen/Eigen>
+
+#include <string>
+
+#include "dtmc.hh"
+#include "hmm.hh"
+#include "label_trace.hh"
+#include "markov_random.hh"
+#include "real_trace.hh"
+
+namespace org::mcss {
+class GaussianHmm;
+
+// Caller-owned inference state for GaussianHmm, see HmmWorkspace.
+class GaussianHmmWorkspace {
+ private:
+  static const int kBeginState = -1;
+
+  MarkovRandom rand_;
+  int current_state_ = kBeginState;
+
+  // observations in double, and squared, dimension x T
+  Eigen::MatrixXd frames_;
+  Eigen::MatrixXd squares_;
+  // log w_jm N(o_t; mean_jm, variance_jm), row j * M + m
+  Eigen::MatrixXd log_density_;
+  // log b_j(o_t)
+  Eigen::MatrixXd log_emission_;
+  // b_j(o_t) / exp(offset_t), offset_t being the largest log b_j(o_t), so
+  // that the forward pass never sees all states underflow
+  Eigen::MatrixXd emission_;
+  Eigen::VectorXd offset_;
+  // posterior of state and mixture component, like log_density_
+  Eigen::MatrixXd responsibility_;
+
+  Eigen::MatrixXd alpha_;
+  Eigen::MatrixXd beta_;
+  Eigen::MatrixXd gamma_;
+  Eigen::MatrixXd sigma_xi_;
+  Eigen::VectorXd scale_;
+  Eigen::VectorXd weight_;
+
+  // viterbi
+  Eigen::MatrixXd log_transition_;
+  Eigen::MatrixXd delta_;
+  Eigen::MatrixXi psi_;
+
+  double log_likelihood_ = 0;
+  int last_iter_ = 0;
+
+  friend class GaussianHmm;
+
+ protected:
+  void Reserve(const int &state_count, const int &component_count,
+               const int &dimension, const int &T) {
+    frames_.resize(dimension, T);
+    squares_.resize(dimension, T);
+    log_density_.resize(state_count * component_count, T);
+    log_emission_.resize(state_count, T);
+    emission_.resize(state_count, T);
+    offset_.resize(T);
+    alpha_.resize(state_count, T);
+    beta_.resize(state_count, T);
+    gamma_.resize(state_count, T);
+    sigma_xi_.resize(state_count, state_count);
+    scale_.resize(T);
+    weight_.resize(state_count);
+  }
+
+ public:
+  GaussianHmmWorkspace() {}
+  GaussianHmmWorkspace(int seed) : rand_(seed) {}
+
+  void Reset() { current_state_ = kBeginState; }
+
+  const Eigen::MatrixXd &gamma() const { return gamma_; }
+  const Eigen::MatrixXd &log_emission() const { return log_emission_; }
+  const double &log_likelihood() const { return log_likelihood_; }
+  const int &last_iter() const { return last_iter_; }
+  const int &current_state() const { return current_state_; }
+};
+
+// Hmm over real-valued observation frames. Every state emits from a mixture
+// of component_count gaussians with diagonal covariance; one component is a
+// plain diagonal gaussian. Component j * component_count + m is mixture
+// component m of state j.
+class GaussianHmm {
+ private:
+  MarkovRandom rand_;
+
+  Dtmc dtmc_;
+  int dimension_;
+  int component_count_;
+  // mixture weights, state x component
+  Eigen::MatrixXd weight_;
+  // dimension x (state * component)
+  Eigen::MatrixXd mean_;
+  Eigen::MatrixXd variance_;
+
+  static constexpr int kMaxIters = 1000;
+  static constexpr double kEps = 1e-5;
+  // variance floor, keeps a component from collapsing onto one frame
+  static constexpr double kMinVariance = 1e-6;
+
+ protected:
+  // log b_j(o_t) for the whole trace as two matrix products
+  void Emission(const RealTrace &observation, GaussianHmmWorkspace &ws) const;
+  void Forward(GaussianHmmWorkspace &ws) const;
+  void Backward(GaussianHmmWorkspace &ws) const;
+  void Expectation(const RealTrace &observation,
+                   GaussianHmmWorkspace &ws) const;
+  double Maximization(const RealTrace &observation, GaussianHmmWorkspace &ws);
+
+ public:
+  GaussianHmm(const int &state_count, const int &dimension,
+              const int &component_count = 1);
+  GaussianHmm(const Eigen::VectorXd &p0, const Eigen::MatrixXd &p,
+              const Eigen::MatrixXd &weight, const Eigen::MatrixXd &mean,
+              const Eigen::MatrixXd &variance);
+
+  std::string Str() const;
+
+  // simulation
+  Eigen::VectorXf Next(GaussianHmmWorkspace &ws) const;
+
+  // random chain and weights, means drawn from the observed frames and
+  // variances set to the variance of the observation
+  void InitRandom(const RealTrace &observation);
+
+  // Likelihood estimation: forward-backward algorithm
+  const Eigen::MatrixXd &Posterior(const RealTrace &observation,
+                                   GaussianHmmWorkspace &ws) const;
+  double LogLikelihood(const RealTrace &observation,
+                       GaussianHmmWorkspace &ws) const;
+
+  // Parameter estimation: baum-welch
+  void Fit(const RealTrace &observation, GaussianHmmWorkspace &ws,
+           const int &max_iters = kMaxIters, const double &eps = kEps);
+  // Plain EM only: false, and nothing fitted, for kSquarem or kMixed. The
+  // observer gets every iteration without phase timings.
+  bool Fit(const RealTrace &observation, GaussianHmmWorkspace &ws,
+           const FitOptions &options);
+
+  // Observation explanation: viterbi
+  LabelTrace Decode(const RealTrace &observation,
+                    GaussianHmmWorkspace &ws) const;
+
+  // getter
+  Dtmc &dtmc() { return dtmc_; }
+  const Dtmc &dtmc() const { return dtmc_; }
+  const int &state_count() const { return dtmc_.state_count(); }
+  const int &dimension() const { return dimension_; }
+  const int &component_count() const { return component_count_; }
+  const Eigen::MatrixXd &weight() const { return weight_; }
+  const Eigen::MatrixXd &mean() const { return mean_; }
+  const Eigen::MatrixXd &variance() const { return variance_; }
+  void weight(const Eigen::MatrixXd &m) { weight_ = m; }
+  void mean(const Eigen::MatrixXd &m) { mean_ = m; }
+  void variance(const Eigen::MatrixXd &m) { variance_ = m; }
+  void initial_p(const Eigen::VectorXd &pi) { dtmc_.initial_p(pi); }
+};
+}  // namespace org::mcss
+
+#endif  // __GAUSSIAN_HMM_H__
@@ -1,11 +1,19 @@
 #include "hmm.hh"
 
+#include <algorithm>
 #include <cmath>
+#include <functional>
+#include <future>
+#include <limits>
 #include <sstream>
 #include <iostream>
 #include <string>
+#include <numeric>
 #include <vector>
 
+#include "scaled_passes.hh"
+#include "trace_corpus.hh"
+
 using namespace org::mcss;
 
 Hmm::Hmm(const int &states_size, const int &alphabet_count)
@@ -21,7 +29,7 @@ Hmm::Hmm(const int &state_count, const int &alphabet_count,
   emission_p_ = emission_p;
 }
 
-std::string Hmm::Str() {
+std::string Hmm::Str() const {
   std::stringstream ss;
   ss << dtmc_.Str() << std::endl;
   ss << "Observation cardinality: " << alphabet_count_ << std::endl;
@@ -30,57 +38,194 @@ std::string Hmm::Str() {
 }
 
 // Simulate trace
-int Hmm::Next() {
-  int state = dtmc_.Next();
-  int observation = rand_.ChooseDirichlet(emission_p_.row(state));
-  return observation;
+int Hmm::Next(HmmWorkspace &ws) const {
+  int state;
+  if (ws.current_state_ == HmmWorkspace::kBeginState) {
+    state = ws.rand_.ChooseDirichlet(dtmc_.initial_p());
+  } else {
+    state = ws.rand_.ChooseDirichlet(
+        dtmc_.transition_p().row(ws.current_state_).transpose());
+  }
+  ws.current_state_ = state;
+  ws.previous_obs_ = ws.current_obs_;
+  ws.current_obs_ = ws.rand_.ChooseDirichlet(emission_p_.row(state).transpose());
+  return ws.current_obs_;
+}
+
+namespace {
+// Run f and add its wall time to elapsed, unless elapsed is null
+template <typename TFunc>
+void Timed(std::chrono::nanoseconds *elapsed, TFunc &&f) {
+#ifndef MCSS_NO_FIT_OBSERVER
+  if (elapsed) {
+    auto start = std::chrono::steady_clock::now();
+    f();
+    *elapsed += std::chrono::steady_clock::now() - start;
+    return;
+  }
+#endif
+  f();
+}
+
+// iteration record to fill in, null without an observer
+FitIteration *Probe(const FitOptions &options, FitIteration &iteration) {
+#ifndef MCSS_NO_FIT_OBSERVER
+  if (options.observer) {
+    return &iteration;
+  }
+#endif
+  return nullptr;
 }
 
-void Hmm::Forward(const LabelTrace &observation) {
+// Run f(k, begin, end) for every time segment on pool and wait.
+void RunSegments(Mylibpp::ThreadPool &pool, const int &segment_count,
+                 const std::vector<int> &bounds,
+                 const std::function<void(int, int, int)> &f) {
+  std::vector<std::future<void>> futures;
+  futures.reserve(segment_count);
+  for (int k = 0; k < segment_count; k++) {
+    futures.push_back(pool.SubmitTask(
+        [&f, &bounds, k]() { f(k, bounds[k], bounds[k + 1]); }));
+  }
+  for (auto &future : futures) {
+    future.get();
+  }
+}
+
+// emission likelihoods of a discrete trace, see scaled_passes.hh
+struct DiscreteEmission {
+  const Eigen::MatrixXd &emission_p;
+  const LabelTrace &observation;
+  auto operator()(const int &t) const {
+    return emission_p.col(observation[t]);
+  }
+};
+
+struct DiscreteLogEmission {
+  const Eigen::MatrixXd &emission_p;
+  const LabelTrace &observation;
+  auto operator()(const int &t) const {
+    return emission_p.col(observation[t]).array().log().matrix();
+  }
+};
+}  // namespace
+
+void Hmm::ForwardRange(const LabelTrace &observation, HmmWorkspace &ws,
+                       const int &begin, const int &end,
+                       const Eigen::VectorXd &entry) const {
+  ScaledForward(dtmc_.initial_p(), dtmc_.transition_p(),
+                DiscreteEmission{emission_p_, observation}, begin, end, entry,
+                ws.alpha_, ws.scale_);
+}
+
+void Hmm::BackwardRange(const LabelTrace &observation, HmmWorkspace &ws,
+                        const int &begin, const int &end,
+                        Eigen::VectorXd &weight) const {
+  ScaledBackward(dtmc_.transition_p(),
+                 DiscreteEmission{emission_p_, observation}, ws.scale_, begin,
+                 end, ws.beta_, weight);
+}
+
+// Product of P * diag(b(o_t)) over t in [begin, end), normalised to sum one.
+// alpha_end-1 is proportional to alpha_begin-1 * transfer, and beta_begin-1
+// to transfer * beta_end-1.
+void Hmm::SegmentTransfer(const LabelTrace &observation, const int &begin,
+                          const int &end, Eigen::MatrixXd &transfer,
+                          double &log_norm) const {
+  const auto &transition_p = dtmc_.transition_p();
+  Eigen::MatrixXd product(transfer.rows(), transfer.cols());
+  transfer = transition_p * emission_p_.col(observation[begin]).asDiagonal();
+  log_norm = std::log(transfer.sum());
+  transfer /= transfer.sum();
+  for (int t = begin + 1; t < end; t++) {
+    product.noalias() = transfer * transition_p;
+    transfer.noalias() =
+        product * emission_p_.col(observation[t]).asDiagonal();
+    auto norm = transfer.sum();
+    log_norm += std::log(norm);
+    transfer /= norm;
+  }
+}
+
+void Hmm::Forward(const LabelTrace &observation, HmmWorkspace &ws) const {
   auto T = observation.size();
-  auto state_count = dtmc_.state_count();
-  alpha_.resize(state_count, T);
-  alpha_.setZero();
-  // basis step
-  alpha_.col(0) =
-      dtmc_.initial_p().cwiseProduct(emission_p_.col(observation[0]));
-  alpha_.col(0) = alpha_.col(0) / alpha_.col(0).sum();
-  // inductive step
-  for (int t = 1; t < T; t++) {
-    alpha_.col(t) = alpha_.col(t - 1).transpose() * dtmc_.transition_p();
-    alpha_.col(t) = alpha_.col(t).cwiseProduct(emission_p_.col(observation[t]));
-    alpha_.col(t) = alpha_.col(t) / alpha_.col(t).sum();
+  if (!ws.Segmented(T)) {
+    ForwardRange(observation, ws, 0, T, ws.weight_);
+    return;
+  }
+  auto K = ws.segment_count_;
+  auto bounds = ws.SegmentBounds(T);
+  // transfer matrices of all segments, the first one starts after the basis
+  RunSegments(*ws.pool_, K, bounds, [&](int k, int begin, int end) {
+    SegmentTransfer(observation, std::max(begin, 1), end, ws.transfer_[k],
+                    ws.transfer_log_norm_[k]);
+  });
+  // prefix scan for alpha right before each segment
+  auto &alpha_0 = ws.segment_entry_[0];
+  alpha_0 = dtmc_.initial_p().cwiseProduct(emission_p_.col(observation[0]));
+  alpha_0 /= alpha_0.sum();
+  for (int k = 1; k < K; k++) {
+    auto &entry = ws.segment_entry_[k];
+    entry.noalias() = ws.transfer_[k - 1].transpose() * ws.segment_entry_[k - 1];
+    entry /= entry.sum();
   }
+  RunSegments(*ws.pool_, K, bounds, [&](int k, int begin, int end) {
+    ForwardRange(observation, ws, begin, end, ws.segment_entry_[k]);
+  });
 }
 
-void Hmm::Backward(const LabelTrace &observation) {
+void Hmm::Backward(const LabelTrace &observation, HmmWorkspace &ws) const {
   auto T = observation.size();
-  auto state_count = dtmc_.state_count();
-  beta_.resize(state_count, T);
-  beta_.setZero();
-  // basis step
-  beta_.col(T - 1).setConstant(1 / emission_p_.col(observation[T - 1]).sum());
-  // inductive step
-  for (int t = T - 2; t >= 0; t--) {
-    beta_.col(t) =
-        beta_.col(t + 1).cwiseProduct(emission_p_.col(observation[t + 1]));
-    beta_.col(t) = (dtmc_.transition_p() * beta_.col(t)).transpose();
-    auto sum = beta_.col(t).cwiseProduct(emission_p_.col(observation[t])).sum();
-    beta_.col(t) = beta_.col(t) / sum;
+  if (!ws.Segmented(T)) {
+    // basis step
+    ws.beta_.col(T - 1).setOnes();
+    BackwardRange(observation, ws, 0, T, ws.weight_);
+    return;
+  }
+  auto K = ws.segment_count_;
+  auto bounds = ws.SegmentBounds(T);
+  // suffix scan for beta at the end of each segment, rescaled with the
+  // forward factors of the following segment
+  ws.segment_exit_[K - 1].setOnes();
+  for (int k = K - 2; k >= 0; k--) {
+    auto begin = bounds[k + 1];
+    auto end = bounds[k + 2];
+    auto log_scale = ws.scale_.segment(begin, end - begin).array().log().sum();
+    auto &exit = ws.segment_exit_[k];
+    exit.noalias() = ws.transfer_[k + 1] * ws.segment_exit_[k + 1];
+    exit *= std::exp(ws.transfer_log_norm_[k + 1] - log_scale);
+  }
+  RunSegments(*ws.pool_, K, bounds, [&](int k, int begin, int end) {
+    ws.beta_.col(end - 1) = ws.segment_exit_[k];
+    BackwardRange(observation, ws, begin, end, ws.segment_weight_[k]);
+  });
+}
+
+void Hmm::PosteriorRange(HmmWorkspace &ws, const int &begin,
+                         const int &end) const {
+  auto &gamma = ws.gamma_;
+  for (int t = begin; t < end; t++) {
+    gamma.col(t) = ws.alpha_.col(t).cwiseProduct(ws.beta_.col(t));
+    gamma.col(t) /= gamma.col(t).sum();
   }
 }
 
-const Eigen::MatrixXd &Hmm::Posterior(const LabelTrace &observation) {
+const Eigen::MatrixXd &Hmm::Posterior(const LabelTrace &observation,
+                                      HmmWorkspace &ws) const {
   auto T = observation.size();
-  auto state_count = dtmc_.state_count();
-  gamma_ = Eigen::MatrixXd(state_count, T);
-  Forward(observation);
-  Backward(observation);
-  for (int t = 0; t < T; t++) {
-    gamma_.col(t) = alpha_.col(t).cwiseProduct(beta_.col(t));
-    gamma_.col(t) = gamma_.col(t) / gamma_.col(t).sum();
+  ws.Reserve(dtmc_.state_count(), T);
+  Forward(observation, ws);
+  Backward(observation, ws);
+  if (ws.Segmented(T)) {
+    auto K = ws.segment_count_;
+    RunSegments(*ws.pool_, K, ws.SegmentBounds(T),
+                [&](int, int begin, int end) {
+                  PosteriorRange(ws, begin, end);
+                });
+  } else {
+    PosteriorRange(ws, 0, T);
   }
-  return gamma_;
+  return ws.gamma_;
 }
 
 void Hmm::InitRandom() {
@@ -89,21 +234,214 @@ void Hmm::InitRandom() {
       rand_.RandomStochasticMatrix(dtmc_.state_count(), alphabet_count_);
 }
 
-void Hmm::Expectation(const LabelTrace &observation) {
-  auto T = observation.size();
+namespace {
+// Weighted k-means of the rows of points into k clusters, seeded farthest
+// first from the heaviest point; cluster[i] of every row
+std::vector<int> Cluster(const Eigen::MatrixXd &points,
+                         const Eigen::VectorXd &weights, const int &k) {
+  static constexpr int kMaxIters = 50;
+  auto n = points.rows();
+  Eigen::MatrixXd centers(k, points.cols());
+  Eigen::Index heaviest;
+  weights.maxCoeff(&heaviest);
+  centers.row(0) = points.row(heaviest);
+  Eigen::VectorXd distance =
+      (points.rowwise() - centers.row(0)).rowwise().squaredNorm();
+  for (int c = 1; c < k; c++) {
+    Eigen::Index farthest;
+    distance.cwiseProduct(weights).maxCoeff(&farthest);
+    centers.row(c) = points.row(farthest);
+    distance = distance.cwiseMin(
+        (points.rowwise() - centers.row(c)).rowwise().squaredNorm());
+  }
+  std::vector<int> cluster(n, -1);
+  for (int iter = 0; iter < kMaxIters; iter++) {
+    auto changed = false;
+    for (int i = 0; i < n; i++) {
+      int nearest;
+      (centers.rowwise() - points.row(i)).rowwise().squaredNorm().minCoeff(
+          &nearest);
+      changed |= nearest != cluster[i];
+      cluster[i] = nearest;
+    }
+    if (!changed) {
+      break;
+    }
+    Eigen::VectorXd mass = Eigen::VectorXd::Zero(k);
+    centers.setZero();
+    for (int i = 0; i < n; i++) {
+      centers.row(cluster[i]) += weights(i) * points.row(i);
+      mass(cluster[i]) += weights(i);
+    }
+    for (int c = 0; c < k; c++) {
+      if (mass(c) > 0) {
+        centers.row(c) /= mass(c);
+      }
+    }
+  }
+  return cluster;
+}
+}  // namespace
+
+bool Hmm::InitFromCounts(const TraceCorpus &corpus) {
+  // share of the emission and transition mass spread over everything, so
+  // that EM can still move it
+  static constexpr double kSmoothing = 0.1;
+  static constexpr double kPerturbation = 0.1;
+  if (corpus.alphabet_count() != alphabet_count_) {
+    return false;
+  }
+  auto state_count = dtmc_.state_count();
+  auto alphabet_count = alphabet_count_;
+  const auto &counts = corpus.symbol_counts();
+  const auto &bigrams = corpus.transitions();
+  auto clusters = std::min(state_count, alphabet_count);
+
+  // successor and predecessor distributions of every symbol
+  Eigen::MatrixXd profile = Eigen::MatrixXd::Zero(alphabet_count,
+                                                  2 * alphabet_count);
+  Eigen::VectorXd out = bigrams.rowwise().sum();
+  Eigen::VectorXd in = bigrams.colwise().sum().transpose();
+  for (int o = 0; o < alphabet_count; o++) {
+    if (out(o) > 0) {
+      profile.row(o).head(alphabet_count) = bigrams.row(o) / out(o);
+    }
+    if (in(o) > 0) {
+      profile.row(o).tail(alphabet_count) = bigrams.col(o).transpose() / in(o);
+    }
+  }
+  auto cluster = Cluster(profile, counts, clusters);
+
+  // state s belongs to cluster s % clusters
+  Eigen::VectorXd frequency = counts / counts.sum();
+  Eigen::VectorXd cluster_mass = Eigen::VectorXd::Zero(clusters);
+  Eigen::MatrixXd cluster_bigrams = Eigen::MatrixXd::Zero(clusters, clusters);
+  std::vector<int> states_of_cluster(clusters, 0);
+  for (int o = 0; o < alphabet_count; o++) {
+    cluster_mass(cluster[o]) += counts(o);
+    for (int p = 0; p < alphabet_count; p++) {
+      cluster_bigrams(cluster[o], cluster[p]) += bigrams(o, p);
+    }
+  }
+  for (int s = 0; s < state_count; s++) {
+    states_of_cluster[s % clusters]++;
+  }
+
+  auto perturbed = [this](const double &x) {
+    return x * (1 + kPerturbation * rand_.RandomProbUniform());
+  };
+  Eigen::VectorXd initial(state_count);
+  Eigen::MatrixXd transition(state_count, state_count);
+  Eigen::MatrixXd emission(state_count, alphabet_count);
+  for (int s = 0; s < state_count; s++) {
+    auto c = s % clusters;
+    initial(s) = perturbed(cluster_mass(c) / states_of_cluster[c] +
+                           kSmoothing * counts.sum() / state_count);
+    auto row_mass = cluster_bigrams.row(c).sum();
+    for (int r = 0; r < state_count; r++) {
+      auto d = r % clusters;
+      transition(s, r) = perturbed(
+          (1 - kSmoothing) * cluster_bigrams(c, d) /
+              std::max(row_mass, 1.0) / states_of_cluster[d] +
+          kSmoothing / state_count);
+    }
+    for (int o = 0; o < alphabet_count; o++) {
+      emission(s, o) = perturbed(
+          (cluster[o] == c
+               ? (1 - kSmoothing) * counts(o) / std::max(cluster_mass(c), 1.0)
+               : 0) +
+          kSmoothing * frequency(o));
+    }
+  }
+  initial /= initial.sum();
+  transition = transition.array().colwise() / transition.rowwise().sum().array();
+  emission = emission.array().colwise() / emission.rowwise().sum().array();
+  UpdateParams(initial, transition, emission);
+  return true;
+}
+
+// xi_t = P .* (alpha_t * (b(o_t+1) .* beta_t+1)^T) / scale_t+1, summed over
+// t in [begin, end) as rank-one updates. The caller masks by P once.
+void Hmm::SigmaXiRange(const LabelTrace &observation, HmmWorkspace &ws,
+                       const int &begin, const int &end,
+                       Eigen::VectorXd &weight,
+                       Eigen::MatrixXd &sigma_xi) const {
+  TransitionCounts(DiscreteEmission{emission_p_, observation}, ws.alpha_,
+                   ws.beta_, ws.scale_, begin, end, weight, sigma_xi);
+}
+
+void Hmm::SigmaXi(const LabelTrace &observation, HmmWorkspace &ws,
+                  Eigen::MatrixXd &sigma_xi) const {
+  int T = observation.size();
+  if (ws.Segmented(T)) {
+    auto K = ws.segment_count_;
+    RunSegments(*ws.pool_, K, ws.SegmentBounds(T),
+                [&](int k, int begin, int end) {
+                  SigmaXiRange(observation, ws, begin, std::min(end, T - 1),
+                               ws.segment_weight_[k],
+                               ws.segment_sigma_xi_[k]);
+                });
+    sigma_xi = ws.segment_sigma_xi_[0];
+    for (int k = 1; k < K; k++) {
+      sigma_xi += ws.segment_sigma_xi_[k];
+    }
+  } else {
+    SigmaXiRange(observation, ws, 0, T - 1, ws.weight_, sigma_xi);
+  }
+}
+
+double Hmm::Expectation(const LabelTrace &observation,
+                        HmmWorkspace &ws) const {
+  int T = observation.size();
+  if (ws.mixed_precision_) {
+    ws.mixed_kernel_.Assign(dtmc_.initial_p(), dtmc_.transition_p(),
+                            emission_p_);
+    ws.gamma_.resize(dtmc_.state_count(), T);
+    ws.sigma_xi_.resize(dtmc_.state_count(), dtmc_.state_count());
+    return ws.mixed_kernel_.Expectation(observation, ws.mixed_ws_, ws.gamma_,
+                                        ws.sigma_xi_);
+  }
+
+  Posterior(observation, ws);
+  auto &sigma_xi = ws.sigma_xi_;
+  SigmaXi(observation, ws, sigma_xi);
+  sigma_xi = sigma_xi.cwiseProduct(dtmc_.transition_p());
+  return ws.scale_.head(T).array().log().sum();
+}
+
+double Hmm::LogLikelihoodGradient(const LabelTrace &observation,
+                                  HmmWorkspace &ws) const {
+  // With the scaled passes, alpha_t beta_t is the posterior of state t and
+  // d log P(O) / dx is what P(O) gains per unit of x along the paths through
+  // it: the transition gradient is sigma_xi before the product with P, the
+  // emission gradient of b_j(o) is sum over o_t = o of the posterior with
+  // b_j(o_t) left out, and likewise for the initial distribution. Written
+  // this way no entry is divided by, so zero entries get a gradient too.
+  int T = observation.size();
   auto state_count = dtmc_.state_count();
+  const auto &initial_p = dtmc_.initial_p();
+  const auto &transition_p = dtmc_.transition_p();
+  ws.Reserve(state_count, T);
+  Forward(observation, ws);
+  Backward(observation, ws);
+  ws.grad_transition_.resize(state_count, state_count);
+  SigmaXi(observation, ws, ws.grad_transition_);
 
-  Posterior(observation);
-  sigma_xi_.resize(state_count, state_count);
-  sigma_xi_.setZero();
-  for (int t = 0; t < T - 1; t++) {
-    auto xi = Eigen::MatrixXd(dtmc_.transition_p());
-    xi = xi.array().colwise() * alpha_.col(t).array();
-    xi = xi.array().colwise() * emission_p_.col(observation[t + 1]).array();
-    xi = xi.array().rowwise() * beta_.col(t + 1).transpose().array();
-    xi = xi / xi.sum();
-    sigma_xi_ += xi;
+  const auto &beta = ws.beta_;
+  const auto &scale = ws.scale_;
+  auto &weight = ws.weight_;
+  ws.grad_initial_ = emission_p_.col(observation[0]).cwiseProduct(
+                         beta.col(0)) /
+                     scale(0);
+  ws.grad_emission_.setZero(state_count, alphabet_count_);
+  ws.grad_emission_.col(observation[0]) =
+      initial_p.cwiseProduct(beta.col(0)) / scale(0);
+  for (int t = 1; t < T; t++) {
+    weight.noalias() = transition_p.transpose() * ws.alpha_.col(t - 1);
+    ws.grad_emission_.col(observation[t]) +=
+        weight.cwiseProduct(beta.col(t)) / scale(t);
   }
+  return scale.head(T).array().log().sum();
 }
 
 double Hmm::UpdateParams(const Eigen::VectorXd &new_initial,
@@ -121,66 +459,289 @@ double Hmm::UpdateParams(const Eigen::VectorXd &new_initial,
   return norm_diff;
 }
 
-void Hmm::Evaluate(const LabelTrace &observation)
-{
+void Hmm::Evaluate(const LabelTrace &observation, HmmWorkspace &ws) const {
   auto T = observation.size();
   auto state_count = dtmc_.state_count();
-  alpha_.resize(state_count, T);
-  alpha_.setZero();
-  // basis step
-  alpha_.col(0) =
-      dtmc_.initial_p().cwiseProduct(emission_p_.col(observation[0]));
-  alpha_.col(0) = alpha_.col(0) / alpha_.col(0).sum();
-  // inductive step
-  for (int t = 1; t < T; t++) {
-    alpha_.col(t) = alpha_.col(t - 1).transpose() * dtmc_.transition_p();
-    alpha_.col(t) = alpha_.col(t).cwiseProduct(emission_p_.col(observation[t]));
-    if (t == T - 1) {
-      break;
-    }
-    alpha_.col(t) = alpha_.col(t) / alpha_.col(t).sum();
+  ws.Reserve(state_count, T);
+  Forward(observation, ws);
+  Score(ws, ws.scale_.head(T).array().log().sum());
+}
+
+double Hmm::StepLogLikelihood(const LabelTrace &observation,
+                              HmmWorkspace &ws) const {
+  if (!ws.mixed_precision_) {
+    Evaluate(observation, ws);
+    return ws.log_likelihood_;
   }
-  log_likelihood_ = log(alpha_.col(T - 1).sum());
-  auto param_count =
-      state_count * state_count + state_count * alphabet_count_ + state_count;
-  aic_ = -2 * log_likelihood_ + 2 * param_count;
+  ws.mixed_kernel_.Assign(dtmc_.initial_p(), dtmc_.transition_p(),
+                          emission_p_);
+  return ws.mixed_kernel_.LogLikelihood(observation, ws.mixed_ws_);
+}
+
+double Hmm::LogLikelihood(const LabelTrace &observation,
+                          HmmWorkspace &ws) const {
+  Evaluate(observation, ws);
+  return ws.log_likelihood_;
 }
 
-double Hmm::Maximization(const LabelTrace &observation) {
+int Hmm::ParamCount() const {
+  auto state_count = dtmc_.state_count();
+  return state_count * state_count + state_count * alphabet_count_ +
+         state_count;
+}
+
+void Hmm::Score(HmmWorkspace &ws, const double &log_likelihood) const {
+  ws.log_likelihood_ = log_likelihood;
+  ws.aic_ = -2 * log_likelihood + 2 * ParamCount();
+}
+
+void Hmm::FitResult(HmmWorkspace &ws, const int &last_iter,
+                    const int &em_steps) {
+  ws.last_iter_ = last_iter;
+  ws.em_steps_ = em_steps;
+  ws.aborted_ = false;
+}
+
+const Eigen::MatrixXd &Hmm::ExpectedTransition(HmmWorkspace &ws) const {
+  // expected transitions out of each state, i.e. gamma summed over t < T - 1
+  ws.row_sum_ = ws.sigma_xi_.rowwise().sum();
+  ws.new_transition_ =
+      ws.sigma_xi_.array().colwise() / ws.row_sum_.array();
+  return ws.new_transition_;
+}
+
+double Hmm::Maximization(const LabelTrace &observation, HmmWorkspace &ws) {
   auto T = observation.size();
+  const auto &gamma = ws.gamma_;
+
+  const auto &new_transition = ExpectedTransition(ws);
+  auto &new_emission = ws.new_emission_;
+  new_emission.setZero();
+  if (ws.corpus_) {
+    for (int o = 0; o < alphabet_count_; o++) {
+      auto positions = ws.corpus_->positions(o);
+      for (Eigen::Index i = 0; i < positions.size(); i++) {
+        new_emission.col(o) += gamma.col(positions(i));
+      }
+    }
+  } else {
+    for (int t = 0; t < T; t++) {
+      auto o = observation[t];
+      new_emission.col(o) += gamma.col(t);
+    }
+  }
+  ws.row_sum_ = gamma.rowwise().sum();
+  ws.new_initial_ = ws.row_sum_ / T;
+  new_emission = new_emission.array().colwise() / ws.row_sum_.array();
+
+  auto norm_diff = UpdateParams(ws.new_initial_, new_transition, new_emission);
+  return norm_diff;
+}
+
+void Hmm::Params(Eigen::VectorXd &theta) const {
   auto state_count = dtmc_.state_count();
+  auto transition_size = state_count * state_count;
+  theta.resize(state_count + transition_size + state_count * alphabet_count_);
+  theta.head(state_count) = dtmc_.initial_p();
+  Eigen::Map<Eigen::Matrix<double, Eigen::Dynamic, Eigen::Dynamic,
+                           Eigen::RowMajor>>(
+      theta.data() + state_count, state_count, state_count) =
+      dtmc_.transition_p();
+  Eigen::Map<Eigen::Matrix<double, Eigen::Dynamic, Eigen::Dynamic,
+                           Eigen::RowMajor>>(
+      theta.data() + state_count + transition_size, state_count,
+      alphabet_count_) = emission_p_;
+}
 
-  Eigen::VectorXd new_initial = gamma_.rowwise().sum() / T;
-  Eigen::MatrixXd new_transition =
-      sigma_xi_.array().colwise() / gamma_.rowwise().sum().array();
-  Eigen::MatrixXd new_emission =
-      Eigen::MatrixXd::Zero(state_count, alphabet_count_);
-  for (int t = 0; t < T; t++) {
-    auto o = observation[t];
-    new_emission.col(o) += gamma_.col(t);
+bool Hmm::Params(const Eigen::VectorXd &theta, HmmWorkspace &ws) {
+  auto state_count = dtmc_.state_count();
+  auto transition_size = state_count * state_count;
+  auto &initial = ws.new_initial_;
+  auto &transition = ws.new_transition_;
+  auto &emission = ws.new_emission_;
+  initial = theta.head(state_count).cwiseMax(0);
+  transition =
+      Eigen::Map<const Eigen::Matrix<double, Eigen::Dynamic, Eigen::Dynamic,
+                                     Eigen::RowMajor>>(
+          theta.data() + state_count, state_count, state_count)
+          .cwiseMax(0);
+  emission =
+      Eigen::Map<const Eigen::Matrix<double, Eigen::Dynamic, Eigen::Dynamic,
+                                     Eigen::RowMajor>>(
+          theta.data() + state_count + transition_size, state_count,
+          alphabet_count_)
+          .cwiseMax(0);
+  if (!(initial.sum() > 0) || !(transition.rowwise().sum().minCoeff() > 0) ||
+      !(emission.rowwise().sum().minCoeff() > 0)) {
+    return false;
   }
-  new_emission =
-      new_emission.array().colwise() / gamma_.rowwise().sum().array();
+  initial /= initial.sum();
+  ws.row_sum_ = transition.rowwise().sum();
+  transition = transition.array().colwise() / ws.row_sum_.array();
+  ws.row_sum_ = emission.rowwise().sum();
+  emission = emission.array().colwise() / ws.row_sum_.array();
+  UpdateParams(initial, transition, emission);
+  return true;
+}
 
-  auto norm_diff = UpdateParams(new_initial, new_transition, new_emission);
+// One baum-welch iteration. Leaves the log-likelihood of the parameters it
+// started from in the workspace, which comes for free with the E-step.
+double Hmm::EmStep(const LabelTrace &observation, HmmWorkspace &ws,
+                   FitIteration *probe) {
+  Timed(probe ? &probe->expectation : nullptr,
+        [&]() { ws.log_likelihood_ = Expectation(observation, ws); });
+  ws.em_steps_++;
+  double norm_diff;
+  Timed(probe ? &probe->maximization : nullptr,
+        [&]() { norm_diff = Maximization(observation, ws); });
+  if (probe && probe->em_steps++ == 0) {
+    probe->log_likelihood = ws.log_likelihood_;
+    probe->param_delta = norm_diff;
+  }
   return norm_diff;
 }
 
-void Hmm::Fit(const LabelTrace &observation, const int &max_iters,
-              const double &eps) {
-  auto T = observation.size();
-  for (int i = 0; i < max_iters; last_iter_ = ++i) {
-    Expectation(observation);
-    auto norm_diff = Maximization(observation);
-    Evaluate(observation);
-    if (norm_diff <= eps) {
+bool org::mcss::ObserveIteration(const FitOptions &options,
+                                 const FitIteration &iteration) {
+#ifndef MCSS_NO_FIT_OBSERVER
+  if (options.observer) {
+    return options.observer(iteration);
+  }
+#endif
+  return true;
+}
+
+bool Hmm::Report(const FitOptions &options, HmmWorkspace &ws,
+                 FitIteration &iteration) const {
+#ifndef MCSS_NO_FIT_OBSERVER
+  iteration.iter = ws.last_iter_ + 1;
+  iteration.workspace_held_bytes = ws.bytes();
+  if (!options.observer(iteration)) {
+    ws.aborted_ = true;
+    return false;
+  }
+#endif
+  return true;
+}
+
+void Hmm::FitEm(const LabelTrace &observation, HmmWorkspace &ws,
+                const FitOptions &options) {
+  auto previous_ll = -std::numeric_limits<double>::infinity();
+  for (int i = 0; i < options.max_iters; ws.last_iter_ = ++i) {
+    FitIteration iteration;
+    auto probe = Probe(options, iteration);
+    auto norm_diff = EmStep(observation, ws, probe);
+    if ((probe && !Report(options, ws, iteration)) ||
+        norm_diff <= options.eps ||
+        (options.log_likelihood_eps > 0 &&
+         ws.log_likelihood_ - previous_ll < options.log_likelihood_eps)) {
+      ws.last_iter_ = i + 1;
+      break;
+    }
+    previous_ll = ws.log_likelihood_;
+  }
+}
+
+void Hmm::FitSquarem(const LabelTrace &observation, HmmWorkspace &ws,
+                     const FitOptions &options) {
+  for (int i = 0; i < options.max_iters; ws.last_iter_ = ++i) {
+    FitIteration iteration;
+    auto probe = Probe(options, iteration);
+    Params(ws.theta_0_);
+    EmStep(observation, ws, probe);
+    auto ll_0 = ws.log_likelihood_;
+    Params(ws.theta_1_);
+    EmStep(observation, ws, probe);
+    auto ll_1 = ws.log_likelihood_;
+    Params(ws.theta_2_);
+
+    auto &r = ws.r_;
+    auto &v = ws.v_;
+    r = ws.theta_1_ - ws.theta_0_;
+    v = ws.theta_2_ - ws.theta_1_ - r;
+    auto r_norm = r.norm();
+    auto v_norm = v.norm();
+    if (r_norm <= options.eps ||
+        (options.log_likelihood_eps > 0 &&
+         ll_1 - ll_0 < options.log_likelihood_eps)) {
+      if (probe) {
+        Report(options, ws, iteration);
+      }
+      ws.last_iter_ = i + 1;
+      break;
+    }
+    if (v_norm == 0) {
+      if (probe && !Report(options, ws, iteration)) {
+        ws.last_iter_ = i + 1;
+        break;
+      }
+      continue;
+    }
+
+    // step length -1 is exactly theta_2, so the backtracking ends on the
+    // plain EM result at worst
+    Timed(probe ? &probe->extrapolation : nullptr, [&]() {
+      auto step = std::min(-r_norm / v_norm, -1.0);
+      while (step < -1.0) {
+        ws.theta_ = ws.theta_0_ - 2 * step * r + step * step * v;
+        if (Params(ws.theta_, ws)) {
+          auto ll = StepLogLikelihood(observation, ws);
+          if (std::isfinite(ll) && ll >= ll_1) {
+            break;
+          }
+        }
+        step = (step - 1) / 2;
+        if (step > -1.0 + 1e-3) {
+          step = -1.0;
+        }
+      }
+      if (step == -1.0) {
+        Params(ws.theta_2_, ws);
+      }
+    });
+    if (probe && !Report(options, ws, iteration)) {
+      ws.last_iter_ = i + 1;
       break;
     }
   }
 }
 
-// Observation explanation: viterbi
-std::vector<int> Decode(const std::vector<int> &observation) {
-  // TODO: implement viterbi algorithm
-  return observation;
+void Hmm::Fit(const LabelTrace &observation, HmmWorkspace &ws,
+              const int &max_iters, const double &eps) {
+  FitOptions options;
+  options.max_iters = max_iters;
+  options.eps = eps;
+  Fit(observation, ws, options);
+}
+
+void Hmm::Fit(const LabelTrace &observation, HmmWorkspace &ws,
+              const FitOptions &options) {
+  FitResult(ws, 0, 0);
+  ws.ReserveFit(dtmc_.state_count(), alphabet_count_);
+  ws.mixed_precision_ = options.precision == FitPrecision::kMixed;
+  if (options.acceleration == FitAcceleration::kSquarem) {
+    FitSquarem(observation, ws, options);
+  } else {
+    FitEm(observation, ws, options);
+  }
+  Evaluate(observation, ws);
+}
+
+bool Hmm::Fit(const TraceCorpus &corpus, HmmWorkspace &ws,
+              const FitOptions &options) {
+  if (corpus.alphabet_count() != alphabet_count_) {
+    return false;
+  }
+  ws.corpus_ = &corpus;
+  Fit(corpus.trace(), ws, options);
+  ws.corpus_ = nullptr;
+  return true;
+}
+
+// Observation explanation: viterbi, in log space
+LabelTrace Hmm::Decode(const LabelTrace &observation, HmmWorkspace &ws) const {
+  return ViterbiPath(dtmc_.initial_p(), dtmc_.transition_p(),
+                     DiscreteLogEmission{emission_p_, observation},
+                     observation.size(), ws.log_transition_, ws.delta_,
+                     ws.psi_);
 }
@@ -1,13 +1,69 @@
 #ifndef __HMM_H__
 #define __HMM_H__
 
+#include <chrono>
+#include <functional>
 #include <string>
 #include <vector>
 
-#include "dtmc.h"
-#include "label_trace.h"
+#include "dtmc.hh"
+#include "hmm_workspace.hh"
+#include "label_trace.hh"
 
 namespace org::mcss {
+enum class FitAcceleration { kNone, kSquarem };
+enum class FitPrecision { kDouble, kMixed };
+
+// Telemetry of one Hmm::Fit iteration, see FitOptions::observer
+struct FitIteration {
+  int iter = 0;
+  // E-steps run in this iteration, two for kSquarem
+  int em_steps = 0;
+  std::chrono::nanoseconds expectation{0};
+  std::chrono::nanoseconds maximization{0};
+  // kSquarem step length search
+  std::chrono::nanoseconds extrapolation{0};
+  // log-likelihood of the parameters the iteration started from
+  double log_likelihood = 0;
+  // parameter change of the (first) EM step
+  double param_delta = 0;
+  // bytes the workspace holds at the end of the iteration, not allocated in it
+  size_t workspace_held_bytes = 0;
+};
+
+// Stopping rules and acceleration for Hmm::Fit. Fitting stops at whichever
+// of the enabled criteria is met first.
+struct FitOptions {
+  int max_iters = 1000;
+  // stop when the parameter change of one iteration falls below eps
+  double eps = 1e-5;
+  // stop when the log-likelihood gain of one iteration falls below this
+  // value, 0 disables the check
+  double log_likelihood_eps = 0;
+  // kSquarem extrapolates two EM steps at a time (Varadhan & Roland, SqS3)
+  // and falls back towards the plain EM step when the likelihood drops
+  FitAcceleration acceleration = FitAcceleration::kNone;
+  // kMixed runs the forward-backward passes of the E-step in float through
+  // HmmKernel and accumulates the expected counts in double; the M-step and
+  // the final log-likelihood stay double. Always sequential, whatever the
+  // workspace was parallelized with.
+  FitPrecision precision = FitPrecision::kDouble;
+#ifndef MCSS_NO_FIT_OBSERVER
+  // Called after every iteration; returning false aborts the fit. Phases
+  // are only timed when an observer is set. Building with
+  // MCSS_NO_FIT_OBSERVER removes the hooks altogether.
+  std::function<bool(const FitIteration &)> observer;
+#endif
+};
+
+// Hand one iteration of a model without its own telemetry to
+// options.observer; false if the observer asks to abort, true if there is
+// none
+bool ObserveIteration(const FitOptions &options, const FitIteration &iteration);
+
+// Parameters of a discrete hidden markov model. Inference state lives in a
+// caller-owned HmmWorkspace, so const methods are safe to call concurrently
+// on a shared model.
 class Hmm {
  private:
   MarkovRandom rand_;
@@ -16,67 +72,124 @@ class Hmm {
   int alphabet_count_;
   Eigen::MatrixXd emission_p_;
 
-  int current_obs_;
-  int previous_obs_;
-
-  static const int kMaxIters = 1000;
+  static constexpr int kMaxIters = 1000;
   static constexpr double kEps = 1e-5;
-  Eigen::MatrixXd alpha_;
-  Eigen::MatrixXd beta_;
-  Eigen::MatrixXd gamma_;
-  Eigen::MatrixXd sigma_xi_;
-  double log_likelihood_ = 0;
-  double aic_ = 0;
-  int last_iter_ = 0;
 
  protected:
   double UpdateParams(const Eigen::VectorXd &, const Eigen::MatrixXd &,
                       const Eigen::MatrixXd &);
-  void Forward(const LabelTrace &observation);
-  void Backward(const LabelTrace &observation);
-  void Expectation(const LabelTrace &observation);
-  double Maximization(const LabelTrace &observation);
-  void Evaluate(const LabelTrace &observation);
+  void Forward(const LabelTrace &observation, HmmWorkspace &ws) const;
+  void Backward(const LabelTrace &observation, HmmWorkspace &ws) const;
+  void ForwardRange(const LabelTrace &observation, HmmWorkspace &ws,
+                    const int &begin, const int &end,
+                    const Eigen::VectorXd &entry) const;
+  void BackwardRange(const LabelTrace &observation, HmmWorkspace &ws,
+                     const int &begin, const int &end,
+                     Eigen::VectorXd &weight) const;
+  void SegmentTransfer(const LabelTrace &observation, const int &begin,
+                       const int &end, Eigen::MatrixXd &transfer,
+                       double &log_norm) const;
+  void PosteriorRange(HmmWorkspace &ws, const int &begin,
+                      const int &end) const;
+  void SigmaXiRange(const LabelTrace &observation, HmmWorkspace &ws,
+                    const int &begin, const int &end, Eigen::VectorXd &weight,
+                    Eigen::MatrixXd &sigma_xi) const;
+  // sum_t alpha_t beta_t+1^T .* b(o_t+1) / scale_t+1 into sigma_xi, after
+  // the forward and backward passes
+  void SigmaXi(const LabelTrace &observation, HmmWorkspace &ws,
+               Eigen::MatrixXd &sigma_xi) const;
+  // E-step into the gamma and sigma_xi of ws, returns log P(O)
+  double Expectation(const LabelTrace &observation, HmmWorkspace &ws) const;
+  // sigma_xi with normalised rows, in the workspace
+  const Eigen::MatrixXd &ExpectedTransition(HmmWorkspace &ws) const;
+  virtual double Maximization(const LabelTrace &observation,
+                              HmmWorkspace &ws);
+  void Evaluate(const LabelTrace &observation, HmmWorkspace &ws) const;
+  // log P(O) in the precision of the E-step, float for kMixed, so that
+  // kSquarem compares an extrapolated point with the EM steps like for like
+  double StepLogLikelihood(const LabelTrace &observation,
+                           HmmWorkspace &ws) const;
+  double EmStep(const LabelTrace &observation, HmmWorkspace &ws,
+                FitIteration *probe = nullptr);
+  // fill in and hand the iteration to the observer, false to abort
+  bool Report(const FitOptions &options, HmmWorkspace &ws,
+              FitIteration &iteration) const;
+  void FitEm(const LabelTrace &observation, HmmWorkspace &ws,
+             const FitOptions &options);
+  void FitSquarem(const LabelTrace &observation, HmmWorkspace &ws,
+                  const FitOptions &options);
+
+  // all parameters flattened as (initial, transition, emission), row-major
+  void Params(Eigen::VectorXd &theta) const;
+  // set flattened parameters, projected back onto stochastic rows through
+  // the M-step buffers of ws; returns false if a row has no mass left
+  bool Params(const Eigen::VectorXd &theta, HmmWorkspace &ws);
+
+  // free parameters, for the AIC
+  virtual int ParamCount() const;
+  // store the log-likelihood and AIC of the current parameters
+  void Score(HmmWorkspace &ws, const double &log_likelihood) const;
+  static void FitResult(HmmWorkspace &ws, const int &last_iter,
+                        const int &em_steps);
 
  public:
   Hmm(const int &states_size, const int &alphabet_count,
       const Eigen::VectorXd &p0, const Eigen::MatrixXd &p,
       const Eigen::MatrixXd &b);
   Hmm(const int &states_size, const int &alphabet_count);
+  virtual ~Hmm() = default;
 
-  std::string Str();
+  std::string Str() const;
 
   // simulation
-  int Next();
+  int Next(HmmWorkspace &ws) const;
 
   // init model parameters
   void InitRandom();
+  // Start from the counts of a corpus instead: symbols with similar
+  // successor and predecessor distributions are clustered onto the same
+  // state, each state emits mostly its cluster, and the transitions are the
+  // bigram counts between clusters. States beyond the alphabet share a
+  // cluster and are told apart by a small random perturbation. False, and
+  // the model untouched, if the corpus has another alphabet.
+  bool InitFromCounts(const TraceCorpus &corpus);
 
   // Likelihood estimation: forward-backward algorithm
-  const Eigen::MatrixXd &Posterior(const LabelTrace &observation);
+  const Eigen::MatrixXd &Posterior(const LabelTrace &observation,
+                                   HmmWorkspace &ws) const;
+  // forward pass only, also leaves the AIC in the workspace
+  double LogLikelihood(const LabelTrace &observation, HmmWorkspace &ws) const;
+
+  // Gradient of log P(O) with respect to every entry of initial_p,
+  // transition_p and emission_p, into ws.grad_*(), from one forward-backward
+  // pass; returns log P(O). The entries are taken as independent: nothing
+  // keeps the rows stochastic, that is up to a parametrisation built on top.
+  double LogLikelihoodGradient(const LabelTrace &observation,
+                               HmmWorkspace &ws) const;
 
   // Parameter estimation: baum-welch
-  void Fit(const LabelTrace &observation, const int &max_iters = kMaxIters,
-           const double &eps = kEps);
+  void Fit(const LabelTrace &observation, HmmWorkspace &ws,
+           const int &max_iters = kMaxIters, const double &eps = kEps);
+  virtual void Fit(const LabelTrace &observation, HmmWorkspace &ws,
+                   const FitOptions &options);
+  // Fit on corpus.trace(), gathering the M-step emission sums through the
+  // symbol positions of the corpus; false if the corpus has another alphabet
+  bool Fit(const TraceCorpus &corpus, HmmWorkspace &ws,
+           const FitOptions &options = FitOptions());
 
   // Observation explanation: viterbi
-  LabelTrace Decode(const LabelTrace &observation);
+  LabelTrace Decode(const LabelTrace &observation, HmmWorkspace &ws) const;
 
   // getter
   Dtmc &dtmc() { return dtmc_; }
-  const int &alphabet_count() { return alphabet_count_; }
-  const Eigen::MatrixXd &emission_p() { return emission_p_; };
+  // drives InitRandom and the InitFromCounts perturbation
+  MarkovRandom &rand() { return rand_; }
+  const Dtmc &dtmc() const { return dtmc_; }
+  const int &state_count() const { return dtmc_.state_count(); }
+  const int &alphabet_count() const { return alphabet_count_; }
+  const Eigen::MatrixXd &emission_p() const { return emission_p_; };
   void emission_p(const Eigen::MatrixXd &m) { emission_p_ = m; }
   void initial_p(const Eigen::VectorXd &pi) { dtmc_.initial_p(pi); }
-  const Eigen::MatrixXd &alpha() { return alpha_; }
-  const Eigen::MatrixXd &beta() { return beta_; }
-  const Eigen::MatrixXd &gamma() { return gamma_; }
-  const Eigen::MatrixXd &sigma_xi() { return sigma_xi_; };
-  const double &log_likelihood() { return log_likelihood_; }
-  const double &aic() { return aic_; }
-  const int &last_iter() { return last_iter_; };
-  const int &current_obs() { return current_obs_; };
-  const int &previous_obs() { return previous_obs_; };
 };
 }  // namespace org::mcss
 
@@ -0,0 +1,179 @@
+#include "hmm_kernel.hh"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include "hmm.hh"
+
+using namespace org::mcss;
+
+template <typename Scalar>
+HmmKernel<Scalar>::HmmKernel(const Hmm &model) {
+  Assign(model);
+}
+
+template <typename Scalar>
+void HmmKernel<Scalar>::Assign(const Eigen::VectorXd &initial_p,
+                               const Eigen::MatrixXd &transition_p,
+                               const Eigen::MatrixXd &emission_p) {
+  initial_p_ = initial_p.cast<Scalar>();
+  transition_p_ = transition_p.cast<Scalar>();
+  emission_p_ = emission_p.cast<Scalar>();
+}
+
+template <typename Scalar>
+void HmmKernel<Scalar>::Assign(const Hmm &model) {
+  Assign(model.dtmc().initial_p(), model.dtmc().transition_p(),
+         model.emission_p());
+}
+
+template <typename Scalar>
+void HmmKernel<Scalar>::Reserve(HmmKernelWorkspace<Scalar> &ws,
+                                const int &T) const {
+  auto state_count = transition_p_.rows();
+  ws.alpha_.resize(state_count, T);
+  ws.beta_.resize(state_count, T);
+  ws.scale_.resize(T);
+  ws.weight_.resize(state_count);
+}
+
+template <typename Scalar>
+void HmmKernel<Scalar>::Forward(const LabelTrace &observation,
+                                HmmKernelWorkspace<Scalar> &ws) const {
+  auto T = observation.size();
+  auto &alpha = ws.alpha_;
+  auto &scale = ws.scale_;
+  // basis step
+  alpha.col(0) = initial_p_.cwiseProduct(emission_p_.col(observation[0]));
+  scale(0) = alpha.col(0).sum();
+  alpha.col(0) /= scale(0);
+  // inductive step
+  for (int t = 1; t < T; t++) {
+    alpha.col(t).noalias() = transition_p_.transpose() * alpha.col(t - 1);
+    alpha.col(t).array() *= emission_p_.col(observation[t]).array();
+    scale(t) = alpha.col(t).sum();
+    alpha.col(t) /= scale(t);
+  }
+}
+
+template <typename Scalar>
+void HmmKernel<Scalar>::Backward(const LabelTrace &observation,
+                                 HmmKernelWorkspace<Scalar> &ws) const {
+  auto T = observation.size();
+  auto &beta = ws.beta_;
+  auto &weight = ws.weight_;
+  // basis step
+  beta.col(T - 1).setOnes();
+  // inductive step
+  for (int t = T - 2; t >= 0; t--) {
+    weight = beta.col(t + 1).cwiseProduct(emission_p_.col(observation[t + 1]));
+    beta.col(t).noalias() = transition_p_ * weight;
+    beta.col(t) /= ws.scale_(t + 1);
+  }
+}
+
+template <typename Scalar>
+double HmmKernel<Scalar>::LogLikelihood(const LabelTrace &observation,
+                                        HmmKernelWorkspace<Scalar> &ws) const {
+  auto T = observation.size();
+  Reserve(ws, T);
+  Forward(observation, ws);
+  return ws.scale_.head(T).template cast<double>().array().log().sum();
+}
+
+template <typename Scalar>
+const typename HmmKernel<Scalar>::Matrix &HmmKernel<Scalar>::Posterior(
+    const LabelTrace &observation, HmmKernelWorkspace<Scalar> &ws) const {
+  auto T = observation.size();
+  Reserve(ws, T);
+  Forward(observation, ws);
+  Backward(observation, ws);
+  auto &gamma = ws.gamma_;
+  gamma.resize(transition_p_.rows(), T);
+  for (int t = 0; t < T; t++) {
+    gamma.col(t) = ws.alpha_.col(t).cwiseProduct(ws.beta_.col(t));
+    gamma.col(t) /= gamma.col(t).sum();
+  }
+  return gamma;
+}
+
+template <typename Scalar>
+double HmmKernel<Scalar>::Expectation(const LabelTrace &observation,
+                                      HmmKernelWorkspace<Scalar> &ws,
+                                      Eigen::MatrixXd &gamma,
+                                      Eigen::MatrixXd &sigma_xi) const {
+  int T = observation.size();
+  auto state_count = transition_p_.rows();
+  Reserve(ws, T);
+  Forward(observation, ws);
+  Backward(observation, ws);
+  for (int t = 0; t < T; t++) {
+    gamma.col(t) =
+        ws.alpha_.col(t).cwiseProduct(ws.beta_.col(t)).template cast<double>();
+    gamma.col(t) /= gamma.col(t).sum();
+  }
+
+  // xi_t = P .* (alpha_t * (b(o_t+1) .* beta_t+1)^T) / scale_t+1, one
+  // matrix product per block of time steps
+  auto &weight = ws.block_weight_;
+  auto &block_sigma_xi = ws.block_sigma_xi_;
+  weight.resize(state_count, kBlock);
+  block_sigma_xi.resize(state_count, state_count);
+  sigma_xi.setZero();
+  for (int begin = 0; begin < T - 1; begin += kBlock) {
+    auto length = std::min(kBlock, T - 1 - begin);
+    for (int k = 0; k < length; k++) {
+      auto t = begin + k + 1;
+      weight.col(k) =
+          ws.beta_.col(t).cwiseProduct(emission_p_.col(observation[t])) /
+          ws.scale_(t);
+    }
+    block_sigma_xi.noalias() = ws.alpha_.middleCols(begin, length) *
+                               weight.leftCols(length).transpose();
+    sigma_xi += block_sigma_xi.template cast<double>();
+  }
+  sigma_xi.array() *= transition_p_.template cast<double>().array();
+  return ws.scale_.head(T).template cast<double>().array().log().sum();
+}
+
+template <typename Scalar>
+LabelTrace HmmKernel<Scalar>::Decode(const LabelTrace &observation,
+                                     HmmKernelWorkspace<Scalar> &ws) const {
+  auto T = observation.size();
+  auto state_count = transition_p_.rows();
+  auto &delta = ws.delta_;
+  auto &psi = ws.psi_;
+  auto &log_transition = ws.log_transition_;
+  delta.resize(state_count, T);
+  psi.resize(state_count, T);
+  log_transition = transition_p_.array().log();
+  // basis step
+  delta.col(0) = initial_p_.array().log() +
+                 emission_p_.col(observation[0]).array().log();
+  delta.col(0).array() -= delta.col(0).maxCoeff();
+  // inductive step
+  for (int t = 1; t < T; t++) {
+    for (int j = 0; j < state_count; j++) {
+      int arg_max;
+      auto max = (delta.col(t - 1) + log_transition.col(j)).maxCoeff(&arg_max);
+      delta(j, t) = max + std::log(emission_p_(j, observation[t]));
+      psi(j, t) = arg_max;
+    }
+    delta.col(t).array() -= delta.col(t).maxCoeff();
+  }
+  // backtrack
+  std::vector<int> path(T);
+  delta.col(T - 1).maxCoeff(&path[T - 1]);
+  for (int t = T - 1; t > 0; t--) {
+    path[t - 1] = psi(path[t], t);
+  }
+  LabelTrace decoded;
+  for (const auto &s : path) {
+    decoded.Append(s);
+  }
+  return decoded;
+}
+
+template class org::mcss::HmmKernel<float>;
+template class org::mcss::HmmKernel<double>;
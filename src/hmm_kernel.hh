@@ -0,0 +1,112 @@
+#ifndef __HMM_KERNEL_H__
+#define __HMM_KERNEL_H__
+
+#include <Eigen/Eigen>
+
+#include <cstddef>
+
+#include "label_trace.hh"
+
+namespace org::mcss {
+class Hmm;
+template <typename Scalar>
+class HmmKernel;
+
+// Caller-owned buffers of HmmKernel, in the kernel's scalar type
+template <typename Scalar>
+class HmmKernelWorkspace {
+ private:
+  using Matrix = Eigen::Matrix<Scalar, Eigen::Dynamic, Eigen::Dynamic>;
+  using Vector = Eigen::Matrix<Scalar, Eigen::Dynamic, 1>;
+
+  Matrix alpha_;
+  Matrix beta_;
+  Matrix gamma_;
+  Vector scale_;
+  Vector weight_;
+  // sigma_xi of one block of time steps, see HmmKernel::Expectation
+  Matrix block_weight_;
+  Matrix block_sigma_xi_;
+
+  // viterbi
+  Matrix log_transition_;
+  Matrix delta_;
+  Eigen::MatrixXi psi_;
+
+  friend class HmmKernel<Scalar>;
+
+ public:
+  const Matrix &alpha() const { return alpha_; }
+  const Matrix &beta() const { return beta_; }
+  const Matrix &gamma() const { return gamma_; }
+  const Vector &scale() const { return scale_; }
+
+  // bytes held by the buffers
+  size_t bytes() const {
+    return sizeof(Scalar) * (alpha_.size() + beta_.size() + gamma_.size() +
+                             scale_.size() + weight_.size() +
+                             block_weight_.size() + block_sigma_xi_.size() +
+                             log_transition_.size() + delta_.size()) +
+           sizeof(int) * psi_.size();
+  }
+};
+
+// Inference passes of Hmm over its parameters cast to Scalar. Instantiated
+// for float and double; float halves the memory traffic of alpha and beta
+// and doubles the lanes per SIMD register. Quantities that accumulate over
+// the whole trace, the log-likelihood and the expected counts handed to
+// Baum-Welch, are summed in double either way.
+template <typename Scalar>
+class HmmKernel {
+ public:
+  using Matrix = Eigen::Matrix<Scalar, Eigen::Dynamic, Eigen::Dynamic>;
+  using Vector = Eigen::Matrix<Scalar, Eigen::Dynamic, 1>;
+
+ private:
+  // time steps of sigma_xi summed in Scalar before going into the double sum
+  static constexpr int kBlock = 64;
+
+  Vector initial_p_;
+  Matrix transition_p_;
+  Matrix emission_p_;
+
+  void Reserve(HmmKernelWorkspace<Scalar> &ws, const int &T) const;
+  void Forward(const LabelTrace &observation,
+               HmmKernelWorkspace<Scalar> &ws) const;
+  void Backward(const LabelTrace &observation,
+                HmmKernelWorkspace<Scalar> &ws) const;
+
+ public:
+  HmmKernel() {}
+  explicit HmmKernel(const Hmm &model);
+
+  // take over the parameters of model; no allocation if the shapes match
+  void Assign(const Eigen::VectorXd &initial_p,
+              const Eigen::MatrixXd &transition_p,
+              const Eigen::MatrixXd &emission_p);
+  void Assign(const Hmm &model);
+
+  int state_count() const { return transition_p_.rows(); }
+
+  // scaled forward pass, log P(O)
+  double LogLikelihood(const LabelTrace &observation,
+                       HmmKernelWorkspace<Scalar> &ws) const;
+  // forward-backward, state posteriors one column per time step
+  const Matrix &Posterior(const LabelTrace &observation,
+                          HmmKernelWorkspace<Scalar> &ws) const;
+  // E-step of Baum-Welch: posteriors into gamma and transition counts into
+  // sigma_xi, both double and sized by the caller, returns log P(O)
+  double Expectation(const LabelTrace &observation,
+                     HmmKernelWorkspace<Scalar> &ws, Eigen::MatrixXd &gamma,
+                     Eigen::MatrixXd &sigma_xi) const;
+  // viterbi in log space, renormalised every step so that float keeps its
+  // precision on long traces
+  LabelTrace Decode(const LabelTrace &observation,
+                    HmmKernelWorkspace<Scalar> &ws) const;
+};
+
+extern template class HmmKernel<float>;
+extern template class HmmKernel<double>;
+}  // namespace org::mcss
+
+#endif  // __HMM_KERNEL_H__
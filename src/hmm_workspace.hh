@@ -0,0 +1,208 @@
+#ifndef __HMM_WORKSPACE_H__
+#define __HMM_WORKSPACE_H__
+
+#include <Eigen/Eigen>
+
+#include <vector>
+
+#include "hmm_kernel.hh"
+#include "markov_random.hh"
+#include "my_thread_pool.h"
+
+namespace org::mcss {
+class Hmm;
+class TraceCorpus;
+
+// Caller-owned inference state for Hmm. The model only holds parameters, so
+// one Hmm may be shared by many threads as long as each thread brings its
+// own workspace. Buffers are kept between calls and only grow.
+class HmmWorkspace {
+ private:
+  static const int kBeginState = -1;
+  // shorter segments are not worth a transfer matrix product
+  static const int kMinSegmentLength = 256;
+
+  MarkovRandom rand_;
+  int current_state_ = kBeginState;
+  int current_obs_ = kBeginState;
+  int previous_obs_ = kBeginState;
+
+  Eigen::MatrixXd alpha_;
+  Eigen::MatrixXd beta_;
+  Eigen::MatrixXd gamma_;
+  Eigen::MatrixXd sigma_xi_;
+  Eigen::VectorXd scale_;
+  Eigen::VectorXd weight_;
+
+  // viterbi
+  Eigen::MatrixXd log_transition_;
+  Eigen::MatrixXd delta_;
+  Eigen::MatrixXi psi_;
+
+  // time-segmented forward-backward, see Parallelize()
+  Mylibpp::ThreadPool *pool_ = nullptr;
+  int segment_count_ = 1;
+  std::vector<Eigen::MatrixXd> transfer_;
+  std::vector<double> transfer_log_norm_;
+  std::vector<Eigen::VectorXd> segment_entry_;
+  std::vector<Eigen::VectorXd> segment_exit_;
+  std::vector<Eigen::VectorXd> segment_weight_;
+  std::vector<Eigen::MatrixXd> segment_sigma_xi_;
+
+  // M-step estimates and kSquarem parameter vectors, sized once per Fit so
+  // that iterations after the first do not touch the heap
+  Eigen::VectorXd new_initial_;
+  Eigen::MatrixXd new_transition_;
+  Eigen::MatrixXd new_emission_;
+  Eigen::VectorXd row_sum_;
+  Eigen::VectorXd theta_0_;
+  Eigen::VectorXd theta_1_;
+  Eigen::VectorXd theta_2_;
+  Eigen::VectorXd theta_;
+  Eigen::VectorXd r_;
+  Eigen::VectorXd v_;
+
+  // gradient of log P(O) with respect to the model parameters, see
+  // Hmm::LogLikelihoodGradient
+  Eigen::VectorXd grad_initial_;
+  Eigen::MatrixXd grad_transition_;
+  Eigen::MatrixXd grad_emission_;
+
+  // corpus of the running Fit, if it was given one
+  const TraceCorpus *corpus_ = nullptr;
+
+  // float E-step of FitPrecision::kMixed
+  bool mixed_precision_ = false;
+  HmmKernel<float> mixed_kernel_;
+  HmmKernelWorkspace<float> mixed_ws_;
+
+  double log_likelihood_ = 0;
+  double aic_ = 0;
+  int last_iter_ = 0;
+  int em_steps_ = 0;
+  bool aborted_ = false;
+
+  friend class Hmm;
+
+ protected:
+  void Reserve(const int &state_count, const int &T) {
+    // Eigen keeps the allocation when rows * cols does not change
+    alpha_.resize(state_count, T);
+    beta_.resize(state_count, T);
+    gamma_.resize(state_count, T);
+    scale_.resize(T);
+    sigma_xi_.resize(state_count, state_count);
+    weight_.resize(state_count);
+    if (Segmented(T)) {
+      transfer_.resize(segment_count_);
+      transfer_log_norm_.resize(segment_count_);
+      segment_entry_.resize(segment_count_);
+      segment_exit_.resize(segment_count_);
+      segment_weight_.resize(segment_count_);
+      segment_sigma_xi_.resize(segment_count_);
+      for (int k = 0; k < segment_count_; k++) {
+        transfer_[k].resize(state_count, state_count);
+        segment_entry_[k].resize(state_count);
+        segment_exit_[k].resize(state_count);
+        segment_weight_[k].resize(state_count);
+        segment_sigma_xi_[k].resize(state_count, state_count);
+      }
+    }
+  }
+
+  void ReserveFit(const int &state_count, const int &alphabet_count) {
+    auto param_count = state_count * (1 + state_count + alphabet_count);
+    new_initial_.resize(state_count);
+    new_transition_.resize(state_count, state_count);
+    new_emission_.resize(state_count, alphabet_count);
+    row_sum_.resize(state_count);
+    for (auto *theta : {&theta_0_, &theta_1_, &theta_2_, &theta_, &r_, &v_}) {
+      theta->resize(param_count);
+    }
+  }
+
+  bool Segmented(const int &T) const {
+    return pool_ != nullptr && segment_count_ > 1 &&
+           T >= segment_count_ * kMinSegmentLength;
+  }
+
+  // segment k covers [bounds[k], bounds[k + 1])
+  std::vector<int> SegmentBounds(const int &T) const {
+    std::vector<int> bounds(segment_count_ + 1);
+    for (int k = 0; k <= segment_count_; k++) {
+      bounds[k] =
+          static_cast<int>(static_cast<long long>(k) * T / segment_count_);
+    }
+    return bounds;
+  }
+
+ public:
+  HmmWorkspace() {}
+  HmmWorkspace(int seed) : rand_(seed) {}
+
+  // Split long traces into segment_count time segments and run the forward
+  // and backward passes of each segment on pool. Segment transfer matrices
+  // cost O(N^3) per step instead of O(N^2), so this pays off only when the
+  // pool has clearly more threads than the model has states. Inference with
+  // this workspace must not run inside a task of the same pool. A null pool
+  // restores the sequential pass.
+  void Parallelize(Mylibpp::ThreadPool *pool, const int &segment_count) {
+    pool_ = pool;
+    segment_count_ = segment_count;
+  }
+
+  // restart simulation from the initial distribution
+  void Reset() {
+    current_state_ = kBeginState;
+    current_obs_ = kBeginState;
+    previous_obs_ = kBeginState;
+  }
+
+  MarkovRandom &rand() { return rand_; }
+  const Eigen::MatrixXd &alpha() const { return alpha_; }
+  const Eigen::MatrixXd &beta() const { return beta_; }
+  const Eigen::MatrixXd &gamma() const { return gamma_; }
+  const Eigen::MatrixXd &sigma_xi() const { return sigma_xi_; }
+  const Eigen::VectorXd &scale() const { return scale_; }
+  const double &log_likelihood() const { return log_likelihood_; }
+  const double &aic() const { return aic_; }
+  const int &last_iter() const { return last_iter_; }
+  const Eigen::VectorXd &grad_initial() const { return grad_initial_; }
+  const Eigen::MatrixXd &grad_transition() const { return grad_transition_; }
+  const Eigen::MatrixXd &grad_emission() const { return grad_emission_; }
+  // E-steps performed by the last Fit
+  const int &em_steps() const { return em_steps_; }
+  // whether the last Fit was stopped by its observer
+  const bool &aborted() const { return aborted_; }
+
+  // bytes held by the inference buffers
+  size_t bytes() const {
+    size_t bytes = sizeof(double) * (alpha_.size() + beta_.size() +
+                                      gamma_.size() + sigma_xi_.size() +
+                                      scale_.size() + weight_.size() +
+                                      log_transition_.size() + delta_.size() +
+                                      new_initial_.size() +
+                                      new_transition_.size() +
+                                      new_emission_.size() + row_sum_.size() +
+                                      theta_0_.size() + theta_1_.size() +
+                                      theta_2_.size() + theta_.size() +
+                                      r_.size() + v_.size() +
+                                      grad_initial_.size() +
+                                      grad_transition_.size() +
+                                      grad_emission_.size()) +
+                   sizeof(int) * psi_.size() + mixed_ws_.bytes();
+    for (int k = 0; k < transfer_.size(); k++) {
+      bytes += sizeof(double) *
+               (transfer_[k].size() + segment_entry_[k].size() +
+                segment_exit_[k].size() + segment_weight_[k].size() +
+                segment_sigma_xi_[k].size());
+    }
+    return bytes;
+  }
+  const int &current_state() const { return current_state_; }
+  const int &current_obs() const { return current_obs_; }
+  const int &previous_obs() const { return previous_obs_; }
+};
+}  // namespace org::mcss
+
+#endif  // __HMM_WORKSPACE_H__
@@ -0,0 +1,330 @@
+#include "hsmm.hh"
+
+#include <cmath>
+#include <limits>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace org::mcss;
+
+namespace {
+using Cell = Eigen::Map<Eigen::MatrixXd>;
+
+// max_duration x state_count block of time step t
+Cell At(Eigen::MatrixXd &m, const int &t, const int &max_duration) {
+  return Cell(m.col(t).data(), max_duration, m.rows() / max_duration);
+}
+}  // namespace
+
+Hsmm::Hsmm(const int &state_count, const int &alphabet_count,
+           const int &max_duration)
+    : hmm_(state_count, alphabet_count), max_duration_(max_duration),
+      duration_p_{} {
+  duration_p_ = Eigen::MatrixXd::Zero(state_count, max_duration);
+}
+
+Hsmm::Hsmm(const int &state_count, const int &alphabet_count,
+           const Eigen::VectorXd &initial_p, const Eigen::MatrixXd &transition_p,
+           const Eigen::MatrixXd &emission_p, const Eigen::MatrixXd &durations)
+    : hmm_(state_count, alphabet_count, initial_p, transition_p, emission_p),
+      max_duration_(durations.cols()), duration_p_{} {
+  duration_p_ = durations;
+}
+
+std::string Hsmm::Str() const {
+  std::stringstream ss;
+  ss << hmm_.Str();
+  ss << "Maximum duration: " << max_duration_ << std::endl;
+  ss << "Duration probabilities: \n" << duration_p_ << std::endl;
+  return ss.str();
+}
+
+void Hsmm::InitRandom() {
+  hmm_.InitRandom();
+  auto state_count = hmm_.state_count();
+  if (state_count > 1) {
+    Eigen::MatrixXd transition = hmm_.dtmc().transition_p();
+    transition.diagonal().setZero();
+    transition = transition.array().colwise() / transition.rowwise().sum().array();
+    hmm_.dtmc().transition_p(transition);
+  }
+  duration_p_ = rand_.RandomStochasticMatrix(state_count, max_duration_);
+}
+
+// Simulate trace: draw a state and its duration, emit until it runs out
+int Hsmm::Next(HsmmWorkspace &ws) const {
+  if (ws.remaining_ == 0) {
+    if (ws.current_state_ == HsmmWorkspace::kBeginState) {
+      ws.current_state_ = ws.rand_.ChooseDirichlet(initial_p());
+    } else {
+      ws.current_state_ = ws.rand_.ChooseDirichlet(
+          transition_p().row(ws.current_state_).transpose());
+    }
+    ws.remaining_ = 1 + ws.rand_.ChooseDirichlet(
+                            duration_p_.row(ws.current_state_).transpose());
+  }
+  ws.remaining_--;
+  return ws.rand_.ChooseDirichlet(
+      emission_p().row(ws.current_state_).transpose());
+}
+
+// Scaled forward pass over (state, remaining duration):
+// alpha_t(j, d) = [alpha_t-1(j, d + 1) + sum_i alpha_t-1(i, 1) p_ij d_j(d)]
+//                 * b_j(o_t)
+void Hsmm::Forward(const LabelTrace &observation, HsmmWorkspace &ws) const {
+  auto T = observation.size();
+  auto D = max_duration_;
+  const auto &transition = transition_p();
+  const auto &emission = emission_p();
+  Eigen::MatrixXd durations = duration_p_.transpose();
+  auto &scale = ws.scale_;
+  // basis step
+  auto first = At(ws.alpha_, 0, D);
+  first = durations.array().rowwise() *
+          initial_p().cwiseProduct(emission.col(observation[0])).transpose().array();
+  scale(0) = first.sum();
+  first /= scale(0);
+  // inductive step
+  for (int t = 1; t < T; t++) {
+    auto previous = At(ws.alpha_, t - 1, D);
+    auto current = At(ws.alpha_, t, D);
+    ws.enter_.noalias() = transition.transpose() * previous.row(0).transpose();
+    current.topRows(D - 1) = previous.bottomRows(D - 1);
+    current.row(D - 1).setZero();
+    current.array() +=
+        durations.array().rowwise() * ws.enter_.transpose().array();
+    current.array().rowwise() *=
+        emission.col(observation[t]).transpose().array();
+    scale(t) = current.sum();
+    current /= scale(t);
+  }
+}
+
+// Backward pass scaled with the forward factors:
+// beta_t(j, d) = b_j(o_t+1) beta_t+1(j, d - 1) for d > 1, and
+// beta_t(j, 1) = sum_k p_jk sum_d d_k(d) b_k(o_t+1) beta_t+1(k, d)
+void Hsmm::Backward(const LabelTrace &observation, HsmmWorkspace &ws) const {
+  auto T = observation.size();
+  auto D = max_duration_;
+  const auto &emission = emission_p();
+  Eigen::MatrixXd durations = duration_p_.transpose();
+  auto &weight = ws.weight_;
+  // basis step
+  At(ws.beta_, T - 1, D).setOnes();
+  // inductive step
+  for (int t = T - 2; t >= 0; t--) {
+    auto next = At(ws.beta_, t + 1, D);
+    auto current = At(ws.beta_, t, D);
+    weight = next.array().rowwise() *
+             emission.col(observation[t + 1]).transpose().array();
+    weight /= ws.scale_(t + 1);
+    current.bottomRows(D - 1) = weight.topRows(D - 1);
+    ws.start_ = durations.cwiseProduct(weight).colwise().sum().transpose();
+    current.row(0).noalias() = (transition_p() * ws.start_).transpose();
+  }
+}
+
+const Eigen::MatrixXd &Hsmm::Posterior(const LabelTrace &observation,
+                                       HsmmWorkspace &ws) const {
+  auto T = observation.size();
+  auto D = max_duration_;
+  ws.Reserve(state_count(), D, T);
+  Forward(observation, ws);
+  Backward(observation, ws);
+  auto &gamma = ws.gamma_;
+  for (int t = 0; t < T; t++) {
+    gamma.col(t) = At(ws.alpha_, t, D)
+                       .cwiseProduct(At(ws.beta_, t, D))
+                       .colwise()
+                       .sum()
+                       .transpose();
+    gamma.col(t) /= gamma.col(t).sum();
+  }
+  return gamma;
+}
+
+double Hsmm::LogLikelihood(const LabelTrace &observation,
+                           HsmmWorkspace &ws) const {
+  auto T = observation.size();
+  ws.Reserve(state_count(), max_duration_, T);
+  Forward(observation, ws);
+  ws.log_likelihood_ = ws.scale_.head(T).array().log().sum();
+  return ws.log_likelihood_;
+}
+
+// Expected jump-chain transitions (sigma_xi) and expected segment durations
+// (sigma_eta, duration x state), including the first segment.
+void Hsmm::Expectation(const LabelTrace &observation, HsmmWorkspace &ws) const {
+  auto T = observation.size();
+  auto D = max_duration_;
+  const auto &transition = transition_p();
+  const auto &emission = emission_p();
+  Eigen::MatrixXd durations = duration_p_.transpose();
+
+  Posterior(observation, ws);
+  auto &sigma_xi = ws.sigma_xi_;
+  auto &sigma_eta = ws.sigma_eta_;
+  auto &weight = ws.weight_;
+  sigma_xi.setZero();
+  sigma_eta = At(ws.alpha_, 0, D).cwiseProduct(At(ws.beta_, 0, D));
+  for (int t = 0; t < T - 1; t++) {
+    auto ends = At(ws.alpha_, t, D).row(0).transpose();
+    weight = At(ws.beta_, t + 1, D).array().rowwise() *
+             emission.col(observation[t + 1]).transpose().array();
+    weight /= ws.scale_(t + 1);
+    weight = weight.cwiseProduct(durations);
+    ws.start_ = weight.colwise().sum().transpose();
+    sigma_xi.noalias() += ends * ws.start_.transpose();
+    ws.enter_.noalias() = transition.transpose() * ends;
+    sigma_eta.array() += weight.array().rowwise() * ws.enter_.transpose().array();
+  }
+  sigma_xi = sigma_xi.cwiseProduct(transition);
+}
+
+double Hsmm::Maximization(const LabelTrace &observation, HsmmWorkspace &ws) {
+  auto T = observation.size();
+  auto state_count = this->state_count();
+  const auto &gamma = ws.gamma_;
+
+  Eigen::VectorXd new_initial = gamma.rowwise().sum() / T;
+  Eigen::MatrixXd new_transition = transition_p();
+  Eigen::MatrixXd new_durations = duration_p_;
+  for (int i = 0; i < state_count; i++) {
+    auto jumps = ws.sigma_xi_.row(i).sum();
+    if (jumps > 0) {
+      new_transition.row(i) = ws.sigma_xi_.row(i) / jumps;
+    }
+    auto segments = ws.sigma_eta_.col(i).sum();
+    if (segments > 0) {
+      new_durations.row(i) = ws.sigma_eta_.col(i).transpose() / segments;
+    }
+  }
+  Eigen::MatrixXd new_emission =
+      Eigen::MatrixXd::Zero(state_count, alphabet_count());
+  for (int t = 0; t < T; t++) {
+    new_emission.col(observation[t]) += gamma.col(t);
+  }
+  new_emission =
+      new_emission.array().colwise() / gamma.rowwise().sum().array();
+
+  auto norm_diff = 0.0;
+  norm_diff += (new_initial - initial_p()).norm();
+  norm_diff += (new_transition - transition_p()).norm();
+  norm_diff += (new_emission - emission_p()).norm();
+  norm_diff += (new_durations - duration_p_).norm();
+
+  initial_p(new_initial);
+  transition_p(new_transition);
+  emission_p(new_emission);
+  duration_p_ = new_durations;
+
+  return norm_diff;
+}
+
+void Hsmm::Fit(const LabelTrace &observation, HsmmWorkspace &ws,
+               const int &max_iters, const double &eps) {
+  FitOptions options;
+  options.max_iters = max_iters;
+  options.eps = eps;
+  Fit(observation, ws, options);
+}
+
+bool Hsmm::Fit(const LabelTrace &observation, HsmmWorkspace &ws,
+               const FitOptions &options) {
+  auto T = observation.size();
+  if (options.acceleration != FitAcceleration::kNone ||
+      options.precision != FitPrecision::kDouble) {
+    return false;
+  }
+  auto previous_ll = -std::numeric_limits<double>::infinity();
+  ws.last_iter_ = 0;
+  for (int i = 0; i < options.max_iters; ws.last_iter_ = ++i) {
+    Expectation(observation, ws);
+    ws.log_likelihood_ = ws.scale_.head(T).array().log().sum();
+    auto norm_diff = Maximization(observation, ws);
+    FitIteration iteration;
+    iteration.iter = i + 1;
+    iteration.em_steps = 1;
+    iteration.log_likelihood = ws.log_likelihood_;
+    iteration.param_delta = norm_diff;
+    if (!ObserveIteration(options, iteration) || norm_diff <= options.eps ||
+        (options.log_likelihood_eps > 0 &&
+         ws.log_likelihood_ - previous_ll < options.log_likelihood_eps)) {
+      ws.last_iter_ = i + 1;
+      break;
+    }
+    previous_ll = ws.log_likelihood_;
+  }
+  LogLikelihood(observation, ws);
+  return true;
+}
+
+// Observation explanation: viterbi in log space. psi is -1 where the state
+// continues from (j, d + 1), otherwise the state the segment was entered from.
+LabelTrace Hsmm::Decode(const LabelTrace &observation, HsmmWorkspace &ws) const {
+  static constexpr double kNegInf = -std::numeric_limits<double>::infinity();
+  auto T = observation.size();
+  auto D = max_duration_;
+  auto N = state_count();
+  auto &delta = ws.delta_;
+  auto &psi = ws.psi_;
+  delta.resize(N * D, T);
+  psi.resize(N * D, T);
+  Eigen::MatrixXd log_transition = transition_p().array().log();
+  Eigen::MatrixXd log_emission = emission_p().array().log();
+  Eigen::MatrixXd log_durations = duration_p_.transpose().array().log();
+  auto psi_at = [&psi, D](const int &t) {
+    return Eigen::Map<Eigen::MatrixXi>(psi.col(t).data(), D, psi.rows() / D);
+  };
+
+  // basis step
+  auto first = At(delta, 0, D);
+  for (int j = 0; j < N; j++) {
+    first.col(j) = log_durations.col(j).array() + std::log(initial_p()(j)) +
+                   log_emission(j, observation[0]);
+  }
+  // inductive step
+  for (int t = 1; t < T; t++) {
+    auto previous = At(delta, t - 1, D);
+    auto current = At(delta, t, D);
+    auto back = psi_at(t);
+    for (int j = 0; j < N; j++) {
+      int from;
+      auto enter =
+          (previous.row(0).transpose() + log_transition.col(j)).maxCoeff(&from);
+      for (int d = 0; d < D; d++) {
+        auto stay = d + 1 < D ? previous(d + 1, j) : kNegInf;
+        auto start = enter + log_durations(d, j);
+        if (stay >= start) {
+          current(d, j) = stay;
+          back(d, j) = -1;
+        } else {
+          current(d, j) = start;
+          back(d, j) = from;
+        }
+        current(d, j) += log_emission(j, observation[t]);
+      }
+    }
+  }
+  // backtrack, the last segment may be cut short by the end of the trace
+  int d, j;
+  At(delta, T - 1, D).maxCoeff(&d, &j);
+  std::vector<int> path(T);
+  for (int t = T - 1; t > 0; t--) {
+    path[t] = j;
+    auto from = psi_at(t)(d, j);
+    if (from == -1) {
+      d++;
+    } else {
+      j = from;
+      d = 0;
+    }
+  }
+  path[0] = j;
+  LabelTrace decoded;
+  for (const auto &s : path) {
+    decoded.Append(s);
+  }
+  return decoded;
+}
@@ -0,0 +1,143 @@
+#ifndef __HSMM_H__
+#define __HSMM_H__
+
+#include <string>
+
+#include "hmm.hh"
+
+namespace org::mcss {
+class Hsmm;
+
+// Caller-owned inference state for Hsmm, see HmmWorkspace. Forward and
+// backward variables are kept per (state, remaining duration), so they take
+// state_count * max_duration doubles per time step.
+class HsmmWorkspace {
+ private:
+  static const int kBeginState = -1;
+
+  MarkovRandom rand_;
+  int current_state_ = kBeginState;
+  int remaining_ = 0;
+
+  // column t holds a max_duration x state_count block, row d - 1 of column
+  // j being state j with d steps left including t
+  Eigen::MatrixXd alpha_;
+  Eigen::MatrixXd beta_;
+  Eigen::MatrixXd gamma_;
+  Eigen::VectorXd scale_;
+  Eigen::MatrixXd sigma_xi_;
+  Eigen::MatrixXd sigma_eta_;
+  Eigen::MatrixXd weight_;
+  Eigen::VectorXd enter_;
+  Eigen::VectorXd start_;
+
+  // viterbi
+  Eigen::MatrixXd delta_;
+  Eigen::MatrixXi psi_;
+
+  double log_likelihood_ = 0;
+  int last_iter_ = 0;
+
+  friend class Hsmm;
+
+ protected:
+  void Reserve(const int &state_count, const int &max_duration, const int &T) {
+    alpha_.resize(state_count * max_duration, T);
+    beta_.resize(state_count * max_duration, T);
+    gamma_.resize(state_count, T);
+    scale_.resize(T);
+    sigma_xi_.resize(state_count, state_count);
+    sigma_eta_.resize(max_duration, state_count);
+    weight_.resize(max_duration, state_count);
+    enter_.resize(state_count);
+    start_.resize(state_count);
+  }
+
+ public:
+  HsmmWorkspace() {}
+  HsmmWorkspace(int seed) : rand_(seed) {}
+
+  void Reset() {
+    current_state_ = kBeginState;
+    remaining_ = 0;
+  }
+
+  const Eigen::MatrixXd &gamma() const { return gamma_; }
+  const double &log_likelihood() const { return log_likelihood_; }
+  const int &last_iter() const { return last_iter_; }
+  const int &current_state() const { return current_state_; }
+};
+
+// Hidden semi-markov model with explicit state durations 1..max_duration.
+// The embedded jump chain and the emissions are an Hmm; self transitions
+// of the jump chain are allowed but usually zero, a state's dwell time being
+// given by its duration distribution instead.
+class Hsmm {
+ private:
+  MarkovRandom rand_;
+
+  Hmm hmm_;
+  int max_duration_;
+  // duration_p_(j, d - 1) = P(state j lasts d steps)
+  Eigen::MatrixXd duration_p_;
+
+  static constexpr int kMaxIters = 1000;
+  static constexpr double kEps = 1e-5;
+
+ protected:
+  void Forward(const LabelTrace &observation, HsmmWorkspace &ws) const;
+  void Backward(const LabelTrace &observation, HsmmWorkspace &ws) const;
+  void Expectation(const LabelTrace &observation, HsmmWorkspace &ws) const;
+  double Maximization(const LabelTrace &observation, HsmmWorkspace &ws);
+
+ public:
+  Hsmm(const int &state_count, const int &alphabet_count,
+       const int &max_duration);
+  Hsmm(const int &state_count, const int &alphabet_count,
+       const Eigen::VectorXd &p0, const Eigen::MatrixXd &p,
+       const Eigen::MatrixXd &b, const Eigen::MatrixXd &durations);
+
+  std::string Str() const;
+
+  // simulation
+  int Next(HsmmWorkspace &ws) const;
+
+  // random parameters without self transitions
+  void InitRandom();
+
+  // Likelihood estimation: forward-backward over (state, duration)
+  const Eigen::MatrixXd &Posterior(const LabelTrace &observation,
+                                   HsmmWorkspace &ws) const;
+  double LogLikelihood(const LabelTrace &observation,
+                       HsmmWorkspace &ws) const;
+
+  // Parameter estimation: EM over transitions, emissions and durations
+  void Fit(const LabelTrace &observation, HsmmWorkspace &ws,
+           const int &max_iters = kMaxIters, const double &eps = kEps);
+  // Plain EM only: false, and nothing fitted, for kSquarem or kMixed. The
+  // observer gets every iteration without phase timings.
+  bool Fit(const LabelTrace &observation, HsmmWorkspace &ws,
+           const FitOptions &options);
+
+  // Observation explanation: viterbi over (state, duration)
+  LabelTrace Decode(const LabelTrace &observation, HsmmWorkspace &ws) const;
+
+  // getter
+  const Hmm &hmm() const { return hmm_; }
+  const int &state_count() const { return hmm_.state_count(); }
+  const int &alphabet_count() const { return hmm_.alphabet_count(); }
+  const int &max_duration() const { return max_duration_; }
+  const Eigen::VectorXd &initial_p() const { return hmm_.dtmc().initial_p(); }
+  const Eigen::MatrixXd &transition_p() const {
+    return hmm_.dtmc().transition_p();
+  }
+  const Eigen::MatrixXd &emission_p() const { return hmm_.emission_p(); }
+  const Eigen::MatrixXd &duration_p() const { return duration_p_; }
+  void initial_p(const Eigen::VectorXd &v) { hmm_.initial_p(v); }
+  void transition_p(const Eigen::MatrixXd &m) { hmm_.dtmc().transition_p(m); }
+  void emission_p(const Eigen::MatrixXd &m) { hmm_.emission_p(m); }
+  void duration_p(const Eigen::MatrixXd &m) { duration_p_ = m; }
+};
+}  // namespace org::mcss
+
+#endif  // __HSMM_H__
@@ -6,7 +6,7 @@
 #include <string>
 #include <vector>
 
-#include "trace.h"
+#include "trace.hh"
 
 namespace org::mcss {
 class LabelTrace : public trace {
@@ -16,10 +16,13 @@ class LabelTrace : public trace {
  public:
   LabelTrace() {}
   LabelTrace(const LabelTrace &t) { container_ = t.container_; }
+  LabelTrace(LabelTrace &&) = default;
+  LabelTrace &operator=(const LabelTrace &) = default;
+  LabelTrace &operator=(LabelTrace &&) = default;
   LabelTrace(const std::string &str) { FromStr(str); }
 
   const int &operator[](const int &i) const { return container_[i]; }
-  const std::vector<int> &container() { return container_; }
+  const std::vector<int> &container() const { return container_; }
   size_t size() const { return std::move(container_.size()); }
 
   void FromStr(const std::string &str) override {
@@ -41,6 +44,10 @@ class LabelTrace : public trace {
 
   void Flush() override { container_.clear(); }
   void Append(const int &e) { container_.push_back(e); }
+  void Append(const int *begin, const int *end) {
+    container_.insert(container_.end(), begin, end);
+  }
+  void Reserve(const size_t &n) { container_.reserve(n); }
 };
 }  // namespace org::mcss
 
@@ -1,7 +1,19 @@
 #include "labelled_dtmc.hh"
 
+#include <cmath>
+
 using namespace org::mcss;
 
+LabelledDtmc::LabelledDtmc(int state_count, int alphabet_count,
+                           const std::vector<int> &labels)
+    : Hmm(state_count, alphabet_count) {
+  Eigen::MatrixXd label_map = Eigen::MatrixXd::Zero(state_count, alphabet_count);
+  for (int s = 0; s < state_count; s++) {
+    label_map(s, labels.at(s)) = 1;
+  }
+  emission_p(label_map);
+}
+
 double LabelledDtmc::UpdateParams(const Eigen::VectorXd &new_initial,
                                   const Eigen::MatrixXd &new_transition) {
   auto norm_diff = 0.0;
@@ -23,14 +35,80 @@ double LabelledDtmc::UpdateParams(const Eigen::MatrixXd &new_transition) {
   return norm_diff;
 }
 
-double LabelledDtmc::Maximization(const LabelTrace &observation) {
+double LabelledDtmc::Maximization(const LabelTrace &, HmmWorkspace &ws) {
+  // initial distribution and label map stay as given
+  auto norm_diff = UpdateParams(ExpectedTransition(ws));
+  return norm_diff;
+}
+
+int LabelledDtmc::ParamCount() const {
+  return state_count() * state_count();
+}
+
+bool LabelledDtmc::StateOfLabel(std::vector<int> &state_of_label) const {
+  const auto &label_map = emission_p();
+  if (label_map.rows() != label_map.cols()) {
+    return false;
+  }
+  state_of_label.assign(alphabet_count(), -1);
+  for (int s = 0; s < label_map.rows(); s++) {
+    int label;
+    if (label_map.row(s).maxCoeff(&label) != 1.0 ||
+        label_map.row(s).sum() != 1.0 || state_of_label[label] != -1) {
+      return false;
+    }
+    state_of_label[label] = s;
+  }
+  return true;
+}
+
+// Exact maximum likelihood estimate when states are observed: normalised
+// transition counts. Rows of states never left keep their old values.
+void LabelledDtmc::FitByCounting(const LabelTrace &observation,
+                                 const std::vector<int> &state_of_label,
+                                 HmmWorkspace &ws) {
   auto T = observation.size();
+  if (T == 0) {
+    // nothing to count, the model is left as it is
+    FitResult(ws, 0, 0);
+    return;
+  }
   auto state_count = dtmc().state_count();
+  Eigen::MatrixXd counts = Eigen::MatrixXd::Zero(state_count, state_count);
+  auto previous = state_of_label[observation[0]];
+  for (int t = 1; t < T; t++) {
+    auto current = state_of_label[observation[t]];
+    counts(previous, current) += 1;
+    previous = current;
+  }
+  Eigen::MatrixXd new_transition = dtmc().transition_p();
+  for (int i = 0; i < state_count; i++) {
+    auto row_sum = counts.row(i).sum();
+    if (row_sum > 0) {
+      new_transition.row(i) = counts.row(i) / row_sum;
+    }
+  }
+  UpdateParams(new_transition);
 
-  //Eigen::VectorXd new_initial = gamma().rowwise().sum() / T;
-  Eigen::MatrixXd new_transition =
-      sigma_xi().array().colwise() / gamma().rowwise().sum().array();
-  //auto norm_diff = UpdateParams(new_initial, new_transition);
-  auto norm_diff = UpdateParams(new_transition);
-  return norm_diff;
+  const auto &transition_p = dtmc().transition_p();
+  auto log_likelihood = std::log(dtmc().initial_p()(state_of_label[observation[0]]));
+  for (int i = 0; i < state_count; i++) {
+    for (int j = 0; j < state_count; j++) {
+      if (counts(i, j) > 0) {
+        log_likelihood += counts(i, j) * std::log(transition_p(i, j));
+      }
+    }
+  }
+  Score(ws, log_likelihood);
+  FitResult(ws, 1, 0);
+}
+
+void LabelledDtmc::Fit(const LabelTrace &observation, HmmWorkspace &ws,
+                       const FitOptions &options) {
+  std::vector<int> state_of_label;
+  if (StateOfLabel(state_of_label)) {
+    FitByCounting(observation, state_of_label, ws);
+  } else {
+    Hmm::Fit(observation, ws, options);
+  }
 }
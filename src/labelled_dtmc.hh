@@ -1,19 +1,40 @@
 #ifndef __LABELLED_DTMC_H__
 #define __LABELLED_DTMC_H__
 
-#include "hmm.h"
+#include <vector>
+
+#include "hmm.hh"
 
 namespace org::mcss {
+// Dtmc observed through a fixed state -> label map. The emission matrix is
+// the 0/1 label map and is never re-estimated, only the transitions are fit.
+// When every label belongs to exactly one state the trace reveals the state
+// path, and Fit counts transitions directly instead of running EM.
 class LabelledDtmc : public Hmm {
  protected:
   double UpdateParams(const Eigen::VectorXd &, const Eigen::MatrixXd &);
   double UpdateParams(const Eigen::MatrixXd &);
-  double Maximization(const LabelTrace &observation);
+  double Maximization(const LabelTrace &observation,
+                      HmmWorkspace &ws) override;
+  int ParamCount() const override;
+
+  // state of each label, if the label map is one-to-one
+  bool StateOfLabel(std::vector<int> &state_of_label) const;
+  void FitByCounting(const LabelTrace &observation,
+                     const std::vector<int> &state_of_label,
+                     HmmWorkspace &ws);
 
  public:
   LabelledDtmc(int state_count, int alphabet_count)
       : Hmm(state_count, alphabet_count) {}
+  // labels[s] is the label of state s
+  LabelledDtmc(int state_count, int alphabet_count,
+               const std::vector<int> &labels);
+
+  using Hmm::Fit;
+  void Fit(const LabelTrace &observation, HmmWorkspace &ws,
+           const FitOptions &options) override;
 };
 }  // namespace org::mcss
 
-#endif  // !__LABELLED_DTMC_H__
\ No newline at end of file
+#endif  // !__LABELLED_DTMC_H__
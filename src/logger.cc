@@ -0,0 +1,160 @@
+#include "logger.hh"
+
+#include <algorithm>
+#include <ctime>
+#include <iostream>
+
+using namespace org::mcss;
+
+namespace {
+std::atomic<uint64_t> next_logger_id{0};
+}  // namespace
+
+Logger::Logger() : id_(next_logger_id++) {
+  flusher_ = std::thread(&Logger::RunFlusher, this);
+}
+
+Logger::Logger(const std::string &log_fpath) : Logger() {
+  SetLogFile(log_fpath);
+}
+
+Logger::~Logger() {
+  {
+    std::unique_lock<std::mutex> lock(wake_lock_);
+    stop_ = true;
+  }
+  wake_condition_.notify_all();
+  if (flusher_.joinable()) {
+    flusher_.join();
+  }
+}
+
+void Logger::SetLogFile(const std::string &log_fpath) {
+  std::unique_lock<std::mutex> lock(file_lock_);
+  log_fptr_.open(log_fpath, std::ios::out | std::ios::app);
+  if (!log_fptr_.is_open()) {
+    std::cerr << "[E] Unable to open log file, logging to stderr instead."
+              << std::endl;
+    log_fptr_.basic_ios<char>::rdbuf(std::cerr.rdbuf());
+  }
+}
+
+// The ring of the calling thread, registered on first use. Rings are owned
+// by the logger and outlive their threads until drained.
+Logger::Ring &Logger::LocalRing() {
+  thread_local std::vector<std::pair<uint64_t, Ring *>> local_rings;
+  for (const auto &[id, ring] : local_rings) {
+    if (id == id_) {
+      return *ring;
+    }
+  }
+  auto ring = std::make_unique<Ring>();
+  auto raw = ring.get();
+  {
+    std::unique_lock<std::mutex> lock(rings_lock_);
+    rings_.push_back(std::move(ring));
+  }
+  local_rings.emplace_back(id_, raw);
+  return *raw;
+}
+
+// Next free record, waits for the flusher while the ring is full
+Logger::Record &Logger::Claim(Ring &ring) {
+  auto tail = ring.tail_.load(std::memory_order_relaxed);
+  while (tail - ring.head_.load(std::memory_order_acquire) >= kRingSize) {
+    Wake();
+    std::this_thread::yield();
+  }
+  return ring.records_[tail % kRingSize];
+}
+
+const std::string &Logger::FormatTime(const int64_t &time_ns) {
+  // localtime is only worth calling once per second
+  auto second = time_ns / 1000000000;
+  if (second != cached_second_) {
+    std::time_t now = second;
+    std::tm tm;
+    localtime_r(&now, &tm);
+    char buf[64];
+    auto size = std::strftime(buf, sizeof(buf), "%F %T%z", &tm);
+    cached_time_.assign(buf, size);
+    cached_second_ = second;
+  }
+  return cached_time_;
+}
+
+size_t Logger::Drain() {
+  std::vector<Ring *> rings;
+  {
+    std::unique_lock<std::mutex> lock(rings_lock_);
+    for (const auto &ring : rings_) {
+      rings.push_back(ring.get());
+    }
+  }
+  for (auto ring : rings) {
+    auto head = ring->head_.load(std::memory_order_relaxed);
+    auto tail = ring->tail_.load(std::memory_order_acquire);
+    for (; head != tail; head++) {
+      const auto &record = ring->records_[head % kRingSize];
+      std::string line;
+      line.reserve(64);
+      line += FormatTime(record.time_ns);
+      line += record.level == Level::kError ? " : [ERROR] " : " : [INFO] ";
+      record.format(record.payload, line);
+      line += '\n';
+      batch_.emplace_back(record.time_ns, std::move(line));
+    }
+    ring->head_.store(tail, std::memory_order_release);
+  }
+  if (batch_.empty()) {
+    return 0;
+  }
+  // interleave threads by time, each ring is already in order
+  std::stable_sort(
+      batch_.begin(), batch_.end(),
+      [](const auto &a, const auto &b) { return a.first < b.first; });
+  auto count = batch_.size();
+  {
+    std::unique_lock<std::mutex> lock(file_lock_);
+    for (const auto &entry : batch_) {
+      log_fptr_ << entry.second;
+    }
+    log_fptr_.flush();
+  }
+  batch_.clear();
+  return count;
+}
+
+void Logger::RunFlusher() {
+  while (true) {
+    uint64_t requested;
+    bool stop;
+    {
+      std::unique_lock<std::mutex> lock(wake_lock_);
+      wake_condition_.wait_for(lock, kFlushInterval, [this]() {
+        return stop_ || pending_ || flush_requested_ > flush_done_;
+      });
+      pending_ = false;
+      requested = flush_requested_;
+      stop = stop_;
+    }
+    Drain();
+    {
+      std::unique_lock<std::mutex> lock(wake_lock_);
+      flush_done_ = requested;
+    }
+    flushed_condition_.notify_all();
+    if (stop) {
+      return;
+    }
+  }
+}
+
+void Logger::Dump() {
+  std::unique_lock<std::mutex> lock(wake_lock_);
+  auto ticket = ++flush_requested_;
+  wake_condition_.notify_one();
+  flushed_condition_.wait(lock, [this, ticket]() {
+    return flush_done_ >= ticket || stop_;
+  });
+}
@@ -0,0 +1,213 @@
+#ifndef __LOGGER_H__
+#define __LOGGER_H__
+
+#include <atomic>
+#include <charconv>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// Asynchronous buffered logger. Every logging thread owns a lock-free
+// single-producer ring of fixed-size records; a log call only copies its
+// arguments into the next record. A background thread drains the rings,
+// formats timestamps and arguments, and writes to the log file.
+namespace org::mcss {
+class Logger {
+ public:
+  enum class Level : uint8_t { kInfo, kError };
+
+ private:
+  static constexpr size_t kPayloadSize = 232;
+  static constexpr size_t kRingSize = 1024;
+  static constexpr auto kFlushInterval = std::chrono::milliseconds(50);
+  // string length marking a spilled heap string in the payload
+  static constexpr uint16_t kSpilled = 0xffff;
+
+  struct Record {
+    int64_t time_ns;
+    void (*format)(const char *payload, std::string &out);
+    Level level;
+    char payload[kPayloadSize];
+  };
+
+  class Ring {
+   public:
+    alignas(64) std::atomic<size_t> head_{0};  // next record to drain
+    alignas(64) std::atomic<size_t> tail_{0};  // next record to fill
+    Record records_[kRingSize];
+  };
+
+  // arguments are stored as arithmetic values or as strings
+  template <typename T>
+  using Stored = std::conditional_t<std::is_arithmetic_v<std::decay_t<T>>,
+                                    std::decay_t<T>, std::string_view>;
+
+  const uint64_t id_;
+  std::mutex rings_lock_;
+  std::vector<std::unique_ptr<Ring>> rings_;
+
+  std::mutex file_lock_;
+  std::ofstream log_fptr_;
+
+  std::atomic<bool> stop_ = false;
+  // a ring is filling up, drain before the flush interval is over
+  std::atomic<bool> pending_ = false;
+  std::mutex wake_lock_;
+  std::condition_variable wake_condition_;
+  std::condition_variable flushed_condition_;
+  uint64_t flush_requested_ = 0;
+  uint64_t flush_done_ = 0;
+  std::thread flusher_;
+
+  // flusher state
+  std::vector<std::pair<int64_t, std::string>> batch_;
+  int64_t cached_second_ = -1;
+  std::string cached_time_;
+
+ protected:
+  Ring &LocalRing();
+  Record &Claim(Ring &ring);
+  void Wake() {
+    if (!pending_.exchange(true, std::memory_order_relaxed)) {
+      wake_condition_.notify_one();
+    }
+  }
+
+  // Minimum payload bytes of the arguments: strings need at least room for
+  // the length and a spill pointer.
+  template <typename... TArgs>
+  static constexpr size_t PayloadSize() {
+    return (0 + ... + (std::is_arithmetic_v<Stored<TArgs>>
+                           ? sizeof(Stored<TArgs>)
+                           : sizeof(uint16_t) + sizeof(std::string *)));
+  }
+
+  template <typename T>
+  static char *Put(char *p, char *end, const T &value) {
+    if constexpr (std::is_arithmetic_v<T>) {
+      std::memcpy(p, &value, sizeof(T));
+      return p + sizeof(T);
+    } else {
+      std::string_view s(value);
+      if (p + sizeof(uint16_t) + s.size() <= end && s.size() < kSpilled) {
+        auto size = static_cast<uint16_t>(s.size());
+        std::memcpy(p, &size, sizeof(size));
+        std::memcpy(p + sizeof(size), s.data(), s.size());
+        return p + sizeof(size) + s.size();
+      }
+      // too long for the record, hand a copy over to the flusher
+      auto spilled = new std::string(s);
+      std::memcpy(p, &kSpilled, sizeof(kSpilled));
+      std::memcpy(p + sizeof(kSpilled), &spilled, sizeof(spilled));
+      return p + sizeof(kSpilled) + sizeof(spilled);
+    }
+  }
+
+  // keep room for the minimum size of the arguments still to come
+  template <typename T, typename... TRest>
+  static void PutAll(char *p, char *end, const T &value,
+                     const TRest &...rest) {
+    p = Put<Stored<T>>(p, end - PayloadSize<TRest...>(), Stored<T>(value));
+    if constexpr (sizeof...(TRest) > 0) {
+      PutAll(p, end, rest...);
+    }
+  }
+
+  template <typename T>
+  static const char *Get(const char *p, std::string &out) {
+    if constexpr (std::is_same_v<T, bool>) {
+      bool value;
+      std::memcpy(&value, p, sizeof(value));
+      out += value ? "true" : "false";
+      return p + sizeof(value);
+    } else if constexpr (std::is_same_v<T, char>) {
+      out += *p;
+      return p + 1;
+    } else if constexpr (std::is_arithmetic_v<T>) {
+      T value;
+      std::memcpy(&value, p, sizeof(value));
+      char buf[32];
+      auto result = std::to_chars(buf, buf + sizeof(buf), value);
+      out.append(buf, result.ptr);
+      return p + sizeof(value);
+    } else {
+      uint16_t size;
+      std::memcpy(&size, p, sizeof(size));
+      p += sizeof(size);
+      if (size == kSpilled) {
+        std::string *spilled;
+        std::memcpy(&spilled, p, sizeof(spilled));
+        out += *spilled;
+        delete spilled;
+        return p + sizeof(spilled);
+      }
+      out.append(p, size);
+      return p + size;
+    }
+  }
+
+  template <typename... TStored>
+  static void Format(const char *payload, std::string &out) {
+    ((payload = Get<TStored>(payload, out)), ...);
+  }
+
+  template <typename... TArgs>
+  void Log(const Level &level, const TArgs &...args) {
+    static_assert(PayloadSize<TArgs...>() <= kPayloadSize,
+                  "too many arguments for one log record");
+    auto &ring = LocalRing();
+    auto &record = Claim(ring);
+    record.time_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                         std::chrono::system_clock::now().time_since_epoch())
+                         .count();
+    record.level = level;
+    record.format = &Format<Stored<TArgs>...>;
+    if constexpr (sizeof...(TArgs) > 0) {
+      PutAll(record.payload, record.payload + kPayloadSize, args...);
+    }
+    auto tail = ring.tail_.load(std::memory_order_relaxed);
+    ring.tail_.store(tail + 1, std::memory_order_release);
+    if (tail + 1 - ring.head_.load(std::memory_order_relaxed) > kRingSize / 2) {
+      Wake();
+    }
+  }
+
+  void RunFlusher();
+  // drain all rings and write, returns the number of records written
+  size_t Drain();
+  const std::string &FormatTime(const int64_t &time_ns);
+
+ public:
+  Logger(const std::string &log_fpath);
+  Logger();
+  ~Logger();
+
+  void SetLogFile(const std::string &log_fpath);
+
+  // Arguments are concatenated; numbers and strings are copied into the
+  // record and only formatted on the flusher thread.
+  template <typename... TArgs>
+  void LogInfo(const TArgs &...args) {
+    Log(Level::kInfo, args...);
+  }
+  template <typename... TArgs>
+  void LogError(const TArgs &...args) {
+    Log(Level::kError, args...);
+  }
+
+  // block until everything logged so far is written out
+  void Dump();
+};
+}  // namespace org::mcss
+
+#endif  // __LOGGER_H__
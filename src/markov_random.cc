@@ -9,6 +9,11 @@ void MarkovRandom::reset()
   generator_ = std::mt19937_64(seed_);
 }
 
+void MarkovRandom::reset(const int &seed) {
+  seed_ = seed;
+  generator_.seed(seed);
+}
+
 MarkovRandom::MarkovRandom(int seed)
   : seed_(seed),
     generator_(std::mt19937_64(seed))
@@ -46,6 +51,11 @@ double MarkovRandom::RandomProbUniform()
   return distribution(generator_);
 }
 
+double MarkovRandom::RandomNormal(const double &mean, const double &stddev) {
+  std::normal_distribution<double> distribution(mean, stddev);
+  return distribution(generator_);
+}
+
 Eigen::VectorXd MarkovRandom::RandomStochasticVector(const int &dim) {
   auto v = Eigen::VectorXd(dim);
   for (int i = 0; i < v.size(); i++) {
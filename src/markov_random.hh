@@ -17,12 +17,15 @@ public:
   MarkovRandom(int seed);
 
   void reset();
+  // restart from a new seed
+  void reset(const int &seed);
 
   int ChooseUniform(const int &n_states);
   int ChooseDirichlet(const std::vector<double> &distribution);
   int ChooseDirichlet(const Eigen::VectorXd &distribution);
 
   double RandomProbUniform();
+  double RandomNormal(const double &mean, const double &stddev);
 
   Eigen::MatrixXd RandomStochasticMatrix(const int &row, const int &col);
   Eigen::VectorXd RandomStochasticVector(const int &dim);
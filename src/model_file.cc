@@ -0,0 +1,460 @@
+#include "model_file.hh"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <utility>
+#include <vector>
+
+using namespace org::mcss;
+
+constexpr char ModelFile::kMagic[8];
+
+void org::mcss::BuildAliasTables(const Eigen::MatrixXd &p,
+                                 Eigen::MatrixXd &alias_p,
+                                 Eigen::MatrixXi &alias) {
+  auto K = p.cols();
+  alias_p.resize(K, p.rows());
+  alias.resize(K, p.rows());
+  std::vector<int> small, large;
+  Eigen::VectorXd q(K);
+  for (int r = 0; r < p.rows(); r++) {
+    auto prob = alias_p.col(r);
+    auto other = alias.col(r);
+    prob.setOnes();
+    other = Eigen::VectorXi::LinSpaced(K, 0, K - 1);
+    auto sum = p.row(r).sum();
+    if (!(sum > 0)) {
+      continue;
+    }
+    q = p.row(r).transpose() * (K / sum);
+    small.clear();
+    large.clear();
+    for (int k = 0; k < K; k++) {
+      (q(k) < 1 ? small : large).push_back(k);
+    }
+    while (!small.empty() && !large.empty()) {
+      auto s = small.back();
+      small.pop_back();
+      auto l = large.back();
+      prob(s) = q(s);
+      other(s) = l;
+      q(l) += q(s) - 1;
+      if (q(l) < 1) {
+        large.pop_back();
+        small.push_back(l);
+      }
+    }
+    // whatever is left is 1 up to rounding and keeps its own column
+  }
+}
+
+namespace {
+size_t AlignUp(const size_t &n) {
+  return (n + ModelFile::kAlignment - 1) / ModelFile::kAlignment *
+         ModelFile::kAlignment;
+}
+
+bool WriteAll(const int &fd, const char *data, size_t size) {
+  while (size > 0) {
+    auto written = ::write(fd, data, size);
+    if (written < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return false;
+    }
+    data += written;
+    size -= written;
+  }
+  return true;
+}
+
+// make a rename in the directory of path durable
+void SyncDirectory(const std::string &path) {
+  auto slash = path.rfind('/');
+  auto directory = slash == std::string::npos ? std::string(".")
+                   : slash == 0               ? std::string("/")
+                                              : path.substr(0, slash);
+  auto fd = ::open(directory.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+  if (fd >= 0) {
+    ::fsync(fd);
+    ::close(fd);
+  }
+}
+
+// Sections collected in memory and written out in one go
+class ModelWriter {
+ private:
+  struct Pending {
+    ModelSection section;
+    std::vector<char> bytes;
+  };
+  std::vector<Pending> sections_;
+
+  template <typename TMatrix>
+  void Add(const SectionId &id, const SectionType &type, const TMatrix &m) {
+    Pending pending{};
+    pending.section.id = static_cast<uint32_t>(id);
+    pending.section.type = static_cast<uint32_t>(type);
+    pending.section.rows = m.rows();
+    pending.section.cols = m.cols();
+    auto bytes = m.size() * sizeof(typename TMatrix::Scalar);
+    pending.bytes.resize(bytes);
+    std::memcpy(pending.bytes.data(), m.data(), bytes);
+    sections_.push_back(std::move(pending));
+  }
+
+ public:
+  void Add(const SectionId &id, const Eigen::MatrixXd &m) {
+    Add(id, SectionType::kFloat64, m);
+  }
+  void Add(const SectionId &id, const Eigen::MatrixXi &m) {
+    Add(id, SectionType::kInt32, m);
+  }
+
+  // stochastic rows with their logarithms and alias tables
+  void AddDistribution(const SectionId &p, const SectionId &log_p,
+                       const SectionId &alias_p, const SectionId &alias,
+                       const Eigen::MatrixXd &m) {
+    Eigen::MatrixXd table_p;
+    Eigen::MatrixXi table;
+    BuildAliasTables(m, table_p, table);
+    Add(p, m);
+    Add(log_p, Eigen::MatrixXd(m.array().log()));
+    Add(alias_p, table_p);
+    Add(alias, table);
+  }
+
+  void AddChain(const Dtmc &dtmc) {
+    Eigen::MatrixXd initial = dtmc.initial_p().transpose();
+    AddDistribution(SectionId::kInitial, SectionId::kLogInitial,
+                    SectionId::kInitialAliasP, SectionId::kInitialAlias,
+                    initial);
+    AddDistribution(SectionId::kTransition, SectionId::kLogTransition,
+                    SectionId::kTransitionAliasP, SectionId::kTransitionAlias,
+                    dtmc.transition_p());
+  }
+
+  void AddEmission(const Hmm &hmm) {
+    AddDistribution(SectionId::kEmission, SectionId::kLogEmission,
+                    SectionId::kEmissionAliasP, SectionId::kEmissionAlias,
+                    hmm.emission_p());
+  }
+
+  // write to a temporary next to path, unique so that concurrent saves do
+  // not share it, and rename it over path once it is on disk, so readers
+  // never map a half-written file and a crash leaves the old or the new one
+  bool Write(const std::string &path, const ModelKind &kind,
+             const int &state_count, const int &alphabet_count) {
+    auto offset = AlignUp(sizeof(ModelHeader) +
+                          sections_.size() * sizeof(ModelSection));
+    for (auto &pending : sections_) {
+      pending.section.offset = offset;
+      offset = AlignUp(offset + pending.bytes.size());
+    }
+    std::vector<char> file(offset, 0);
+    ModelHeader header{};
+    std::memcpy(header.magic, ModelFile::kMagic, sizeof(header.magic));
+    header.version = ModelFile::kVersion;
+    header.kind = static_cast<uint32_t>(kind);
+    header.state_count = state_count;
+    header.alphabet_count = alphabet_count;
+    header.section_count = sections_.size();
+    header.byte_order = ModelFile::kByteOrder;
+    header.file_size = file.size();
+    std::memcpy(file.data(), &header, sizeof(header));
+    auto table = file.data() + sizeof(header);
+    for (const auto &pending : sections_) {
+      std::memcpy(table, &pending.section, sizeof(ModelSection));
+      table += sizeof(ModelSection);
+      std::copy(pending.bytes.begin(), pending.bytes.end(),
+                file.begin() + pending.section.offset);
+    }
+
+    auto temporary = path + ".XXXXXX";
+    auto fd = ::mkstemp(temporary.data());
+    if (fd < 0) {
+      return false;
+    }
+    // mkstemp creates the file for the owner only; models are shared with
+    // readers such as the server
+    auto written = ::fchmod(fd, 0644) == 0 &&
+                   WriteAll(fd, file.data(), file.size()) && ::fsync(fd) == 0;
+    if (::close(fd) != 0 || !written ||
+        std::rename(temporary.c_str(), path.c_str()) != 0) {
+      std::remove(temporary.c_str());
+      return false;
+    }
+    SyncDirectory(path);
+    return true;
+  }
+};
+
+struct Expected {
+  SectionId id;
+  SectionType type;
+  int rows;
+  int cols;
+};
+}  // namespace
+
+bool ModelFile::Save(const std::string &path, const Dtmc &model) {
+  ModelWriter writer;
+  writer.AddChain(model);
+  return writer.Write(path, ModelKind::kDtmc, model.state_count(), 0);
+}
+
+bool ModelFile::Save(const std::string &path, const Hmm &model) {
+  ModelWriter writer;
+  writer.AddChain(model.dtmc());
+  writer.AddEmission(model);
+  return writer.Write(path, ModelKind::kHmm, model.state_count(),
+                      model.alphabet_count());
+}
+
+bool ModelFile::Save(const std::string &path, const LabelledDtmc &model) {
+  ModelWriter writer;
+  writer.AddChain(model.dtmc());
+  writer.AddEmission(model);
+  Eigen::MatrixXi labels(model.state_count(), 1);
+  for (int s = 0; s < model.state_count(); s++) {
+    model.emission_p().row(s).maxCoeff(&labels(s, 0));
+  }
+  writer.Add(SectionId::kLabels, labels);
+  return writer.Write(path, ModelKind::kLabelledDtmc, model.state_count(),
+                      model.alphabet_count());
+}
+
+ModelFile::ModelFile(ModelFile &&other) noexcept
+    : data_(other.data_), size_(other.size_), sections_(other.sections_) {
+  other.data_ = nullptr;
+  other.size_ = 0;
+  other.sections_.fill(nullptr);
+}
+
+ModelFile &ModelFile::operator=(ModelFile &&other) noexcept {
+  if (this != &other) {
+    Close();
+    std::swap(data_, other.data_);
+    std::swap(size_, other.size_);
+    std::swap(sections_, other.sections_);
+  }
+  return *this;
+}
+
+ModelFile::~ModelFile() { Close(); }
+
+bool ModelFile::Open(const std::string &path) {
+  Close();
+  auto fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    return false;
+  }
+  struct stat st;
+  if (::fstat(fd, &st) != 0 ||
+      static_cast<size_t>(st.st_size) < sizeof(ModelHeader)) {
+    ::close(fd);
+    return false;
+  }
+  auto data = ::mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  ::close(fd);
+  if (data == MAP_FAILED) {
+    return false;
+  }
+  data_ = static_cast<const char *>(data);
+  size_ = st.st_size;
+  if (!Validate()) {
+    Close();
+    return false;
+  }
+  return true;
+}
+
+void ModelFile::Close() {
+  if (data_) {
+    ::munmap(const_cast<char *>(data_), size_);
+  }
+  data_ = nullptr;
+  size_ = 0;
+  sections_.fill(nullptr);
+}
+
+const ModelSection *ModelFile::Find(const SectionId &id,
+                                    const SectionType &type) const {
+  auto s = sections_[static_cast<size_t>(id)];
+  return s && s->type == static_cast<uint32_t>(type) ? s : nullptr;
+}
+
+// Header and section table are consistent with the file, and every section
+// the kind of model needs is there with the right shape.
+bool ModelFile::Validate() {
+  const auto &h = header();
+  if (std::memcmp(h.magic, kMagic, sizeof(kMagic)) != 0 ||
+      h.version != kVersion || h.byte_order != kByteOrder ||
+      h.file_size != size_ || h.state_count <= 0 || h.alphabet_count < 0) {
+    return false;
+  }
+  if (sizeof(ModelHeader) + h.section_count * sizeof(ModelSection) > size_) {
+    return false;
+  }
+  auto sections =
+      reinterpret_cast<const ModelSection *>(data_ + sizeof(ModelHeader));
+  for (uint32_t i = 0; i < h.section_count; i++) {
+    const auto &s = sections[i];
+    size_t element;
+    if (s.type == static_cast<uint32_t>(SectionType::kFloat64)) {
+      element = sizeof(double);
+    } else if (s.type == static_cast<uint32_t>(SectionType::kInt32)) {
+      element = sizeof(int32_t);
+    } else {
+      return false;
+    }
+    if (s.rows < 0 || s.cols < 0 || s.offset % kAlignment != 0 ||
+        s.offset > size_ ||
+        static_cast<size_t>(s.rows) * s.cols * element > size_ - s.offset) {
+      return false;
+    }
+    // unknown sections are skipped, so later versions may add some
+    if (s.id > 0 && s.id < sections_.size()) {
+      sections_[s.id] = &s;
+    }
+  }
+
+  auto N = h.state_count;
+  auto A = h.alphabet_count;
+  std::vector<Expected> expected = {
+      {SectionId::kInitial, SectionType::kFloat64, 1, N},
+      {SectionId::kLogInitial, SectionType::kFloat64, 1, N},
+      {SectionId::kInitialAliasP, SectionType::kFloat64, N, 1},
+      {SectionId::kInitialAlias, SectionType::kInt32, N, 1},
+      {SectionId::kTransition, SectionType::kFloat64, N, N},
+      {SectionId::kLogTransition, SectionType::kFloat64, N, N},
+      {SectionId::kTransitionAliasP, SectionType::kFloat64, N, N},
+      {SectionId::kTransitionAlias, SectionType::kInt32, N, N},
+  };
+  switch (static_cast<ModelKind>(h.kind)) {
+    case ModelKind::kLabelledDtmc:
+      expected.push_back({SectionId::kLabels, SectionType::kInt32, N, 1});
+      [[fallthrough]];
+    case ModelKind::kHmm:
+      expected.push_back({SectionId::kEmission, SectionType::kFloat64, N, A});
+      expected.push_back({SectionId::kLogEmission, SectionType::kFloat64, N, A});
+      expected.push_back(
+          {SectionId::kEmissionAliasP, SectionType::kFloat64, A, N});
+      expected.push_back({SectionId::kEmissionAlias, SectionType::kInt32, A, N});
+      break;
+    case ModelKind::kDtmc:
+      break;
+    default:
+      return false;
+  }
+  for (const auto &e : expected) {
+    auto s = Find(e.id, e.type);
+    if (!s || s->rows != e.rows || s->cols != e.cols) {
+      return false;
+    }
+  }
+  // integer sections are indices into the model, read without further
+  // checks by the samplers and LoadLabelledDtmc
+  auto in_range = [this](const SectionId &id, const int &bound) {
+    auto index = Index(id);
+    return index.size() == 0 ||
+           ((index.array() >= 0).all() && (index.array() < bound).all());
+  };
+  if (!in_range(SectionId::kInitialAlias, N) ||
+      !in_range(SectionId::kTransitionAlias, N)) {
+    return false;
+  }
+  if (static_cast<ModelKind>(h.kind) != ModelKind::kDtmc &&
+      (!in_range(SectionId::kEmissionAlias, A) ||
+       !in_range(SectionId::kLabels, A))) {
+    return false;
+  }
+  return true;
+}
+
+ModelFile::ConstMatrixMap ModelFile::Matrix(const SectionId &id) const {
+  auto s = Find(id, SectionType::kFloat64);
+  if (!s) {
+    return ConstMatrixMap(nullptr, 0, 0);
+  }
+  return ConstMatrixMap(reinterpret_cast<const double *>(data_ + s->offset),
+                        s->rows, s->cols);
+}
+
+ModelFile::ConstIndexMap ModelFile::Index(const SectionId &id) const {
+  auto s = Find(id, SectionType::kInt32);
+  if (!s) {
+    return ConstIndexMap(nullptr, 0, 0);
+  }
+  return ConstIndexMap(reinterpret_cast<const int *>(data_ + s->offset),
+                       s->rows, s->cols);
+}
+
+ModelFile::ConstVectorMap ModelFile::initial_p() const {
+  auto m = Matrix(SectionId::kInitial);
+  return ConstVectorMap(m.data(), m.size());
+}
+
+ModelFile::ConstVectorMap ModelFile::log_initial_p() const {
+  auto m = Matrix(SectionId::kLogInitial);
+  return ConstVectorMap(m.data(), m.size());
+}
+
+int ModelFile::Sample(const SectionId &alias_p, const SectionId &alias,
+                      const int &i, MarkovRandom &rand) const {
+  auto prob = Matrix(alias_p).col(i);
+  auto other = Index(alias).col(i);
+  auto K = prob.size();
+  auto u = rand.RandomProbUniform() * K;
+  int k = std::min<int>(u, K - 1);
+  return u - k < prob(k) ? k : other(k);
+}
+
+int ModelFile::SampleInitial(MarkovRandom &rand) const {
+  return Sample(SectionId::kInitialAliasP, SectionId::kInitialAlias, 0, rand);
+}
+
+int ModelFile::SampleTransition(const int &state, MarkovRandom &rand) const {
+  return Sample(SectionId::kTransitionAliasP, SectionId::kTransitionAlias,
+                state, rand);
+}
+
+int ModelFile::SampleEmission(const int &state, MarkovRandom &rand) const {
+  return Sample(SectionId::kEmissionAliasP, SectionId::kEmissionAlias, state,
+                rand);
+}
+
+std::unique_ptr<Dtmc> ModelFile::LoadDtmc() const {
+  return std::make_unique<Dtmc>(state_count(), initial_p(), transition_p());
+}
+
+std::unique_ptr<Hmm> ModelFile::LoadHmm() const {
+  if (kind() == ModelKind::kDtmc) {
+    return nullptr;
+  }
+  return std::make_unique<Hmm>(state_count(), alphabet_count(), initial_p(),
+                               transition_p(), emission_p());
+}
+
+std::unique_ptr<LabelledDtmc> ModelFile::LoadLabelledDtmc() const {
+  if (kind() != ModelKind::kLabelledDtmc) {
+    return nullptr;
+  }
+  auto index = labels();
+  std::vector<int> state_labels(index.data(), index.data() + index.size());
+  auto model = std::make_unique<LabelledDtmc>(state_count(), alphabet_count(),
+                                              state_labels);
+  model->initial_p(initial_p());
+  model->dtmc().transition_p(transition_p());
+  model->emission_p(emission_p());
+  return model;
+}
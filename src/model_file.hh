@@ -0,0 +1,165 @@
+#ifndef __MODEL_FILE_H__
+#define __MODEL_FILE_H__
+
+#include <Eigen/Eigen>
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+#include "dtmc.hh"
+#include "hmm.hh"
+#include "labelled_dtmc.hh"
+#include "markov_random.hh"
+
+namespace org::mcss {
+enum class ModelKind : uint32_t { kDtmc = 1, kHmm = 2, kLabelledDtmc = 3 };
+
+// Binary model file, laid out so that it can be mapped and used in place:
+//
+//   ModelHeader | ModelSection[section_count] | sections
+//
+// Every section starts on a kAlignment boundary and holds a column-major
+// matrix of doubles or int32s in host byte order, exactly as Eigen stores it.
+// Besides the parameters the file carries their logarithms and alias tables
+// for O(1) sampling, so a reader does no work beyond checking the header and
+// that the indices of the int32 sections are in range.
+// Alias tables are transposed: column i is the table of row i.
+struct ModelHeader {
+  char magic[8];
+  uint32_t version;
+  uint32_t kind;
+  int32_t state_count;
+  int32_t alphabet_count;
+  uint32_t section_count;
+  // kByteOrder as written, a reader with another byte order rejects it
+  uint32_t byte_order;
+  uint64_t file_size;
+  uint8_t reserved[24];
+};
+static_assert(sizeof(ModelHeader) == 64, "ModelHeader layout");
+
+enum class SectionId : uint32_t {
+  kInitial = 1,
+  kTransition,
+  kEmission,
+  kLogInitial,
+  kLogTransition,
+  kLogEmission,
+  kInitialAliasP,
+  kInitialAlias,
+  kTransitionAliasP,
+  kTransitionAlias,
+  kEmissionAliasP,
+  kEmissionAlias,
+  kLabels,
+  kEnd,
+};
+
+enum class SectionType : uint32_t { kFloat64 = 1, kInt32 = 2 };
+
+struct ModelSection {
+  uint32_t id;
+  uint32_t type;
+  int32_t rows;
+  int32_t cols;
+  uint64_t offset;
+  uint64_t reserved;
+};
+static_assert(sizeof(ModelSection) == 32, "ModelSection layout");
+
+// Walker's alias tables for the rows of a stochastic matrix, transposed
+// as stored in the file
+void BuildAliasTables(const Eigen::MatrixXd &p, Eigen::MatrixXd &alias_p,
+                      Eigen::MatrixXi &alias);
+
+// Read-only mapping of a model file. The pages are shared with every other
+// process mapping the same file; nothing is copied until one of the Load
+// functions is called.
+class ModelFile {
+ public:
+  using ConstMatrixMap = Eigen::Map<const Eigen::MatrixXd>;
+  using ConstVectorMap = Eigen::Map<const Eigen::VectorXd>;
+  using ConstIndexMap = Eigen::Map<const Eigen::MatrixXi>;
+
+  static constexpr char kMagic[8] = {'M', 'C', 'S', 'S', 'M', 'D', 'L', '\0'};
+  static constexpr uint32_t kVersion = 1;
+  static constexpr uint32_t kByteOrder = 0x01020304;
+  static constexpr size_t kAlignment = 64;
+
+ private:
+  const char *data_ = nullptr;
+  size_t size_ = 0;
+  // section of each id, resolved once by Open
+  std::array<const ModelSection *, static_cast<size_t>(SectionId::kEnd)>
+      sections_{};
+
+  const ModelHeader &header() const {
+    return *reinterpret_cast<const ModelHeader *>(data_);
+  }
+  // null if the file has no such section of that type
+  const ModelSection *Find(const SectionId &id, const SectionType &type) const;
+  ConstMatrixMap Matrix(const SectionId &id) const;
+  ConstIndexMap Index(const SectionId &id) const;
+  // check the header and fill in sections_
+  bool Validate();
+  // alias sampling from column i of the given tables
+  int Sample(const SectionId &alias_p, const SectionId &alias, const int &i,
+             MarkovRandom &rand) const;
+
+ public:
+  ModelFile() {}
+  ModelFile(const ModelFile &) = delete;
+  ModelFile &operator=(const ModelFile &) = delete;
+  ModelFile(ModelFile &&other) noexcept;
+  ModelFile &operator=(ModelFile &&other) noexcept;
+  ~ModelFile();
+
+  // Write the model to path, atomically replacing an existing file.
+  static bool Save(const std::string &path, const Dtmc &model);
+  static bool Save(const std::string &path, const Hmm &model);
+  static bool Save(const std::string &path, const LabelledDtmc &model);
+
+  // Map path; false if it is missing, truncated, of another version, or
+  // lacks a section its kind needs, or an alias index or label is out of
+  // range. Only those integer sections are read; the probabilities are not
+  // checked.
+  bool Open(const std::string &path);
+  void Close();
+  bool is_open() const { return data_ != nullptr; }
+
+  ModelKind kind() const { return static_cast<ModelKind>(header().kind); }
+  const int32_t &state_count() const { return header().state_count; }
+  // 0 for a Dtmc
+  const int32_t &alphabet_count() const { return header().alphabet_count; }
+  size_t bytes() const { return size_; }
+
+  // parameters in place; emissions and labels are empty for a Dtmc
+  ConstVectorMap initial_p() const;
+  ConstMatrixMap transition_p() const { return Matrix(SectionId::kTransition); }
+  ConstMatrixMap emission_p() const { return Matrix(SectionId::kEmission); }
+  ConstVectorMap log_initial_p() const;
+  ConstMatrixMap log_transition_p() const {
+    return Matrix(SectionId::kLogTransition);
+  }
+  ConstMatrixMap log_emission_p() const {
+    return Matrix(SectionId::kLogEmission);
+  }
+  ConstIndexMap labels() const { return Index(SectionId::kLabels); }
+
+  // O(1) draws from the alias tables
+  int SampleInitial(MarkovRandom &rand) const;
+  int SampleTransition(const int &state, MarkovRandom &rand) const;
+  int SampleEmission(const int &state, MarkovRandom &rand) const;
+
+  // Owning copies, null if the file holds a different kind of model. Any
+  // kind loads as a Dtmc, and a LabelledDtmc also loads as an Hmm.
+  std::unique_ptr<Dtmc> LoadDtmc() const;
+  std::unique_ptr<Hmm> LoadHmm() const;
+  std::unique_ptr<LabelledDtmc> LoadLabelledDtmc() const;
+};
+}  // namespace org::mcss
+
+#endif  // __MODEL_FILE_H__
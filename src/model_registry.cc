@@ -0,0 +1,141 @@
+#include "model_registry.hh"
+
+#include <algorithm>
+
+using namespace org::mcss;
+
+ModelSnapshot::~ModelSnapshot() {
+  if (record_) {
+    record_->hazard.store(nullptr, std::memory_order_release);
+    record_->active.store(false, std::memory_order_release);
+  }
+}
+
+const Hmm *ModelSnapshot::find(const std::string &name) const {
+  auto found = catalog_->models.find(name);
+  return found == catalog_->models.end() ? nullptr : found->second.get();
+}
+
+uint64_t ModelSnapshot::version(const std::string &name) const {
+  auto found = catalog_->published.find(name);
+  return found == catalog_->published.end() ? 0 : found->second;
+}
+
+ModelRegistry::ModelRegistry() : current_(new ModelCatalog) {}
+
+ModelRegistry::~ModelRegistry() {
+  delete current_.load();
+  for (const auto *catalog : retired_) {
+    delete catalog;
+  }
+  for (auto *record = records_.load(); record;) {
+    auto *next = record->next;
+    delete record;
+    record = next;
+  }
+}
+
+HazardRecord *ModelRegistry::ClaimRecord() const {
+  for (auto *record = records_.load(std::memory_order_acquire); record;
+       record = record->next) {
+    bool expected = false;
+    if (!record->active.load(std::memory_order_relaxed) &&
+        record->active.compare_exchange_strong(expected, true,
+                                               std::memory_order_acquire)) {
+      return record;
+    }
+  }
+  // more concurrent readers than ever before, add a record
+  auto *record = new HazardRecord;
+  record->active.store(true, std::memory_order_relaxed);
+  auto *head = records_.load(std::memory_order_relaxed);
+  do {
+    record->next = head;
+  } while (!records_.compare_exchange_weak(head, record,
+                                           std::memory_order_release,
+                                           std::memory_order_relaxed));
+  return record;
+}
+
+ModelSnapshot ModelRegistry::Acquire() const {
+  auto *record = ClaimRecord();
+  // the hazard must be visible before the catalog is checked again, so a
+  // writer that swaps in between either sees it or is seen by the check
+  const ModelCatalog *catalog;
+  do {
+    catalog = current_.load();
+    record->hazard.store(catalog);
+  } while (catalog != current_.load());
+  return ModelSnapshot(record, catalog);
+}
+
+void ModelRegistry::Swap(const ModelCatalog *next) {
+  retired_.push_back(current_.exchange(next));
+  ReclaimLocked();
+}
+
+uint64_t ModelRegistry::PublishLocked(const std::string &name,
+                                      std::shared_ptr<const Hmm> model) {
+  const auto *current = current_.load();
+  auto *next = new ModelCatalog(*current);
+  next->version = current->version + 1;
+  next->models[name] = std::move(model);
+  next->published[name] = next->version;
+  Swap(next);
+  return next->version;
+}
+
+uint64_t ModelRegistry::Publish(const std::string &name,
+                                std::shared_ptr<const Hmm> model) {
+  std::lock_guard<std::mutex> guard(write_lock_);
+  return PublishLocked(name, std::move(model));
+}
+
+uint64_t ModelRegistry::Publish(const std::string &name,
+                                std::shared_ptr<const Hmm> model,
+                                const uint64_t &expected) {
+  std::lock_guard<std::mutex> guard(write_lock_);
+  const auto &published = current_.load()->published;
+  auto found = published.find(name);
+  if ((found == published.end() ? 0 : found->second) != expected) {
+    return 0;
+  }
+  return PublishLocked(name, std::move(model));
+}
+
+bool ModelRegistry::Remove(const std::string &name) {
+  std::lock_guard<std::mutex> guard(write_lock_);
+  const auto *current = current_.load();
+  if (current->models.count(name) == 0) {
+    return false;
+  }
+  auto *next = new ModelCatalog(*current);
+  next->version = current->version + 1;
+  next->models.erase(name);
+  next->published.erase(name);
+  Swap(next);
+  return true;
+}
+
+int ModelRegistry::ReclaimLocked() {
+  std::vector<const ModelCatalog *> hazards;
+  for (auto *record = records_.load(); record; record = record->next) {
+    if (const auto *hazard = record->hazard.load()) {
+      hazards.push_back(hazard);
+    }
+  }
+  auto held = std::partition(
+      retired_.begin(), retired_.end(), [&hazards](const ModelCatalog *c) {
+        return std::find(hazards.begin(), hazards.end(), c) != hazards.end();
+      });
+  for (auto it = held; it != retired_.end(); it++) {
+    delete *it;
+  }
+  retired_.erase(held, retired_.end());
+  return retired_.size();
+}
+
+int ModelRegistry::Reclaim() {
+  std::lock_guard<std::mutex> guard(write_lock_);
+  return ReclaimLocked();
+}
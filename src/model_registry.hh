@@ -0,0 +1,117 @@
+#ifndef __MODEL_REGISTRY_H__
+#define __MODEL_REGISTRY_H__
+
+#include <atomic>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "hmm.hh"
+
+namespace org::mcss {
+class ModelRegistry;
+
+// Immutable name -> model map, one per published version
+struct ModelCatalog {
+  uint64_t version = 0;
+  std::map<std::string, std::shared_ptr<const Hmm>> models;
+  // catalog version each model was published in
+  std::map<std::string, uint64_t> published;
+};
+
+// Hazard pointer of one reader; records are reused and only freed with the
+// registry
+struct HazardRecord {
+  std::atomic<bool> active{false};
+  std::atomic<const ModelCatalog *> hazard{nullptr};
+  HazardRecord *next = nullptr;
+};
+
+// A reader's view of the registry. Models found through it stay valid, and
+// unchanged, until the snapshot is destroyed, whatever writers publish in
+// the meantime. Snapshots are meant to be short lived: a held snapshot
+// keeps its catalog, and every model in it, from being reclaimed.
+class ModelSnapshot {
+ private:
+  HazardRecord *record_ = nullptr;
+  const ModelCatalog *catalog_ = nullptr;
+
+  ModelSnapshot(HazardRecord *record, const ModelCatalog *catalog)
+      : record_(record), catalog_(catalog) {}
+
+  friend class ModelRegistry;
+
+ public:
+  ModelSnapshot(const ModelSnapshot &) = delete;
+  ModelSnapshot &operator=(const ModelSnapshot &) = delete;
+  ModelSnapshot(ModelSnapshot &&other)
+      : record_(other.record_), catalog_(other.catalog_) {
+    other.record_ = nullptr;
+  }
+  ~ModelSnapshot();
+
+  // null if there is no such model
+  const Hmm *find(const std::string &name) const;
+  const uint64_t &version() const { return catalog_->version; }
+  // version that published the model, 0 if there is no such model
+  uint64_t version(const std::string &name) const;
+  const ModelCatalog &catalog() const { return *catalog_; }
+};
+
+// Models by name, swapped while they are being read. Writers copy the
+// catalog, change the copy and publish it with one atomic store; readers
+// never take a lock or wait for a writer, they announce the catalog they
+// read through a hazard pointer. Replaced catalogs are freed as soon as no
+// hazard points at them, by the next write or by Reclaim().
+//
+// Models are immutable once published: to refit, copy the model out of a
+// snapshot, fit the copy and publish it under the same name.
+class ModelRegistry {
+ private:
+  std::atomic<const ModelCatalog *> current_;
+  // grown by readers, hence mutable
+  mutable std::atomic<HazardRecord *> records_{nullptr};
+
+  // writers
+  std::mutex write_lock_;
+  std::vector<const ModelCatalog *> retired_;
+
+  HazardRecord *ClaimRecord() const;
+  // publish next and retire the current catalog, write_lock_ held
+  void Swap(const ModelCatalog *next);
+  // write_lock_ held
+  uint64_t PublishLocked(const std::string &name,
+                         std::shared_ptr<const Hmm> model);
+  // write_lock_ held
+  int ReclaimLocked();
+
+ public:
+  ModelRegistry();
+  ModelRegistry(const ModelRegistry &) = delete;
+  ModelRegistry &operator=(const ModelRegistry &) = delete;
+  // no snapshot may outlive the registry
+  ~ModelRegistry();
+
+  // readers, lock-free
+  ModelSnapshot Acquire() const;
+
+  // writers; every call publishes a new version, which Publish returns
+  uint64_t Publish(const std::string &name, std::shared_ptr<const Hmm> model);
+  // Publish only if the model under name is still the one published in
+  // expected, as read with ModelSnapshot::version(name), 0 for no model;
+  // returns 0 and changes nothing if another writer came first. A refit
+  // that released its snapshot publishes this way, so that it does not
+  // revert a replacement made while it was fitting.
+  uint64_t Publish(const std::string &name, std::shared_ptr<const Hmm> model,
+                   const uint64_t &expected);
+  // false if there is no such model
+  bool Remove(const std::string &name);
+  // free the retired catalogs no snapshot holds, returns how many are left
+  int Reclaim();
+};
+}  // namespace org::mcss
+
+#endif  // __MODEL_REGISTRY_H__
@@ -0,0 +1,99 @@
+#include "my_thread_pool.h"
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+
+namespace Mylibpp {
+
+std::vector<int> ParseCpuList(const std::string &list) {
+  std::vector<int> cpus;
+  std::stringstream stream(list);
+  std::string range;
+  while (std::getline(stream, range, ',')) {
+    char *end = nullptr;
+    auto first = std::strtol(range.c_str(), &end, 10);
+    if (end == range.c_str()) {
+      // blank, e.g. a node without CPUs
+      continue;
+    }
+    auto last = *end == '-' ? std::strtol(end + 1, nullptr, 10) : first;
+    for (auto cpu = first; cpu <= last; cpu++) {
+      cpus.push_back(cpu);
+    }
+  }
+  return cpus;
+}
+
+std::vector<int> AllowedCpus() {
+  std::vector<int> cpus;
+#ifdef __linux__
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  if (sched_getaffinity(0, sizeof(set), &set) == 0) {
+    for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+      if (CPU_ISSET(cpu, &set)) {
+        cpus.push_back(cpu);
+      }
+    }
+  }
+#endif
+  if (cpus.empty()) {
+    for (unsigned cpu = 0; cpu < std::thread::hardware_concurrency(); cpu++) {
+      cpus.push_back(cpu);
+    }
+  }
+  return cpus;
+}
+
+std::vector<std::vector<int>> NumaNodes(const std::vector<int> &cpus) {
+  std::vector<std::vector<int>> nodes;
+#ifdef __linux__
+  // node ids can have gaps after hotplug; stop after a run of missing ones
+  for (int node = 0, missing = 0; missing < 64; node++) {
+    std::ifstream file("/sys/devices/system/node/node" +
+                       std::to_string(node) + "/cpulist");
+    if (!file) {
+      missing++;
+      continue;
+    }
+    missing = 0;
+    std::string list;
+    std::getline(file, list);
+    std::vector<int> node_cpus;
+    for (auto cpu : ParseCpuList(list)) {
+      if (std::find(cpus.begin(), cpus.end(), cpu) != cpus.end()) {
+        node_cpus.push_back(cpu);
+      }
+    }
+    if (!node_cpus.empty()) {
+      nodes.push_back(node_cpus);
+    }
+  }
+#endif
+  if (nodes.empty()) {
+    nodes.push_back(cpus);
+  }
+  return nodes;
+}
+
+bool PinCurrentThread(const int &cpu) {
+#ifdef __linux__
+  if (cpu < 0 || cpu >= CPU_SETSIZE) {
+    return false;
+  }
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  CPU_SET(cpu, &set);
+  return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+#else
+  return false;
+#endif
+}
+
+}; // namespace Mylibpp
@@ -10,6 +10,7 @@
 #include <memory>
 #include <mutex>
 #include <queue>
+#include <string>
 #include <thread>
 #include <type_traits>
 #include <utility>
@@ -17,6 +18,34 @@
 
 namespace Mylibpp {
 
+// Where the workers of a ThreadPool run. Placement needs Linux; elsewhere
+// pin and numa are ignored and every worker shares one queue.
+struct PoolOptions {
+  // 0: one worker per CPU in cpus
+  int pool_size = 0;
+  // CPUs to place workers on, empty for every CPU the process may run on
+  std::vector<int> cpus;
+  // pin every worker to one CPU of cpus
+  bool pin = false;
+  // group workers by NUMA node, each node with its own task queue
+  bool numa = false;
+  // called on every worker, after pinning and before its first task, with
+  // the worker index and its node; buffers a worker allocates and touches
+  // here get their pages on the worker's node. The constructor returns once
+  // every worker has run it.
+  std::function<void(const int &worker, const int &node)> on_worker_start;
+};
+
+// "0-3,8,10-11" -> {0, 1, 2, 3, 8, 10, 11}, the format of sysfs cpulist
+std::vector<int> ParseCpuList(const std::string &list);
+// CPUs the calling thread may run on
+std::vector<int> AllowedCpus();
+// cpus grouped by NUMA node, nodes without any of them left out; one group
+// if the topology cannot be read
+std::vector<std::vector<int>> NumaNodes(const std::vector<int> &cpus);
+// false if the calling thread could not be pinned to cpu
+bool PinCurrentThread(const int &cpu);
+
 class ThreadPool {
 private:
   template <typename T> class _MyThreadsafeQueue {
@@ -34,28 +63,187 @@ private:
   int pool_size_;
   std::vector<std::thread> pool_container_;
 
-  std::condition_variable task_condition_;
-  std::mutex task_queue_lock_;
-  std::queue<std::function<void()>> task_queue_;
+  PoolOptions options_;
+  // placement of worker i, cpu -1 if not pinned
+  std::vector<int> worker_node_;
+  std::vector<int> worker_cpu_;
 
-protected:
-  void RunThreadLoop() {
-    std::function<void()> task;
-    while (true) {
-      {
-        std::unique_lock<std::mutex> lock(task_queue_lock_);
+  // Tasks of one node behind a lock of its own, so that nodes do not
+  // contend. Submitters wake a worker of the target node; only when all of
+  // them are busy is a sleeping worker of another node asked to steal.
+  struct NodeQueue {
+    std::mutex lock;
+    std::condition_variable condition;
+    std::queue<std::function<void()>> tasks;
+    // workers of the node waiting on condition
+    std::atomic<int> sleeping{0};
+    // wakeups on behalf of other nodes, each good for one steal attempt
+    int steal_requests = 0;
+  };
+  // one per node that has workers, at least one
+  std::vector<std::unique_ptr<NodeQueue>> queues_;
+  std::atomic<size_t> task_count_{0};
+  std::atomic<size_t> next_node_{0};
+
+  // workers that have run on_worker_start
+  std::mutex started_lock_;
+  std::condition_variable started_condition_;
+  int started_count_ = 0;
+
+  inline static thread_local const ThreadPool *current_pool_ = nullptr;
+  inline static thread_local int current_worker_ = -1;
+
+  std::vector<int> PlacementCpus() const {
+    auto cpus = options_.cpus.empty() ? AllowedCpus() : options_.cpus;
+    if (cpus.empty()) {
+      cpus.push_back(0);
+    }
+    return cpus;
+  }
+
+  void Place() {
+    auto cpus = PlacementCpus();
+    auto nodes = options_.numa ? NumaNodes(cpus)
+                               : std::vector<std::vector<int>>{cpus};
+    // nodes beyond the pool size would get no worker and no one to drain
+    // their queue
+    nodes.resize(std::min<size_t>(nodes.size(), std::max(pool_size_, 1)));
+    // workers round robin over nodes, then over the CPUs of a node
+    worker_node_.resize(pool_size_);
+    worker_cpu_.resize(pool_size_);
+    for (int i = 0; i < pool_size_; i++) {
+      const auto &node = nodes[i % nodes.size()];
+      worker_node_[i] = i % nodes.size();
+      worker_cpu_[i] =
+          options_.pin ? node[(i / nodes.size()) % node.size()] : -1;
+    }
+    for (size_t n = 0; n < nodes.size(); n++) {
+      queues_.push_back(std::make_unique<NodeQueue>());
+    }
+  }
+
+  // the submitting worker's node, round robin for other threads
+  size_t SubmitNode() {
+    if (current_pool_ == this) {
+      return worker_node_[current_worker_];
+    }
+    return next_node_++ % queues_.size();
+  }
 
-        task_condition_.wait(
-            lock, [this]() { return !task_queue_.empty() | force_stop_; });
+  template <typename TResult>
+  std::future<TResult> Enqueue(const int &node, std::function<TResult()> f) {
+    auto task_ptr = std::make_shared<std::packaged_task<TResult()>>(f);
+    auto target = node < 0 ? SubmitNode() : node % queues_.size();
+    auto &queue = *queues_[target];
+    bool idle;
+    {
+      std::lock_guard<std::mutex> lock(queue.lock);
+      queue.tasks.push([task_ptr]() { (*task_ptr)(); });
+      task_count_++;
+      idle = queue.sleeping > 0;
+    }
+    if (idle) {
+      queue.condition.notify_one();
+    } else {
+      // every worker of the node is busy, let an idle one elsewhere steal
+      for (size_t k = 1; k < queues_.size(); k++) {
+        auto &other = *queues_[(target + k) % queues_.size()];
+        if (other.sleeping > 0) {
+          {
+            std::lock_guard<std::mutex> lock(other.lock);
+            other.steal_requests++;
+          }
+          other.condition.notify_one();
+          break;
+        }
+      }
+    }
+    return task_ptr->get_future();
+  }
 
-        if (force_stop_)
-          return;
+  // queue.lock held
+  bool Pop(NodeQueue &queue, std::function<void()> &task) {
+    if (queue.tasks.empty()) {
+      return false;
+    }
+    task = std::move(queue.tasks.front());
+    queue.tasks.pop();
+    task_count_--;
+    return true;
+  }
 
-        task = task_queue_.front();
+  // a task of another node none of whose workers is waiting for it
+  bool Steal(const int &node, std::function<void()> &task) {
+    for (size_t k = 1; k < queues_.size(); k++) {
+      auto &other = *queues_[(node + k) % queues_.size()];
+      if (other.sleeping > 0) {
+        continue;
+      }
+      std::lock_guard<std::mutex> lock(other.lock);
+      if (Pop(other, task)) {
+        return true;
+      }
+    }
+    return false;
+  }
 
-        task_queue_.pop();
+  // own node first; then, with the own queue dry, tasks of busy nodes; then
+  // wait on the own node until a task or a steal request comes in. false
+  // once the pool stops.
+  bool NextTask(const int &node, std::function<void()> &task) {
+    auto &own = *queues_[node];
+    while (true) {
+      {
+        std::unique_lock<std::mutex> lock(own.lock);
+        if (force_stop_) {
+          return false;
+        }
+        if (Pop(own, task)) {
+          return true;
+        }
+      }
+      if (task_count_ > 0 && Steal(node, task)) {
+        return true;
       }
+      std::unique_lock<std::mutex> lock(own.lock);
+      own.sleeping++;
+      own.condition.wait(lock, [this, &own]() {
+        return !own.tasks.empty() || own.steal_requests > 0 || force_stop_;
+      });
+      own.sleeping--;
+      if (force_stop_) {
+        return false;
+      }
+      if (Pop(own, task)) {
+        return true;
+      }
+      own.steal_requests--;
+      lock.unlock();
+      if (Steal(node, task)) {
+        return true;
+      }
+    }
+  }
 
+protected:
+  void RunThreadLoop(int worker) {
+    current_pool_ = this;
+    current_worker_ = worker;
+    const auto node = worker_node_[worker];
+    if (worker_cpu_[worker] >= 0) {
+      PinCurrentThread(worker_cpu_[worker]);
+    }
+    if (options_.on_worker_start) {
+      options_.on_worker_start(worker, node);
+    }
+    {
+      std::unique_lock<std::mutex> lock(started_lock_);
+      started_count_++;
+    }
+    started_condition_.notify_all();
+
+    std::function<void()> task;
+    while (NextTask(node, task)) {
       if (task) {
         task();
       }
@@ -63,28 +251,39 @@ protected:
   }
 
 public:
-  ThreadPool(int pool_size)
-      : pool_size_(pool_size), pool_container_(pool_size) {
-    Init();
-  }
+  ThreadPool(int pool_size) : pool_size_(pool_size) { Init(); }
+
+  ThreadPool() : pool_size_(std::thread::hardware_concurrency()) { Init(); }
 
-  ThreadPool()
-      : pool_size_(std::thread::hardware_concurrency()),
-        pool_container_(pool_size_) {
+  explicit ThreadPool(const PoolOptions &options)
+      : pool_size_(options.pool_size), options_(options) {
+    if (pool_size_ <= 0) {
+      pool_size_ = PlacementCpus().size();
+    }
     Init();
   }
 
   void Init() {
+    Place();
+    pool_container_.reserve(pool_size_);
     for (auto i = 0; i < pool_size_; ++i) {
-      pool_container_.push_back(std::thread(&ThreadPool::RunThreadLoop, this));
+      pool_container_.push_back(
+          std::thread(&ThreadPool::RunThreadLoop, this, i));
     }
+    std::unique_lock<std::mutex> lock(started_lock_);
+    started_condition_.wait(lock,
+                            [this]() { return started_count_ == pool_size_; });
   }
 
   ~ThreadPool() { Shutdown(); }
 
   void Shutdown() {
     force_stop_ = true;
-    task_condition_.notify_all();
+    for (auto &queue : queues_) {
+      // under the lock, so that no worker is between its check and its wait
+      { std::lock_guard<std::mutex> lock(queue->lock); }
+      queue->condition.notify_all();
+    }
     for (auto &thread : pool_container_) {
       if (thread.joinable()) {
         thread.join();
@@ -93,48 +292,43 @@ public:
     pool_container_.clear();
   }
 
-  size_t GetTaskCount() {
-    std::unique_lock<std::mutex> lock(task_queue_lock_);
-    return task_queue_.size();
-  }
+  size_t GetTaskCount() { return task_count_; }
+
+  int pool_size() const { return pool_size_; }
+  // task queues; 1 unless the pool was built with numa over several nodes,
+  // and never more than there are workers
+  int node_count() const { return queues_.size(); }
+  int worker_node(const int &worker) const { return worker_node_[worker]; }
+  // -1 if workers are not pinned
+  int worker_cpu(const int &worker) const { return worker_cpu_[worker]; }
+
+  // index of the calling thread in the pool running it, -1 outside a pool
+  static int CurrentWorker() { return current_worker_; }
 
   template <typename TFunc, typename... TArgs>
   auto SubmitTask(TFunc &&func, TArgs &&...args)
       -> std::future<decltype(func(args...))> {
-    std::shared_ptr<std::packaged_task<decltype(func(args...))()>> task_ptr =
-        nullptr;
-    {
-      std::unique_lock<std::mutex> lock(task_queue_lock_);
-      std::function<decltype(func(args...))()> f =
-          std::bind(std::forward<TFunc>(func), std::forward<TArgs>(args)...);
-      task_ptr =
-          std::make_shared<std::packaged_task<decltype(func(args...))()>>(f);
-
-      task_queue_.push([task_ptr]() { (*task_ptr)(); });
-    }
-
-    task_condition_.notify_one();
-
-    return task_ptr->get_future();
+    std::function<decltype(func(args...))()> f =
+        std::bind(std::forward<TFunc>(func), std::forward<TArgs>(args)...);
+    return Enqueue(-1, std::move(f));
   }
 
   template <typename TFunc, typename... TArgs>
   auto SubmitTask(const TFunc &func, const TArgs &...args)
       -> std::future<decltype(func(args...))> {
-    std::shared_ptr<std::packaged_task<decltype(func(args...))()>> task_ptr =
-        nullptr;
-    {
-      std::unique_lock<std::mutex> lock(task_queue_lock_);
-      std::function<decltype(func(args...))()> f = std::bind(func, args...);
-      task_ptr =
-          std::make_shared<std::packaged_task<decltype(func(args...))()>>(f);
-
-      task_queue_.push([task_ptr]() { (*task_ptr)(); });
-    }
-
-    task_condition_.notify_one();
+    std::function<decltype(func(args...))()> f = std::bind(func, args...);
+    return Enqueue(-1, std::move(f));
+  }
 
-    return task_ptr->get_future();
+  // queue on a given node, for tasks that read buffers placed there; a
+  // worker of another node only takes it while every worker of the node is
+  // busy
+  template <typename TFunc, typename... TArgs>
+  auto SubmitTaskOnNode(const int &node, TFunc &&func, TArgs &&...args)
+      -> std::future<decltype(func(args...))> {
+    std::function<decltype(func(args...))()> f =
+        std::bind(std::forward<TFunc>(func), std::forward<TArgs>(args)...);
+    return Enqueue(node, std::move(f));
   }
 
   void SyncThreads() {}
@@ -0,0 +1,160 @@
+#include "parametric_hmm.hh"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+using namespace org::mcss;
+
+ParametricHmm::ParametricHmm(const int &state_count, const int &alphabet_count,
+                             const int &param_count, Builder builder)
+    : model_(state_count, alphabet_count),
+      param_count_(param_count),
+      builder_(std::move(builder)),
+      jacobian_(param_count) {
+  value_.Resize(state_count, alphabet_count);
+  for (auto &derivative : jacobian_) {
+    derivative.Resize(state_count, alphabet_count);
+  }
+}
+
+double ParametricHmm::LogLikelihood(const Eigen::VectorXd &theta,
+                                    const LabelTrace &observation,
+                                    HmmWorkspace &ws,
+                                    Eigen::VectorXd *gradient) {
+  if (gradient) {
+    for (auto &derivative : jacobian_) {
+      derivative.initial_p.setZero();
+      derivative.transition_p.setZero();
+      derivative.emission_p.setZero();
+    }
+  }
+  if (!builder_(theta, value_, gradient ? &jacobian_ : nullptr)) {
+    return -std::numeric_limits<double>::infinity();
+  }
+  model_.initial_p(value_.initial_p);
+  model_.dtmc().transition_p(value_.transition_p);
+  model_.emission_p(value_.emission_p);
+  evaluations_++;
+  if (!gradient) {
+    return model_.LogLikelihood(observation, ws);
+  }
+
+  auto log_likelihood = model_.LogLikelihoodGradient(observation, ws);
+  // chain rule, one inner product per parameter
+  gradient->resize(param_count_);
+  for (int k = 0; k < param_count_; k++) {
+    const auto &derivative = jacobian_[k];
+    (*gradient)(k) =
+        ws.grad_initial().dot(derivative.initial_p) +
+        ws.grad_transition().cwiseProduct(derivative.transition_p).sum() +
+        ws.grad_emission().cwiseProduct(derivative.emission_p).sum();
+  }
+  return log_likelihood;
+}
+
+bool ParametricHmm::LineSearch(const LabelTrace &observation, HmmWorkspace &ws,
+                               const Eigen::VectorXd &theta,
+                               const double &log_likelihood,
+                               const LbfgsOptions &options,
+                               double &next_log_likelihood) {
+  // weak Wolfe conditions by bisection (Lewis & Overton): enough gain, and
+  // the slope flattened enough for the curvature pair to be positive. Steps
+  // outside the domain count as too long.
+  const double kSufficientGain = 1e-4;
+  const double kCurvature = 0.9;
+  const auto slope = gradient_.dot(direction_);
+  auto low = 0.0;
+  auto high = std::numeric_limits<double>::infinity();
+  auto step = 1.0;
+  for (int k = 0; k < options.max_evaluations; k++) {
+    next_theta_ = theta + step * direction_;
+    next_log_likelihood =
+        LogLikelihood(next_theta_, observation, ws, &next_gradient_);
+    if (!(next_log_likelihood >=
+          log_likelihood + kSufficientGain * step * slope)) {
+      high = step;
+    } else if (next_gradient_.dot(direction_) > kCurvature * slope) {
+      low = step;
+    } else {
+      return true;
+    }
+    step = std::isinf(high) ? 2 * low : (low + high) / 2;
+  }
+  return false;
+}
+
+bool ParametricHmm::Fit(const LabelTrace &observation, HmmWorkspace &ws,
+                        Eigen::VectorXd &theta, const LbfgsOptions &options) {
+  auto m = std::max(options.history, 1);
+  s_.resize(param_count_, m);
+  y_.resize(param_count_, m);
+  rho_.resize(m);
+  alpha_.resize(m);
+  evaluations_ = 0;
+  last_iter_ = 0;
+  converged_ = false;
+
+  log_likelihood_ = LogLikelihood(theta, observation, ws, &gradient_);
+  if (!std::isfinite(log_likelihood_)) {
+    return false;
+  }
+  // L-BFGS on -log P(O): y is the change of its gradient, and the two-loop
+  // recursion applied to the log-likelihood gradient gives the ascent
+  // direction H g directly
+  int stored = 0;
+  int newest = m - 1;
+  for (int iter = 1; iter <= options.max_iters; iter++) {
+    last_iter_ = iter;
+    if (gradient_.cwiseAbs().maxCoeff() <= options.gradient_eps) {
+      converged_ = true;
+      break;
+    }
+    direction_ = gradient_;
+    for (int k = 0; k < stored; k++) {
+      auto i = (newest - k + m) % m;
+      alpha_(i) = rho_(i) * s_.col(i).dot(direction_);
+      direction_ -= alpha_(i) * y_.col(i);
+    }
+    if (stored > 0) {
+      direction_ *= s_.col(newest).dot(y_.col(newest)) /
+                    y_.col(newest).squaredNorm();
+    } else {
+      // no curvature yet, a first step of unit length
+      direction_ /= direction_.norm();
+    }
+    for (int k = stored - 1; k >= 0; k--) {
+      auto i = (newest - k + m) % m;
+      auto beta = rho_(i) * y_.col(i).dot(direction_);
+      direction_ += (alpha_(i) - beta) * s_.col(i);
+    }
+
+    double next_log_likelihood;
+    if (!LineSearch(observation, ws, theta, log_likelihood_, options,
+                    next_log_likelihood)) {
+      // leave the model at theta rather than the last trial step
+      LogLikelihood(theta, observation, ws);
+      // no step gained enough, which near the maximum is rounding: converged
+      // if the quadratic model predicts less than the log-likelihood
+      // tolerance for the whole step
+      converged_ = gradient_.dot(direction_) / 2 <=
+                   options.log_likelihood_eps * std::abs(log_likelihood_);
+      break;
+    }
+    newest = (newest + 1) % m;
+    s_.col(newest) = next_theta_ - theta;
+    y_.col(newest) = gradient_ - next_gradient_;
+    rho_(newest) = 1 / y_.col(newest).dot(s_.col(newest));
+    stored = std::min(stored + 1, m);
+
+    auto gain = next_log_likelihood - log_likelihood_;
+    theta = next_theta_;
+    gradient_ = next_gradient_;
+    log_likelihood_ = next_log_likelihood;
+    if (gain <= options.log_likelihood_eps * std::abs(log_likelihood_)) {
+      converged_ = true;
+      break;
+    }
+  }
+  return true;
+}
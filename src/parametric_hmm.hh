@@ -0,0 +1,114 @@
+#ifndef __PARAMETRIC_HMM_H__
+#define __PARAMETRIC_HMM_H__
+
+#include <Eigen/Eigen>
+
+#include <functional>
+#include <vector>
+
+#include "hmm.hh"
+
+namespace org::mcss {
+// initial, transition and emission probabilities of an Hmm, or their
+// derivatives with respect to one parameter
+struct HmmParameters {
+  Eigen::VectorXd initial_p;
+  Eigen::MatrixXd transition_p;
+  Eigen::MatrixXd emission_p;
+
+  void Resize(const int &state_count, const int &alphabet_count) {
+    initial_p.resize(state_count);
+    transition_p.resize(state_count, state_count);
+    emission_p.resize(state_count, alphabet_count);
+  }
+};
+
+// Stopping rules of ParametricHmm::Fit, whichever is met first
+struct LbfgsOptions {
+  int max_iters = 200;
+  // curvature pairs kept for the inverse Hessian estimate
+  int history = 8;
+  // stop when no component of the gradient exceeds this
+  double gradient_eps = 1e-6;
+  // stop when the log-likelihood gain of one iteration falls below this
+  // value, relative to the log-likelihood
+  double log_likelihood_eps = 1e-10;
+  // evaluations a line search may take before giving up
+  int max_evaluations = 40;
+};
+
+// Hmm whose parameters are a function of a few free parameters theta, e.g.
+// the rates of a birth-death chain. The log-likelihood gradient with respect
+// to theta is the adjoint gradient of Hmm::LogLikelihoodGradient chained
+// through the Jacobian the builder supplies, so each evaluation costs one
+// forward-backward pass whatever the number of parameters. Fit maximises
+// the log-likelihood over theta by L-BFGS.
+class ParametricHmm {
+ public:
+  // Write the parameters at theta into value, and when jacobian is not null
+  // their partial derivative with respect to theta(k) into (*jacobian)[k].
+  // Everything is sized, and the jacobian zeroed, by the caller. Returns
+  // false if theta is outside the domain, e.g. a row would go negative.
+  using Builder = std::function<bool(const Eigen::VectorXd &theta,
+                                     HmmParameters &value,
+                                     std::vector<HmmParameters> *jacobian)>;
+
+ private:
+  Hmm model_;
+  int param_count_;
+  Builder builder_;
+
+  HmmParameters value_;
+  std::vector<HmmParameters> jacobian_;
+
+  // Fit
+  Eigen::VectorXd gradient_;
+  Eigen::VectorXd next_theta_;
+  Eigen::VectorXd next_gradient_;
+  Eigen::VectorXd direction_;
+  // curvature pairs, a ring of history columns
+  Eigen::MatrixXd s_;
+  Eigen::MatrixXd y_;
+  Eigen::VectorXd rho_;
+  Eigen::VectorXd alpha_;
+
+  double log_likelihood_ = 0;
+  int last_iter_ = 0;
+  int evaluations_ = 0;
+  bool converged_ = false;
+
+  // Wolfe line search along direction_ from theta; on success next_theta_
+  // and next_gradient_ hold the accepted point
+  bool LineSearch(const LabelTrace &observation, HmmWorkspace &ws,
+                  const Eigen::VectorXd &theta, const double &log_likelihood,
+                  const LbfgsOptions &options, double &next_log_likelihood);
+
+ public:
+  ParametricHmm(const int &state_count, const int &alphabet_count,
+                const int &param_count, Builder builder);
+
+  // log P(O) at theta, and its gradient if gradient is not null; -inf, and
+  // the gradient untouched, outside the domain of the builder. Leaves the
+  // parameters at theta in model().
+  double LogLikelihood(const Eigen::VectorXd &theta,
+                       const LabelTrace &observation, HmmWorkspace &ws,
+                       Eigen::VectorXd *gradient = nullptr);
+  // maximise the log-likelihood from theta, which holds the maximiser on
+  // return; false if theta starts outside the domain
+  bool Fit(const LabelTrace &observation, HmmWorkspace &ws,
+           Eigen::VectorXd &theta, const LbfgsOptions &options = LbfgsOptions());
+
+  const Hmm &model() const { return model_; }
+  const int &param_count() const { return param_count_; }
+  // last Fit
+  const double &log_likelihood() const { return log_likelihood_; }
+  const int &last_iter() const { return last_iter_; }
+  // forward-backward passes, each giving the log-likelihood and gradient
+  const int &evaluations() const { return evaluations_; }
+  // whether a gradient or log-likelihood criterion stopped the fit, or a
+  // line search failed with less than the log-likelihood tolerance to gain
+  const bool &converged() const { return converged_; }
+};
+}  // namespace org::mcss
+
+#endif  // __PARAMETRIC_HMM_H__
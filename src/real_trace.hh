@@ -0,0 +1,74 @@
+#ifndef __REAL_TRACE_H__
+#define __REAL_TRACE_H__
+
+#include <Eigen/Eigen>
+
+#include <iterator>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "trace.hh"
+
+namespace org::mcss {
+// Trace of real-valued observation frames, each of `dimension` floats.
+// Frames are stored contiguously so a run of them maps onto a
+// dimension x T matrix without copying.
+class RealTrace : public trace {
+ private:
+  int dimension_;
+  std::vector<float> container_;
+
+ public:
+  RealTrace(const int &dimension = 1) : dimension_(dimension) {}
+  RealTrace(const std::string &str, const int &dimension = 1)
+      : dimension_(dimension) {
+    FromStr(str);
+  }
+
+  const int &dimension() const { return dimension_; }
+  size_t size() const { return container_.size() / dimension_; }
+  const float &operator()(const int &t, const int &d) const {
+    return container_[t * dimension_ + d];
+  }
+  const std::vector<float> &container() const { return container_; }
+
+  // frames [begin, begin + count) as columns
+  Eigen::Map<const Eigen::MatrixXf> block(const int &begin,
+                                          const int &count) const {
+    return Eigen::Map<const Eigen::MatrixXf>(
+        container_.data() + begin * dimension_, dimension_, count);
+  }
+  Eigen::Map<const Eigen::MatrixXf> matrix() const {
+    return block(0, size());
+  }
+
+  // comma separated values, frame after frame
+  void FromStr(const std::string &str) override {
+    std::stringstream ss(str);
+    for (float x; ss >> x;) {
+      container_.push_back(x);
+      if (ss.peek() == ',') ss.ignore();
+    }
+  }
+  std::string ToStr() override {
+    std::stringstream ss;
+    if (!container_.empty()) {
+      std::copy(container_.begin(), container_.end() - 1,
+                std::ostream_iterator<float>(ss, ","));
+      ss << container_.back();
+    }
+    return ss.str();
+  }
+
+  void Flush() override { container_.clear(); }
+  // one value, frames fill up in order
+  void Append(const float &x) { container_.push_back(x); }
+  void Append(const Eigen::VectorXf &frame) {
+    container_.insert(container_.end(), frame.data(),
+                      frame.data() + frame.size());
+  }
+};
+}  // namespace org::mcss
+
+#endif  // __REAL_TRACE_H__
@@ -0,0 +1,114 @@
+#ifndef __SCALED_PASSES_H__
+#define __SCALED_PASSES_H__
+
+#include <Eigen/Eigen>
+
+#include <vector>
+
+#include "label_trace.hh"
+
+// Forward-backward and viterbi passes shared by the discrete and the
+// Gaussian Hmm. Models differ only in where the emission likelihoods come
+// from: emission(t) returns the column of b_j(o_t) over states j, and
+// log_emission(t) its log, either as an Eigen expression.
+namespace org::mcss {
+// Scaled forward pass over [begin, end): every column of alpha sums to one
+// and the scaling factors are kept, so that log P(O) = sum_t log(scale_t).
+// entry is alpha at begin - 1 and is unused for begin == 0.
+template <typename TEmission>
+void ScaledForward(const Eigen::VectorXd &initial_p,
+                   const Eigen::MatrixXd &transition_p,
+                   const TEmission &emission, const int &begin,
+                   const int &end, const Eigen::VectorXd &entry,
+                   Eigen::MatrixXd &alpha, Eigen::VectorXd &scale) {
+  auto step = [&](const int &t,
+                  const Eigen::Ref<const Eigen::VectorXd> &previous) {
+    alpha.col(t).noalias() = transition_p.transpose() * previous;
+    alpha.col(t).array() *= emission(t).array();
+    scale(t) = alpha.col(t).sum();
+    alpha.col(t) /= scale(t);
+  };
+  if (begin == 0) {
+    // basis step
+    alpha.col(0) = initial_p.cwiseProduct(emission(0));
+    scale(0) = alpha.col(0).sum();
+    alpha.col(0) /= scale(0);
+  } else {
+    step(begin, entry);
+  }
+  // inductive step
+  for (int t = begin + 1; t < end; t++) {
+    step(t, alpha.col(t - 1));
+  }
+}
+
+// Backward pass over [begin, end) scaled with the forward factors, so that
+// alpha .* beta is already the posterior. beta at end - 1 must be set.
+template <typename TEmission>
+void ScaledBackward(const Eigen::MatrixXd &transition_p,
+                    const TEmission &emission, const Eigen::VectorXd &scale,
+                    const int &begin, const int &end, Eigen::MatrixXd &beta,
+                    Eigen::VectorXd &weight) {
+  for (int t = end - 2; t >= begin; t--) {
+    weight = beta.col(t + 1).cwiseProduct(emission(t + 1));
+    beta.col(t).noalias() = transition_p * weight;
+    beta.col(t) /= scale(t + 1);
+  }
+}
+
+// sum over t in [begin, end) of alpha_t (beta_t+1 .* b(o_t+1))^T /
+// scale_t+1; times the transition matrix these are the expected transition
+// counts, as they are the gradient of log P(O) in the transition matrix
+template <typename TEmission>
+void TransitionCounts(const TEmission &emission, const Eigen::MatrixXd &alpha,
+                      const Eigen::MatrixXd &beta,
+                      const Eigen::VectorXd &scale, const int &begin,
+                      const int &end, Eigen::VectorXd &weight,
+                      Eigen::MatrixXd &sigma_xi) {
+  sigma_xi.setZero();
+  for (int t = begin; t < end; t++) {
+    weight = beta.col(t + 1).cwiseProduct(emission(t + 1));
+    weight /= scale(t + 1);
+    sigma_xi.noalias() += alpha.col(t) * weight.transpose();
+  }
+}
+
+// most likely state path of T steps, in log space; log_transition, delta
+// and psi are work buffers
+template <typename TLogEmission>
+LabelTrace ViterbiPath(const Eigen::VectorXd &initial_p,
+                       const Eigen::MatrixXd &transition_p,
+                       const TLogEmission &log_emission, const int &T,
+                       Eigen::MatrixXd &log_transition, Eigen::MatrixXd &delta,
+                       Eigen::MatrixXi &psi) {
+  auto state_count = transition_p.rows();
+  delta.resize(state_count, T);
+  psi.resize(state_count, T);
+  log_transition = transition_p.array().log();
+  // basis step
+  delta.col(0) = initial_p.array().log() + log_emission(0).array();
+  // inductive step
+  for (int t = 1; t < T; t++) {
+    delta.col(t) = log_emission(t);
+    for (int j = 0; j < state_count; j++) {
+      int arg_max;
+      auto max = (delta.col(t - 1) + log_transition.col(j)).maxCoeff(&arg_max);
+      delta(j, t) += max;
+      psi(j, t) = arg_max;
+    }
+  }
+  // backtrack
+  std::vector<int> path(T);
+  delta.col(T - 1).maxCoeff(&path[T - 1]);
+  for (int t = T - 1; t > 0; t--) {
+    path[t - 1] = psi(path[t], t);
+  }
+  LabelTrace decoded;
+  for (const auto &s : path) {
+    decoded.Append(s);
+  }
+  return decoded;
+}
+}  // namespace org::mcss
+
+#endif  // __SCALED_PASSES_H__
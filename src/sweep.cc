@@ -0,0 +1,205 @@
+#include "sweep.hh"
+
+#include <algorithm>
+#include <atomic>
+#include <future>
+#include <iomanip>
+#include <limits>
+#include <string>
+#include <vector>
+
+#include "label_trace.hh"
+#include "model_file.hh"
+
+using namespace org::mcss;
+
+SweepDesign SweepDesign::Grid(const std::vector<std::string> &names,
+                              const Eigen::VectorXd &lower,
+                              const Eigen::VectorXd &upper,
+                              const std::vector<int> &steps) {
+  SweepDesign design;
+  design.names = names;
+  int dimension = names.size();
+  int count = 1;
+  for (const auto &s : steps) {
+    count *= s;
+  }
+  design.points.resize(count, dimension);
+  for (int i = 0; i < count; i++) {
+    // mixed radix digits of i, last parameter least significant
+    auto rest = i;
+    for (int k = dimension - 1; k >= 0; k--) {
+      auto digit = rest % steps[k];
+      rest /= steps[k];
+      design.points(i, k) =
+          steps[k] == 1 ? lower(k)
+                        : lower(k) + (upper(k) - lower(k)) * digit /
+                                         (steps[k] - 1);
+    }
+  }
+  return design;
+}
+
+SweepDesign SweepDesign::Random(const std::vector<std::string> &names,
+                                const Eigen::VectorXd &lower,
+                                const Eigen::VectorXd &upper,
+                                const int &count, const int &seed) {
+  SweepDesign design;
+  design.names = names;
+  int dimension = names.size();
+  design.points.resize(count, dimension);
+  MarkovRandom rand(seed);
+  for (int i = 0; i < count; i++) {
+    for (int k = 0; k < dimension; k++) {
+      design.points(i, k) =
+          lower(k) + (upper(k) - lower(k)) * rand.RandomProbUniform();
+    }
+  }
+  return design;
+}
+
+SweepTable::SweepTable(const std::vector<std::string> &names, const int &rows)
+    : names_(names),
+      columns_(names.size(),
+               Eigen::VectorXd::Constant(
+                   rows, std::numeric_limits<double>::quiet_NaN())) {}
+
+const Eigen::VectorXd *SweepTable::column(const std::string &name) const {
+  auto found = std::find(names_.begin(), names_.end(), name);
+  if (found == names_.end()) {
+    return nullptr;
+  }
+  return &columns_[found - names_.begin()];
+}
+
+void SweepTable::WriteCsv(std::ostream &out) const {
+  for (size_t k = 0; k < names_.size(); k++) {
+    out << (k ? "," : "") << names_[k];
+  }
+  out << "\n" << std::setprecision(17);
+  for (int i = 0; i < rows(); i++) {
+    for (size_t k = 0; k < columns_.size(); k++) {
+      out << (k ? "," : "") << columns_[k](i);
+    }
+    out << "\n";
+  }
+}
+
+namespace {
+// independent seed for every design point
+int PointSeed(const uint64_t &seed, const int &point) {
+  // splitmix64 finaliser
+  uint64_t z = seed + 0x9e3779b97f4a7c15ULL * (point + 1);
+  z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+  return static_cast<int>(z ^ (z >> 31));
+}
+
+int SampleAlias(const Eigen::MatrixXd &alias_p, const Eigen::MatrixXi &alias,
+                const int &i, MarkovRandom &rand) {
+  auto K = alias_p.rows();
+  auto u = rand.RandomProbUniform() * K;
+  int k = std::min<int>(u, K - 1);
+  return u - k < alias_p(k, i) ? k : alias(k, i);
+}
+}  // namespace
+
+// Buffers one pool task keeps for all the points it runs
+struct Sweep::Worker {
+  MarkovRandom rand;
+  Eigen::VectorXd initial_p;
+  Eigen::MatrixXd transition_p;
+  Eigen::MatrixXd initial_alias_p;
+  Eigen::MatrixXi initial_alias;
+  Eigen::MatrixXd transition_alias_p;
+  Eigen::MatrixXi transition_alias;
+  LabelTrace trace;
+  HmmWorkspace ws;
+
+  explicit Worker(const int &state_count)
+      : initial_p(state_count), transition_p(state_count, state_count) {}
+};
+
+Sweep::Sweep(const int &state_count, Builder builder,
+             const std::vector<int> &labels, FitModelFactory fit_model)
+    : state_count_(state_count), builder_(std::move(builder)),
+      labels_(labels), fit_model_(std::move(fit_model)) {}
+
+void Sweep::RunPoint(const SweepDesign &design, const SweepOptions &options,
+                     const int &point, Worker &worker,
+                     SweepTable &table) const {
+  auto &rand = worker.rand;
+  rand.reset(PointSeed(options.seed, point));
+  builder_(design.points.row(point).transpose(), worker.initial_p,
+           worker.transition_p);
+  BuildAliasTables(worker.initial_p.transpose(), worker.initial_alias_p,
+                   worker.initial_alias);
+  BuildAliasTables(worker.transition_p, worker.transition_alias_p,
+                   worker.transition_alias);
+
+  // simulate and map to labels
+  auto &trace = worker.trace;
+  trace.Flush();
+  auto state =
+      SampleAlias(worker.initial_alias_p, worker.initial_alias, 0, rand);
+  for (int t = 0; t < options.trace_length; t++) {
+    trace.Append(labels_[state]);
+    state = SampleAlias(worker.transition_alias_p, worker.transition_alias,
+                        state, rand);
+  }
+
+  auto model = fit_model_(rand);
+  model->Fit(trace, worker.ws, options.fit);
+
+  int k = design.names.size();
+  table.column(k++)(point) = worker.ws.log_likelihood();
+  table.column(k++)(point) = worker.ws.aic();
+  table.column(k++)(point) = worker.ws.last_iter();
+  const auto &fitted = model->dtmc().transition_p();
+  for (int i = 0; i < fitted.rows(); i++) {
+    for (int j = 0; j < fitted.cols(); j++) {
+      table.column(k++)(point) = fitted(i, j);
+    }
+  }
+}
+
+SweepTable Sweep::Run(const SweepDesign &design, const SweepOptions &options,
+                      Mylibpp::ThreadPool &pool) const {
+  int point_count = design.points.rows();
+  int param_count = design.names.size();
+  MarkovRandom probe_rand(0);
+  auto fit_state_count = fit_model_(probe_rand)->state_count();
+
+  auto names = design.names;
+  names.insert(names.end(), {"log_likelihood", "aic", "iters"});
+  for (int i = 0; i < fit_state_count; i++) {
+    for (int j = 0; j < fit_state_count; j++) {
+      names.push_back("p_" + std::to_string(i) + "_" + std::to_string(j));
+    }
+  }
+  SweepTable table(names, point_count);
+  for (int k = 0; k < param_count; k++) {
+    table.column(k) = design.points.col(k);
+  }
+
+  // workers pull chunks of points until the design is exhausted; every
+  // point writes only its own row
+  std::atomic<int> next = 0;
+  auto chunk = std::max(1, options.chunk);
+  std::vector<std::future<void>> futures;
+  for (int w = 0; w < std::max(1, options.workers); w++) {
+    futures.push_back(pool.SubmitTask([&]() {
+      Worker worker(state_count_);
+      for (int begin; (begin = next.fetch_add(chunk)) < point_count;) {
+        auto end = std::min(begin + chunk, point_count);
+        for (int point = begin; point < end; point++) {
+          RunPoint(design, options, point, worker, table);
+        }
+      }
+    }));
+  }
+  for (auto &future : futures) {
+    future.get();
+  }
+  return table;
+}
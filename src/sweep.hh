@@ -0,0 +1,103 @@
+#ifndef __SWEEP_H__
+#define __SWEEP_H__
+
+#include <Eigen/Eigen>
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "hmm.hh"
+#include "markov_random.hh"
+#include "my_thread_pool.h"
+
+namespace org::mcss {
+// Points of a parameter space, one row per point
+struct SweepDesign {
+  std::vector<std::string> names;
+  Eigen::MatrixXd points;
+
+  // full factorial grid, steps[k] evenly spaced values of parameter k from
+  // lower to upper inclusive; the last parameter varies fastest
+  static SweepDesign Grid(const std::vector<std::string> &names,
+                          const Eigen::VectorXd &lower,
+                          const Eigen::VectorXd &upper,
+                          const std::vector<int> &steps);
+  // count points drawn uniformly from the box [lower, upper]
+  static SweepDesign Random(const std::vector<std::string> &names,
+                            const Eigen::VectorXd &lower,
+                            const Eigen::VectorXd &upper, const int &count,
+                            const int &seed);
+};
+
+// Struct-of-columns result table, one row per design point
+class SweepTable {
+ private:
+  std::vector<std::string> names_;
+  std::vector<Eigen::VectorXd> columns_;
+
+ public:
+  SweepTable() {}
+  SweepTable(const std::vector<std::string> &names, const int &rows);
+
+  const std::vector<std::string> &names() const { return names_; }
+  int rows() const { return columns_.empty() ? 0 : columns_[0].size(); }
+  Eigen::VectorXd &column(const int &k) { return columns_[k]; }
+  const Eigen::VectorXd &column(const int &k) const { return columns_[k]; }
+  // null if there is no such column
+  const Eigen::VectorXd *column(const std::string &name) const;
+
+  // header line of column names, then one line per row
+  void WriteCsv(std::ostream &out) const;
+};
+
+struct SweepOptions {
+  int trace_length = 100;
+  uint64_t seed = 0;
+  // points a worker takes from the design at a time
+  int chunk = 8;
+  // concurrent tasks on the pool, each with its own buffers
+  int workers = 1;
+  FitOptions fit;
+};
+
+// simulate -> label map -> fit over a design of a parametric Dtmc.
+//
+// Every point gets its own random stream derived from the seed and the
+// point index, so the table does not depend on workers or scheduling.
+// Table columns: the design parameters, then log_likelihood, aic and iters
+// of the fit, then the fitted transition matrix as p_<i>_<j>.
+class Sweep {
+ public:
+  // write the chain of parameter vector theta into initial_p and
+  // transition_p, which are already sized state_count
+  using Builder = std::function<void(const Eigen::VectorXd &theta,
+                                     Eigen::VectorXd &initial_p,
+                                     Eigen::MatrixXd &transition_p)>;
+  // model to fit, with its starting parameters
+  using FitModelFactory = std::function<std::unique_ptr<Hmm>(MarkovRandom &)>;
+
+ private:
+  int state_count_;
+  Builder builder_;
+  // labels_[s] is the label of simulated state s
+  std::vector<int> labels_;
+  FitModelFactory fit_model_;
+
+  struct Worker;
+  void RunPoint(const SweepDesign &design, const SweepOptions &options,
+                const int &point, Worker &worker, SweepTable &table) const;
+
+ public:
+  Sweep(const int &state_count, Builder builder,
+        const std::vector<int> &labels, FitModelFactory fit_model);
+
+  SweepTable Run(const SweepDesign &design, const SweepOptions &options,
+                 Mylibpp::ThreadPool &pool) const;
+};
+}  // namespace org::mcss
+
+#endif  // __SWEEP_H__
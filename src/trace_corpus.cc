@@ -0,0 +1,46 @@
+#include "trace_corpus.hh"
+
+#include <fstream>
+#include <numeric>
+#include <utility>
+
+using namespace org::mcss;
+
+bool TraceCorpus::Assign(const LabelTrace &trace, const int &alphabet_count) {
+  std::vector<int> identity(alphabet_count);
+  std::iota(identity.begin(), identity.end(), 0);
+  TracePipeline pipeline(identity, alphabet_count);
+  LabelTrace checked;
+  TraceStats stats;
+  if (trace.size() == 0 || !pipeline.Run(trace, checked, stats)) {
+    return false;
+  }
+  trace_ = std::move(checked);
+  alphabet_count_ = alphabet_count;
+  stats_ = stats;
+
+  // counting sort of the times by symbol
+  offsets_.assign(alphabet_count + 1, 0);
+  for (int o = 0; o < alphabet_count; o++) {
+    offsets_[o + 1] = offsets_[o] + static_cast<int>(symbol_counts()(o));
+  }
+  positions_.resize(trace_.size());
+  std::vector<int> next(offsets_.begin(), offsets_.end() - 1);
+  for (int t = 0; t < static_cast<int>(trace_.size()); t++) {
+    positions_[next[trace_[t]]++] = t;
+  }
+  return true;
+}
+
+bool TraceCorpus::Load(const std::string &path) {
+  std::ifstream in(path);
+  std::string line;
+  if (!std::getline(in, line)) {
+    return false;
+  }
+  auto alphabet_count = std::atoi(line.c_str());
+  if (alphabet_count <= 0 || !std::getline(in, line)) {
+    return false;
+  }
+  return Assign(LabelTrace(line), alphabet_count);
+}
@@ -0,0 +1,49 @@
+#ifndef __TRACE_CORPUS_H__
+#define __TRACE_CORPUS_H__
+
+#include <Eigen/Eigen>
+
+#include <string>
+#include <vector>
+
+#include "label_trace.hh"
+#include "trace_pipeline.hh"
+
+namespace org::mcss {
+// A label trace parsed and checked once, with the statistics every fit on
+// it can share: symbol and bigram counts, and the positions of every symbol
+// so that per-symbol sums over time are gathers instead of scans. Build it
+// once and pass it to each Hmm::Fit and Hmm::InitFromCounts on the trace.
+class TraceCorpus {
+ private:
+  LabelTrace trace_;
+  int alphabet_count_ = 0;
+  TraceStats stats_;
+  // positions_[offsets_[o], offsets_[o + 1]) are the times of symbol o
+  std::vector<int> offsets_;
+  std::vector<int> positions_;
+
+ public:
+  TraceCorpus() {}
+
+  // false if the trace is empty or a label is not in [0, alphabet_count)
+  bool Assign(const LabelTrace &trace, const int &alphabet_count);
+  // trace file: the alphabet count on the first line, the comma separated
+  // trace on the second
+  bool Load(const std::string &path);
+
+  const LabelTrace &trace() const { return trace_; }
+  const int &alphabet_count() const { return alphabet_count_; }
+  size_t size() const { return trace_.size(); }
+  const Eigen::VectorXd &symbol_counts() const { return stats_.label_counts(); }
+  // bigram counts, (i, j): symbol i directly followed by symbol j
+  const Eigen::MatrixXd &transitions() const { return stats_.transitions(); }
+  // times of symbol o, ascending
+  Eigen::Map<const Eigen::VectorXi> positions(const int &o) const {
+    return Eigen::Map<const Eigen::VectorXi>(positions_.data() + offsets_[o],
+                                             offsets_[o + 1] - offsets_[o]);
+  }
+};
+}  // namespace org::mcss
+
+#endif  // __TRACE_CORPUS_H__
@@ -0,0 +1,159 @@
+#include "trace_pipeline.hh"
+
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
+#include <algorithm>
+
+using namespace org::mcss;
+
+TracePipeline::TracePipeline(const std::vector<int> &labels,
+                             const int &label_count)
+    : labels_(labels),
+      label_count_(label_count),
+      valid_(std::all_of(labels.begin(), labels.end(), [&](const int &label) {
+        return label >= 0 && label < label_count;
+      })) {}
+
+bool TracePipeline::window(const int64_t &begin, const int64_t &end) {
+  if (begin < 0 || begin > end) {
+    return false;
+  }
+  begin_ = begin;
+  end_ = end;
+  return true;
+}
+
+bool TracePipeline::stride(const int &stride) {
+  if (stride < 1) {
+    return false;
+  }
+  stride_ = stride;
+  return true;
+}
+
+bool TracePipeline::ngram(const int &n) {
+  if (n < 0 || (n > 0 && label_count_ < 1)) {
+    return false;
+  }
+  // Push computes code * label_count + label with code < size
+  const auto max = std::numeric_limits<int64_t>::max();
+  int64_t size = n > 0 ? 1 : 0;
+  for (int k = 0; k < n; k++) {
+    if (size > max / label_count_) {
+      return false;
+    }
+    size *= label_count_;
+  }
+  if (size > max / std::max(label_count_, 1)) {
+    return false;
+  }
+  ngram_ = n;
+  ngram_size_ = size;
+  return true;
+}
+
+void TracePipeline::Reset(TraceStats &stats) const {
+  stats.transitions_ = Eigen::MatrixXd::Zero(label_count_, label_count_);
+  stats.label_counts_ = Eigen::VectorXd::Zero(label_count_);
+  stats.ngram_counts_ = Eigen::VectorXd::Zero(ngram_size_);
+  stats.position_ = 0;
+  stats.previous_ = -1;
+  stats.ngram_fill_ = 0;
+  stats.ngram_code_ = 0;
+}
+
+bool TracePipeline::Map(const int *states, const int &count, int *out) const {
+  // one range check for the block keeps the lookups branch free
+  auto [low, high] = std::minmax_element(states, states + count);
+  if (*low < 0 || *high >= static_cast<int>(labels_.size())) {
+    return false;
+  }
+  int i = 0;
+#ifdef __AVX2__
+  for (; i + 8 <= count; i += 8) {
+    auto index =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i *>(states + i));
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(out + i),
+                        _mm256_i32gather_epi32(labels_.data(), index, 4));
+  }
+#endif
+  for (; i < count; i++) {
+    out[i] = labels_[states[i]];
+  }
+  return true;
+}
+
+bool TracePipeline::Push(const int *states, const size_t &count,
+                         LabelTrace &out, TraceStats &stats) const {
+  if (!valid_) {
+    return false;
+  }
+  if (stats.label_counts_.size() != label_count_ ||
+      stats.ngram_counts_.size() != ngram_size_) {
+    Reset(stats);
+  }
+  int gathered[kBlock];
+  int block[kBlock];
+  int64_t modulus = stats.ngram_counts_.size();
+  for (size_t offset = 0; offset < count;) {
+    // kept positions of this block, as indices into states
+    auto position = stats.position_ + offset;
+    auto first = std::max<int64_t>(position, begin_);
+    if (first > begin_ && stride_ > 1) {
+      first += (stride_ - (first - begin_) % stride_) % stride_;
+    }
+    auto stop = std::min<int64_t>(
+        {static_cast<int64_t>(stats.position_ + count), end_,
+         first + static_cast<int64_t>(kBlock) * stride_});
+    if (first >= stop) {
+      break;
+    }
+    int kept = (stop - first + stride_ - 1) / stride_;
+    const int *source = states + (first - stats.position_);
+    if (stride_ > 1) {
+      for (int k = 0; k < kept; k++) {
+        gathered[k] = source[k * stride_];
+      }
+      source = gathered;
+    }
+    if (!Map(source, kept, block)) {
+      stats.position_ = first;
+      return false;
+    }
+    out.Append(block, block + kept);
+
+    // counting, serial through the carried previous label and n-gram code
+    auto previous = stats.previous_;
+    auto fill = stats.ngram_fill_;
+    auto code = stats.ngram_code_;
+    for (int k = 0; k < kept; k++) {
+      auto label = block[k];
+      stats.label_counts_(label) += 1;
+      if (previous >= 0) {
+        stats.transitions_(previous, label) += 1;
+      }
+      previous = label;
+      if (modulus > 0) {
+        code = (code * label_count_ + label) % modulus;
+        if (++fill >= ngram_) {
+          stats.ngram_counts_(code) += 1;
+        }
+      }
+    }
+    stats.previous_ = previous;
+    stats.ngram_fill_ = std::min(fill, ngram_);
+    stats.ngram_code_ = code;
+    offset = first - stats.position_ + static_cast<int64_t>(kept) * stride_;
+  }
+  stats.position_ += count;
+  return true;
+}
+
+bool TracePipeline::Run(const LabelTrace &states, LabelTrace &out,
+                        TraceStats &stats) const {
+  Reset(stats);
+  const auto &container = states.container();
+  return Push(container.data(), container.size(), out, stats);
+}
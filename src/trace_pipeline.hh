@@ -0,0 +1,100 @@
+#ifndef __TRACE_PIPELINE_H__
+#define __TRACE_PIPELINE_H__
+
+#include <Eigen/Eigen>
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+#include "label_trace.hh"
+
+namespace org::mcss {
+class TracePipeline;
+
+// Sufficient statistics of a label trace, plus what a streaming pass needs
+// to carry from one chunk of states to the next.
+class TraceStats {
+ private:
+  // transitions_(i, j): label i directly followed by label j
+  Eigen::MatrixXd transitions_;
+  Eigen::VectorXd label_counts_;
+  // ngram_counts_(c), c the n-gram read as a base label_count number, its
+  // first label most significant; empty unless the pipeline counts n-grams
+  Eigen::VectorXd ngram_counts_;
+
+  // carry
+  int64_t position_ = 0;
+  int previous_ = -1;
+  int ngram_fill_ = 0;
+  int64_t ngram_code_ = 0;
+
+  friend class TracePipeline;
+
+ public:
+  const Eigen::MatrixXd &transitions() const { return transitions_; }
+  const Eigen::VectorXd &label_counts() const { return label_counts_; }
+  const Eigen::VectorXd &ngram_counts() const { return ngram_counts_; }
+  // states consumed so far, kept or not
+  const int64_t &position() const { return position_; }
+};
+
+// State trace -> label trace in one pass: keep the states in a window,
+// downsample by a stride, map through a dense state -> label table, and
+// accumulate label, transition and n-gram counts on the way. Input is
+// consumed in blocks; the table lookups of a block are done first, with
+// AVX2 gathers when the build enables them, and the counting loop then
+// runs over the block while it is still in cache.
+class TracePipeline {
+ private:
+  static constexpr int kBlock = 256;
+
+  // labels_[s] is the label of state s
+  std::vector<int> labels_;
+  int label_count_;
+  // every entry of labels_ is in [0, label_count_)
+  bool valid_;
+  int64_t begin_ = 0;
+  int64_t end_ = std::numeric_limits<int64_t>::max();
+  int stride_ = 1;
+  int ngram_ = 0;
+  // label_count^ngram_, 0 without n-grams
+  int64_t ngram_size_ = 0;
+
+  // map count states, false if one has no label
+  bool Map(const int *states, const int &count, int *out) const;
+
+ public:
+  TracePipeline(const std::vector<int> &labels, const int &label_count);
+
+  // Settings; each returns false, and keeps the previous value, if the new
+  // one is out of range.
+  // keep positions [begin, end) of the stream, 0 <= begin <= end
+  bool window(const int64_t &begin, const int64_t &end);
+  // of those, keep every stride-th, starting at begin; stride >= 1
+  bool stride(const int &stride);
+  // count n-grams of the kept labels, 0 for none; label_count^n counters,
+  // which must fit with room for one more label in an int64_t
+  bool ngram(const int &n);
+  const int &label_count() const { return label_count_; }
+  // false if the table maps a state outside [0, label_count); such a
+  // pipeline pushes nothing
+  const bool &valid() const { return valid_; }
+
+  // clear counts and carry, sized for this pipeline
+  void Reset(TraceStats &stats) const;
+  // next chunk of the stream; kept labels are appended to out. Stats not
+  // sized for this pipeline, e.g. default constructed ones, are Reset
+  // first. false if a
+  // state has no label: the blocks before the one holding it are pushed,
+  // and position() is left at the start of that block. false without
+  // pushing anything if the pipeline is not valid().
+  bool Push(const int *states, const size_t &count, LabelTrace &out,
+            TraceStats &stats) const;
+  // Reset, then the whole trace
+  bool Run(const LabelTrace &states, LabelTrace &out, TraceStats &stats) const;
+};
+}  // namespace org::mcss
+
+#endif  // __TRACE_PIPELINE_H__
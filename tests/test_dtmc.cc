@@ -0,0 +1,93 @@
+#include "dtmc.hh"
+
+#include <gtest/gtest.h>
+
+#include <cmath>
+#include <vector>
+
+using namespace org::mcss;
+
+namespace {
+
+Dtmc TwoStateChain(const double &a, const double &b) {
+  Eigen::VectorXd init_p(2);
+  init_p << 1.0, 0;
+  Eigen::MatrixXd trans_p(2, 2);
+  trans_p << 1 - a, a, b, 1 - b;
+  return Dtmc(2, init_p, trans_p);
+}
+
+// fair gambler's ruin on 0..4, 0 and 4 absorbing
+Dtmc GamblersRuin() {
+  Eigen::VectorXd init_p = Eigen::VectorXd::Zero(5);
+  init_p(2) = 1;
+  Eigen::MatrixXd trans_p = Eigen::MatrixXd::Zero(5, 5);
+  trans_p(0, 0) = 1;
+  trans_p(4, 4) = 1;
+  for (int i = 1; i < 4; i++) {
+    trans_p(i, i - 1) = 0.5;
+    trans_p(i, i + 1) = 0.5;
+  }
+  return Dtmc(5, init_p, trans_p);
+}
+
+TEST(TestDtmc, TestStationaryMethodsAgreeWithClosedForm) {
+  auto dtmc = TwoStateChain(0.3, 0.1);
+  Eigen::VectorXd expected(2);
+  expected << 0.25, 0.75;
+  for (auto method : {StationaryMethod::kPower, StationaryMethod::kGaussSeidel,
+                      StationaryMethod::kGmres}) {
+    SolverOptions options;
+    options.method = method;
+    SolverStats stats;
+    auto pi = dtmc.Stationary(options, &stats);
+    EXPECT_TRUE(stats.converged);
+    EXPECT_TRUE(pi.isApprox(expected, 1e-9));
+  }
+}
+
+TEST(TestDtmc, TestGaussSeidelHandlesPeriodicChain) {
+  auto dtmc = TwoStateChain(1.0, 1.0);
+  SolverStats stats;
+  auto pi = dtmc.Stationary(SolverOptions(), &stats);
+  EXPECT_TRUE(stats.converged);
+  EXPECT_NEAR(pi(0), 0.5, 1e-12);
+}
+
+TEST(TestDtmc, TestTransientMatchesRepeatedSteps) {
+  auto dtmc = TwoStateChain(0.3, 0.1);
+  Eigen::VectorXd p = dtmc.initial_p();
+  for (int n = 0; n < 37; n++) {
+    p = dtmc.transition_p().transpose() * p;
+  }
+  EXPECT_TRUE(dtmc.Transient(37).isApprox(p, 1e-12));
+  EXPECT_TRUE(dtmc.Transient(1).isApprox(dtmc.transition_p().row(0).transpose()));
+  Eigen::VectorXd limit(2);
+  limit << 0.25, 0.75;
+  EXPECT_TRUE(dtmc.Transient(1LL << 40, 1e-15).isApprox(limit, 1e-9));
+}
+
+TEST(TestDtmc, TestGamblersRuinAbsorption) {
+  auto dtmc = GamblersRuin();
+  EXPECT_EQ(dtmc.AbsorbingStates(), std::vector<int>({0, 4}));
+  auto b = dtmc.AbsorptionProbabilities();
+  for (int i = 0; i < 5; i++) {
+    EXPECT_NEAR(b(i, 1), i / 4.0, 1e-12);
+    EXPECT_NEAR(b(i, 0) + b(i, 1), 1.0, 1e-12);
+  }
+  auto k = dtmc.HittingTimes({0, 4});
+  for (int i = 0; i < 5; i++) {
+    EXPECT_NEAR(k(i), i * (4 - i), 1e-10);
+  }
+}
+
+TEST(TestDtmc, TestHittingTimeIsInfiniteWhenNotSure) {
+  auto dtmc = GamblersRuin();
+  auto h = dtmc.HittingProbabilities({4});
+  EXPECT_NEAR(h(1), 0.25, 1e-12);
+  auto k = dtmc.HittingTimes({4});
+  EXPECT_TRUE(std::isinf(k(1)));
+  EXPECT_EQ(k(4), 0);
+}
+
+} // namespace
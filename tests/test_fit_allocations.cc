@@ -0,0 +1,114 @@
+// Heap allocations of Fit, counted by interposing malloc for the whole test
+// binary. glibc only.
+#include "hmm.hh"
+#include "labelled_dtmc.hh"
+
+#include <gtest/gtest.h>
+
+#include <cstddef>
+#include <cstdlib>
+#include <vector>
+
+extern "C" {
+void *__libc_malloc(size_t size);
+void *__libc_calloc(size_t count, size_t size);
+void *__libc_realloc(void *p, size_t size);
+}
+
+namespace {
+thread_local bool counting = false;
+thread_local long allocations = 0;
+}  // namespace
+
+extern "C" {
+void *malloc(size_t size) {
+  allocations += counting;
+  return __libc_malloc(size);
+}
+void *calloc(size_t count, size_t size) {
+  allocations += counting;
+  return __libc_calloc(count, size);
+}
+void *realloc(void *p, size_t size) {
+  allocations += counting;
+  return __libc_realloc(p, size);
+}
+}
+
+using namespace org::mcss;
+
+namespace {
+
+class TestFitAllocations : public testing::Test {
+protected:
+  static constexpr int kIters = 20;
+  LabelTrace trace_;
+  std::vector<long> per_iteration_;
+
+  void SetUp() override {
+    Eigen::VectorXd init_p(3);
+    init_p << 0.5, 0.3, 0.2;
+    Eigen::MatrixXd trans_p(3, 3);
+    trans_p << 0.7, 0.2, 0.1, 0.3, 0.5, 0.2, 0.2, 0.3, 0.5;
+    Eigen::MatrixXd emit_p(3, 2);
+    emit_p << 0.9, 0.1, 0.2, 0.8, 0.5, 0.5;
+    Hmm source(3, 2, init_p, trans_p, emit_p);
+    HmmWorkspace ws(7);
+    for (int t = 0; t < 500; t++) {
+      trace_.Append(source.Next(ws));
+    }
+    per_iteration_.reserve(kIters);
+  }
+
+  // allocations of every iteration of model.Fit after the first
+  void Fit(Hmm &model, const FitAcceleration &acceleration,
+           const FitPrecision &precision = FitPrecision::kDouble) {
+    HmmWorkspace ws;
+    FitOptions options;
+    options.max_iters = kIters;
+    options.eps = 0;
+    options.acceleration = acceleration;
+    options.precision = precision;
+    options.observer = [this](const FitIteration &) {
+      per_iteration_.push_back(allocations);
+      allocations = 0;
+      return true;
+    };
+    allocations = 0;
+    counting = true;
+    model.Fit(trace_, ws, options);
+    counting = false;
+    ASSERT_EQ(per_iteration_.size(), kIters);
+    per_iteration_.erase(per_iteration_.begin());
+  }
+};
+
+TEST_F(TestFitAllocations, TestEmSteadyStateDoesNotAllocate) {
+  Hmm model(3, 2);
+  model.InitRandom();
+  Fit(model, FitAcceleration::kNone);
+  EXPECT_EQ(per_iteration_, std::vector<long>(kIters - 1, 0));
+}
+
+TEST_F(TestFitAllocations, TestSquaremSteadyStateDoesNotAllocate) {
+  Hmm model(3, 2);
+  model.InitRandom();
+  Fit(model, FitAcceleration::kSquarem);
+  EXPECT_EQ(per_iteration_, std::vector<long>(kIters - 1, 0));
+}
+
+TEST_F(TestFitAllocations, TestMixedPrecisionSteadyStateDoesNotAllocate) {
+  Hmm model(3, 2);
+  model.InitRandom();
+  Fit(model, FitAcceleration::kNone, FitPrecision::kMixed);
+  EXPECT_EQ(per_iteration_, std::vector<long>(kIters - 1, 0));
+}
+
+TEST_F(TestFitAllocations, TestLabelledDtmcSteadyStateDoesNotAllocate) {
+  LabelledDtmc model(3, 2, {0, 1, 1});
+  model.dtmc().InitRandom();
+  Fit(model, FitAcceleration::kNone);
+  EXPECT_EQ(per_iteration_, std::vector<long>(kIters - 1, 0));
+}
+
+}  // namespace
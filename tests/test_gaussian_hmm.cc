@@ -0,0 +1,137 @@
+#include "gaussian_hmm.hh"
+
+#include <gtest/gtest.h>
+
+#include <cmath>
+#include <memory>
+
+using namespace org::mcss;
+
+namespace {
+
+class TestGaussianHmm : public testing::Test {
+protected:
+  std::unique_ptr<GaussianHmm> model_;
+  RealTrace trace_{2};
+  void SetUp() override {
+    Eigen::VectorXd init_p(2);
+    init_p << 0.6, 0.4;
+    Eigen::MatrixXd trans_p(2, 2);
+    trans_p << 0.9, 0.1, 0.2, 0.8;
+    Eigen::MatrixXd weight(2, 2);
+    weight << 0.5, 0.5, 0.3, 0.7;
+    Eigen::MatrixXd mean(2, 4);
+    mean << -4, -2, 3, 5, 0, 1, 2, 2;
+    Eigen::MatrixXd variance(2, 4);
+    variance << 1.0, 0.5, 1.0, 0.8, 0.3, 0.3, 1.0, 2.0;
+    model_ = std::make_unique<GaussianHmm>(init_p, trans_p, weight, mean,
+                                           variance);
+    GaussianHmmWorkspace ws(42);
+    for (int i = 0; i < 300; i++) {
+      trace_.Append(model_->Next(ws));
+    }
+  }
+};
+
+TEST_F(TestGaussianHmm, TestPosteriorIsNormalized) {
+  GaussianHmmWorkspace ws;
+  const auto &gamma = model_->Posterior(trace_, ws);
+  ASSERT_EQ(gamma.cols(), trace_.size());
+  for (int t = 0; t < gamma.cols(); t++) {
+    EXPECT_NEAR(gamma.col(t).sum(), 1.0, 1e-12);
+  }
+}
+
+TEST_F(TestGaussianHmm, TestEmissionMatchesDensity) {
+  GaussianHmmWorkspace ws;
+  model_->Posterior(trace_, ws);
+  const auto &w = model_->weight();
+  const auto &mu = model_->mean();
+  const auto &var = model_->variance();
+  for (int t = 0; t < 5; t++) {
+    for (int j = 0; j < 2; j++) {
+      auto b = 0.0;
+      for (int m = 0; m < 2; m++) {
+        auto density = w(j, m);
+        for (int d = 0; d < 2; d++) {
+          auto k = j * 2 + m;
+          auto z = trace_(t, d) - mu(d, k);
+          density *= std::exp(-z * z / (2 * var(d, k))) /
+                     std::sqrt(2 * M_PI * var(d, k));
+        }
+        b += density;
+      }
+      EXPECT_NEAR(ws.log_emission()(j, t), std::log(b), 1e-9);
+    }
+  }
+}
+
+TEST_F(TestGaussianHmm, TestSingleStateLogLikelihood) {
+  Eigen::VectorXd init_p = Eigen::VectorXd::Ones(1);
+  Eigen::MatrixXd trans_p = Eigen::MatrixXd::Ones(1, 1);
+  Eigen::MatrixXd mean(1, 1);
+  mean << 0.5;
+  Eigen::MatrixXd variance(1, 1);
+  variance << 2.0;
+  GaussianHmm model(init_p, trans_p, Eigen::MatrixXd::Ones(1, 1), mean,
+                    variance);
+  RealTrace trace("0.1,-1.5,2.25,0.5,3.0");
+  auto expected = 0.0;
+  for (const auto &x : trace.container()) {
+    expected += -0.5 * std::log(2 * M_PI * 2.0) - (x - 0.5) * (x - 0.5) / 4.0;
+  }
+  GaussianHmmWorkspace ws;
+  EXPECT_NEAR(model.LogLikelihood(trace, ws), expected, 1e-9);
+}
+
+TEST_F(TestGaussianHmm, TestFitImprovesLogLikelihood) {
+  GaussianHmm model(2, 2, 2);
+  model.InitRandom(trace_);
+  GaussianHmmWorkspace ws;
+  auto before = model.LogLikelihood(trace_, ws);
+  model.Fit(trace_, ws, 30, 1e-6);
+  EXPECT_GT(ws.log_likelihood(), before);
+  EXPECT_TRUE(model.weight().rowwise().sum().isOnes(1e-12));
+  EXPECT_GE(model.variance().minCoeff(), 1e-6);
+}
+
+TEST_F(TestGaussianHmm, TestFitOptions) {
+  GaussianHmm model(2, 2, 2);
+  model.InitRandom(trace_);
+  GaussianHmmWorkspace ws;
+  FitOptions options;
+  options.acceleration = FitAcceleration::kSquarem;
+  EXPECT_FALSE(model.Fit(trace_, ws, options));
+  options.acceleration = FitAcceleration::kNone;
+  options.precision = FitPrecision::kMixed;
+  EXPECT_FALSE(model.Fit(trace_, ws, options));
+  options.precision = FitPrecision::kDouble;
+#ifndef MCSS_NO_FIT_OBSERVER
+  options.eps = 0;
+  int calls = 0;
+  options.observer = [&calls](const FitIteration &iteration) {
+    EXPECT_EQ(iteration.iter, ++calls);
+    return calls < 3;
+  };
+  EXPECT_TRUE(model.Fit(trace_, ws, options));
+  EXPECT_EQ(calls, 3);
+  EXPECT_EQ(ws.last_iter(), 3);
+#endif
+}
+
+TEST_F(TestGaussianHmm, TestDecodeSeparatedStates) {
+  Eigen::VectorXd init_p(2);
+  init_p << 0.5, 0.5;
+  Eigen::MatrixXd trans_p(2, 2);
+  trans_p << 0.9, 0.1, 0.1, 0.9;
+  Eigen::MatrixXd mean(1, 2);
+  mean << -10, 10;
+  GaussianHmm model(init_p, trans_p, Eigen::MatrixXd::Ones(2, 1), mean,
+                    Eigen::MatrixXd::Ones(1, 2));
+  RealTrace trace("-9.5,-10.2,9.8,10.1,10.4,-10.0");
+  GaussianHmmWorkspace ws;
+  auto path = model.Decode(trace, ws);
+  EXPECT_EQ(path.container(), LabelTrace("0,0,1,1,1,0").container());
+}
+
+}  // namespace
@@ -0,0 +1,234 @@
+#include "hmm.hh"
+#include "my_thread_pool.h"
+
+#include <gtest/gtest.h>
+
+#include <cmath>
+#include <future>
+#include <memory>
+#include <vector>
+
+using namespace org::mcss;
+
+namespace {
+
+// random starts from a fixed seed, so that a failure reproduces
+void SeedAndInitRandom(Hmm &model, const int &seed) {
+  model.rand().reset(seed);
+  model.dtmc().rand().reset(seed);
+  model.InitRandom();
+}
+
+class TestHmm : public testing::Test {
+protected:
+  std::unique_ptr<Hmm> model_;
+  LabelTrace trace_;
+  void SetUp() override {
+    Eigen::VectorXd init_p(2);
+    init_p << 0.6, 0.4;
+    Eigen::MatrixXd trans_p(2, 2);
+    trans_p << 0.7, 0.3, 0.4, 0.6;
+    Eigen::MatrixXd emit_p(2, 3);
+    emit_p << 0.5, 0.4, 0.1, 0.1, 0.3, 0.6;
+    model_ = std::make_unique<Hmm>(2, 3, init_p, trans_p, emit_p);
+    HmmWorkspace ws(42);
+    for (int i = 0; i < 200; i++) {
+      trace_.Append(model_->Next(ws));
+    }
+  }
+};
+
+TEST_F(TestHmm, TestPosteriorIsNormalized) {
+  HmmWorkspace ws;
+  const auto &gamma = model_->Posterior(trace_, ws);
+  ASSERT_EQ(gamma.cols(), trace_.size());
+  for (int t = 0; t < gamma.cols(); t++) {
+    EXPECT_NEAR(gamma.col(t).sum(), 1.0, 1e-12);
+  }
+}
+
+TEST_F(TestHmm, TestPosteriorMatchesBruteForceOnShortTrace) {
+  LabelTrace trace("0,2,1");
+  HmmWorkspace ws;
+  const auto &gamma = model_->Posterior(trace, ws);
+  const auto &pi = model_->dtmc().initial_p();
+  const auto &p = model_->dtmc().transition_p();
+  const auto &b = model_->emission_p();
+  Eigen::MatrixXd joint = Eigen::MatrixXd::Zero(2, 3);
+  for (int i = 0; i < 2; i++)
+    for (int j = 0; j < 2; j++)
+      for (int k = 0; k < 2; k++) {
+        auto w = pi(i) * b(i, 0) * p(i, j) * b(j, 2) * p(j, k) * b(k, 1);
+        joint(i, 0) += w;
+        joint(j, 1) += w;
+        joint(k, 2) += w;
+      }
+  auto evidence = joint.col(0).sum();
+  joint /= evidence;
+  EXPECT_TRUE(gamma.isApprox(joint, 1e-12));
+  EXPECT_NEAR(model_->LogLikelihood(trace, ws), std::log(evidence), 1e-12);
+}
+
+TEST_F(TestHmm, TestWorkspaceReuseAcrossTraceLengths) {
+  HmmWorkspace ws;
+  Eigen::MatrixXd long_gamma = model_->Posterior(trace_, ws);
+  LabelTrace short_trace("1,1,0,2");
+  model_->Posterior(short_trace, ws);
+  EXPECT_EQ(ws.gamma().cols(), 4);
+  EXPECT_TRUE(model_->Posterior(trace_, ws).isApprox(long_gamma));
+}
+
+TEST_F(TestHmm, TestConcurrentPosteriorOnSharedModel) {
+  HmmWorkspace ws;
+  Eigen::MatrixXd expected = model_->Posterior(trace_, ws);
+
+  Mylibpp::ThreadPool pool(4);
+  const Hmm &shared = *model_;
+  std::vector<std::future<Eigen::MatrixXd>> futures;
+  for (int i = 0; i < 16; i++) {
+    futures.push_back(pool.SubmitTask([&shared, this]() {
+      HmmWorkspace local_ws;
+      return Eigen::MatrixXd(shared.Posterior(trace_, local_ws));
+    }));
+  }
+  for (auto &future : futures) {
+    EXPECT_TRUE(future.get().isApprox(expected));
+  }
+}
+
+TEST_F(TestHmm, TestSegmentedForwardBackwardMatchesSequential) {
+  HmmWorkspace sim_ws(3);
+  LabelTrace trace;
+  for (int i = 0; i < 5000; i++) {
+    trace.Append(model_->Next(sim_ws));
+  }
+  HmmWorkspace ws;
+  Eigen::MatrixXd expected = model_->Posterior(trace, ws);
+
+  Mylibpp::ThreadPool pool(4);
+  HmmWorkspace segmented_ws;
+  segmented_ws.Parallelize(&pool, 7);
+  const auto &gamma = model_->Posterior(trace, segmented_ws);
+  EXPECT_LT((gamma - expected).cwiseAbs().maxCoeff(), 1e-10);
+  EXPECT_LT((segmented_ws.alpha() - ws.alpha()).cwiseAbs().maxCoeff(), 1e-10);
+  EXPECT_LT((segmented_ws.beta() - ws.beta()).cwiseAbs().maxCoeff(), 1e-8);
+
+  Hmm sequential_fit(2, 3);
+  SeedAndInitRandom(sequential_fit, 3);
+  Hmm segmented_fit(sequential_fit);
+  sequential_fit.Fit(trace, ws, 5);
+  segmented_fit.Fit(trace, segmented_ws, 5);
+  EXPECT_NEAR(segmented_ws.log_likelihood(), ws.log_likelihood(), 1e-8);
+  EXPECT_TRUE(segmented_fit.emission_p().isApprox(sequential_fit.emission_p(),
+                                                  1e-10));
+}
+
+TEST_F(TestHmm, TestFitImprovesLikelihood) {
+  Hmm test_model(2, 3);
+  SeedAndInitRandom(test_model, 1);
+  HmmWorkspace ws;
+  test_model.Fit(trace_, ws, 1);
+  auto first = ws.log_likelihood();
+  test_model.Fit(trace_, ws, 50);
+  EXPECT_GE(ws.log_likelihood(), first - 1e-9);
+  EXPECT_GT(ws.last_iter(), 0);
+}
+
+TEST_F(TestHmm, TestFitStopsOnLogLikelihoodGain) {
+  Hmm test_model(2, 3);
+  SeedAndInitRandom(test_model, 2);
+  HmmWorkspace ws;
+  FitOptions options;
+  options.eps = 0;
+  options.log_likelihood_eps = 1e-3;
+  test_model.Fit(trace_, ws, options);
+  EXPECT_LT(ws.last_iter(), options.max_iters);
+  EXPECT_EQ(ws.em_steps(), ws.last_iter());
+}
+
+TEST_F(TestHmm, TestSquaremNeedsFewerEmSteps) {
+  HmmWorkspace sim_ws(7);
+  LabelTrace trace;
+  for (int i = 0; i < 500; i++) {
+    trace.Append(model_->Next(sim_ws));
+  }
+  Eigen::VectorXd init_p(2);
+  init_p << 0.5, 0.5;
+  Eigen::MatrixXd trans_p(2, 2);
+  trans_p << 0.6, 0.4, 0.3, 0.7;
+  Eigen::MatrixXd emit_p(2, 3);
+  emit_p << 0.3, 0.3, 0.4, 0.2, 0.5, 0.3;
+  Hmm plain(2, 3, init_p, trans_p, emit_p);
+  Hmm accelerated(plain);
+
+  FitOptions options;
+  options.eps = 1e-6;
+  HmmWorkspace plain_ws;
+  plain.Fit(trace, plain_ws, options);
+  options.acceleration = FitAcceleration::kSquarem;
+  HmmWorkspace accelerated_ws;
+  accelerated.Fit(trace, accelerated_ws, options);
+
+  EXPECT_LT(accelerated_ws.em_steps(), plain_ws.em_steps());
+  EXPECT_NEAR(accelerated_ws.log_likelihood(), plain_ws.log_likelihood(),
+              1e-3 * std::abs(plain_ws.log_likelihood()));
+  for (int i = 0; i < 2; i++) {
+    EXPECT_NEAR(accelerated.dtmc().transition_p().row(i).sum(), 1.0, 1e-12);
+    EXPECT_NEAR(accelerated.emission_p().row(i).sum(), 1.0, 1e-12);
+  }
+}
+
+#ifndef MCSS_NO_FIT_OBSERVER
+TEST_F(TestHmm, TestObserverSeesEveryIterationAndCanAbort) {
+  Hmm test_model(2, 3);
+  SeedAndInitRandom(test_model, 4);
+  HmmWorkspace ws;
+  std::vector<FitIteration> iterations;
+  FitOptions options;
+  options.eps = 0;
+  options.observer = [&iterations](const FitIteration &iteration) {
+    iterations.push_back(iteration);
+    return iteration.iter < 3;
+  };
+  test_model.Fit(trace_, ws, options);
+  EXPECT_TRUE(ws.aborted());
+  EXPECT_EQ(ws.last_iter(), 3);
+  ASSERT_EQ(iterations.size(), 3);
+  for (int i = 0; i < 3; i++) {
+    EXPECT_EQ(iterations[i].iter, i + 1);
+    EXPECT_EQ(iterations[i].em_steps, 1);
+    EXPECT_GT(iterations[i].expectation.count(), 0);
+    EXPECT_GT(iterations[i].param_delta, 0);
+    EXPECT_EQ(iterations[i].workspace_held_bytes, ws.bytes());
+  }
+
+  options.acceleration = FitAcceleration::kSquarem;
+  options.max_iters = 10;
+  options.observer = [&iterations](const FitIteration &iteration) {
+    iterations.push_back(iteration);
+    return true;
+  };
+  iterations.clear();
+  test_model.Fit(trace_, ws, 5, 0);
+  EXPECT_TRUE(iterations.empty());
+  test_model.Fit(trace_, ws, options);
+  EXPECT_FALSE(ws.aborted());
+  ASSERT_FALSE(iterations.empty());
+  EXPECT_EQ(iterations[0].em_steps, 2);
+}
+#endif
+
+TEST_F(TestHmm, TestDecodeRecoversDeterministicStates) {
+  Eigen::VectorXd init_p(2);
+  init_p << 1.0, 0.0;
+  Eigen::MatrixXd trans_p(2, 2);
+  trans_p << 0.9, 0.1, 0.1, 0.9;
+  Eigen::MatrixXd emit_p(2, 2);
+  emit_p << 0.95, 0.05, 0.05, 0.95;
+  Hmm model(2, 2, init_p, trans_p, emit_p);
+  LabelTrace trace("0,0,0,1,1,1,0,0");
+  HmmWorkspace ws;
+  EXPECT_EQ(model.Decode(trace, ws).ToStr(), trace.ToStr());
+}
+
+} // namespace
@@ -0,0 +1,151 @@
+#include "hmm.hh"
+#include "hmm_kernel.hh"
+
+#include <gtest/gtest.h>
+
+#include <cmath>
+
+using namespace org::mcss;
+
+namespace {
+
+class TestHmmKernel : public testing::Test {
+protected:
+  Hmm model_{3, 4};
+  LabelTrace trace_;
+  void SetUp() override {
+    Eigen::VectorXd init_p(3);
+    init_p << 0.5, 0.3, 0.2;
+    Eigen::MatrixXd trans_p(3, 3);
+    trans_p << 0.8, 0.15, 0.05, 0.1, 0.7, 0.2, 0.1, 0.1, 0.8;
+    Eigen::MatrixXd emit_p(3, 4);
+    emit_p << 0.7, 0.1, 0.1, 0.1, 0.1, 0.7, 0.1, 0.1, 0.05, 0.05, 0.2, 0.7;
+    model_ = Hmm(3, 4, init_p, trans_p, emit_p);
+    HmmWorkspace ws(11);
+    for (int t = 0; t < 20000; t++) {
+      trace_.Append(model_.Next(ws));
+    }
+  }
+};
+
+TEST_F(TestHmmKernel, TestDoubleKernelMatchesHmm) {
+  HmmWorkspace ws;
+  HmmKernel<double> kernel(model_);
+  HmmKernelWorkspace<double> kernel_ws;
+  auto expected = model_.LogLikelihood(trace_, ws);
+  EXPECT_NEAR(kernel.LogLikelihood(trace_, kernel_ws), expected,
+              1e-12 * std::abs(expected));
+  const auto &gamma = model_.Posterior(trace_, ws);
+  EXPECT_LT((kernel.Posterior(trace_, kernel_ws) - gamma).cwiseAbs().maxCoeff(),
+            1e-12);
+}
+
+TEST_F(TestHmmKernel, TestFloatLogLikelihoodIsClose) {
+  HmmWorkspace ws;
+  HmmKernel<float> kernel(model_);
+  HmmKernelWorkspace<float> kernel_ws;
+  auto expected = model_.LogLikelihood(trace_, ws);
+  EXPECT_NEAR(kernel.LogLikelihood(trace_, kernel_ws), expected,
+              1e-5 * std::abs(expected));
+}
+
+TEST_F(TestHmmKernel, TestFloatPosteriorIsClose) {
+  HmmWorkspace ws;
+  HmmKernel<float> kernel(model_);
+  HmmKernelWorkspace<float> kernel_ws;
+  const auto &gamma = model_.Posterior(trace_, ws);
+  Eigen::MatrixXd float_gamma =
+      kernel.Posterior(trace_, kernel_ws).cast<double>();
+  EXPECT_LT((float_gamma - gamma).cwiseAbs().maxCoeff(), 1e-4);
+}
+
+// log P(path, O) under the double parameters
+double PathLogProbability(const Hmm &model, const LabelTrace &path,
+                          const LabelTrace &observation) {
+  const auto &p = model.dtmc().transition_p();
+  const auto &b = model.emission_p();
+  auto log_p = std::log(model.dtmc().initial_p()(path[0]));
+  for (size_t t = 0; t < path.size(); t++) {
+    if (t > 0) {
+      log_p += std::log(p(path[t - 1], path[t]));
+    }
+    log_p += std::log(b(path[t], observation[t]));
+  }
+  return log_p;
+}
+
+// float may break near ties the other way, but never for a worse path
+TEST_F(TestHmmKernel, TestFloatDecodeIsOptimal) {
+  HmmWorkspace ws;
+  HmmKernel<float> kernel(model_);
+  HmmKernelWorkspace<float> kernel_ws;
+  auto path = kernel.Decode(trace_, kernel_ws);
+  auto expected = model_.Decode(trace_, ws);
+  auto mismatches = 0;
+  for (size_t t = 0; t < trace_.size(); t++) {
+    mismatches += path[t] != expected[t];
+  }
+  EXPECT_LT(mismatches, trace_.size() / 100);
+  auto best = PathLogProbability(model_, expected, trace_);
+  EXPECT_NEAR(PathLogProbability(model_, path, trace_), best,
+              1e-5 * std::abs(best));
+}
+
+TEST_F(TestHmmKernel, TestMixedPrecisionFitIsClose) {
+  Hmm start(3, 4);
+  start.rand().reset(1);
+  start.dtmc().rand().reset(1);
+  start.InitRandom();
+  FitOptions options;
+  options.max_iters = 50;
+  options.eps = 0;
+  Hmm fit_double(start);
+  Hmm fit_mixed(start);
+  LabelTrace trace;
+  for (int t = 0; t < 4000; t++) {
+    trace.Append(trace_[t]);
+  }
+  HmmWorkspace ws_double, ws_mixed;
+  fit_double.Fit(trace, ws_double, options);
+  options.precision = FitPrecision::kMixed;
+  fit_mixed.Fit(trace, ws_mixed, options);
+  EXPECT_NEAR(ws_mixed.log_likelihood(), ws_double.log_likelihood(),
+              1e-6 * std::abs(ws_double.log_likelihood()));
+  EXPECT_LT((fit_mixed.dtmc().transition_p() - fit_double.dtmc().transition_p())
+                .cwiseAbs()
+                .maxCoeff(),
+            1e-3);
+  EXPECT_LT((fit_mixed.emission_p() - fit_double.emission_p())
+                .cwiseAbs()
+                .maxCoeff(),
+            1e-3);
+}
+
+TEST_F(TestHmmKernel, TestMixedPrecisionSquaremIsClose) {
+  Hmm start(3, 4);
+  start.rand().reset(2);
+  start.dtmc().rand().reset(2);
+  start.InitRandom();
+  FitOptions options;
+  options.max_iters = 50;
+  options.eps = 0;
+  options.acceleration = FitAcceleration::kSquarem;
+  Hmm fit_double(start);
+  Hmm fit_mixed(start);
+  LabelTrace trace;
+  for (int t = 0; t < 4000; t++) {
+    trace.Append(trace_[t]);
+  }
+  HmmWorkspace ws_double, ws_mixed;
+  fit_double.Fit(trace, ws_double, options);
+  options.precision = FitPrecision::kMixed;
+  fit_mixed.Fit(trace, ws_mixed, options);
+  // an extrapolation accepted in float can differ from the one accepted in
+  // double, so the two runs take different paths; the float E-step must not
+  // cost more than 1e-5 of the log-likelihood
+  EXPECT_GE(ws_mixed.log_likelihood(),
+            ws_double.log_likelihood() -
+                1e-5 * std::abs(ws_double.log_likelihood()));
+}
+
+}  // namespace
@@ -0,0 +1,119 @@
+#include "hsmm.hh"
+
+#include <gtest/gtest.h>
+
+#include <memory>
+
+using namespace org::mcss;
+
+namespace {
+
+class TestHsmm : public testing::Test {
+protected:
+  std::unique_ptr<Hsmm> model_;
+  LabelTrace trace_;
+  void SetUp() override {
+    Eigen::VectorXd init_p(2);
+    init_p << 0.6, 0.4;
+    Eigen::MatrixXd trans_p(2, 2);
+    trans_p << 0.0, 1.0, 1.0, 0.0;
+    Eigen::MatrixXd emit_p(2, 3);
+    emit_p << 0.7, 0.2, 0.1, 0.1, 0.2, 0.7;
+    Eigen::MatrixXd dur_p(2, 4);
+    dur_p << 0.1, 0.2, 0.3, 0.4, 0.5, 0.3, 0.1, 0.1;
+    model_ = std::make_unique<Hsmm>(2, 3, init_p, trans_p, emit_p, dur_p);
+    HsmmWorkspace ws(42);
+    for (int i = 0; i < 200; i++) {
+      trace_.Append(model_->Next(ws));
+    }
+  }
+};
+
+TEST_F(TestHsmm, TestPosteriorIsNormalized) {
+  HsmmWorkspace ws;
+  const auto &gamma = model_->Posterior(trace_, ws);
+  ASSERT_EQ(gamma.cols(), trace_.size());
+  for (int t = 0; t < gamma.cols(); t++) {
+    EXPECT_NEAR(gamma.col(t).sum(), 1.0, 1e-12);
+  }
+}
+
+TEST_F(TestHsmm, TestUnitDurationsMatchHmm) {
+  Eigen::VectorXd init_p(2);
+  init_p << 0.6, 0.4;
+  Eigen::MatrixXd trans_p(2, 2);
+  trans_p << 0.7, 0.3, 0.4, 0.6;
+  Eigen::MatrixXd emit_p(2, 3);
+  emit_p << 0.5, 0.4, 0.1, 0.1, 0.3, 0.6;
+  Hmm hmm(2, 3, init_p, trans_p, emit_p);
+  Hsmm hsmm(2, 3, init_p, trans_p, emit_p, Eigen::MatrixXd::Ones(2, 1));
+
+  HmmWorkspace hmm_ws;
+  const auto &expected = hmm.Posterior(trace_, hmm_ws);
+  HsmmWorkspace hsmm_ws;
+  const auto &gamma = hsmm.Posterior(trace_, hsmm_ws);
+  EXPECT_TRUE(gamma.isApprox(expected, 1e-10));
+  EXPECT_NEAR(hsmm.LogLikelihood(trace_, hsmm_ws),
+              hmm_ws.scale().head(trace_.size()).array().log().sum(), 1e-9);
+}
+
+TEST_F(TestHsmm, TestFitImprovesLogLikelihood) {
+  Eigen::VectorXd init_p(2);
+  init_p << 0.5, 0.5;
+  Eigen::MatrixXd trans_p(2, 2);
+  trans_p << 0.0, 1.0, 1.0, 0.0;
+  Eigen::MatrixXd emit_p(2, 3);
+  emit_p << 0.4, 0.3, 0.3, 0.3, 0.3, 0.4;
+  Eigen::MatrixXd dur_p = Eigen::MatrixXd::Constant(2, 4, 0.25);
+  Hsmm model(2, 3, init_p, trans_p, emit_p, dur_p);
+  HsmmWorkspace ws;
+  auto before = model.LogLikelihood(trace_, ws);
+  model.Fit(trace_, ws, 20, 1e-6);
+  EXPECT_GT(ws.log_likelihood(), before);
+  EXPECT_TRUE(model.duration_p().rowwise().sum().isOnes(1e-12));
+  EXPECT_TRUE(model.emission_p().rowwise().sum().isOnes(1e-12));
+}
+
+TEST_F(TestHsmm, TestFitOptions) {
+  Hsmm model(2, 3, 4);
+  model.InitRandom();
+  HsmmWorkspace ws;
+  FitOptions options;
+  options.acceleration = FitAcceleration::kSquarem;
+  EXPECT_FALSE(model.Fit(trace_, ws, options));
+  options.acceleration = FitAcceleration::kNone;
+  options.precision = FitPrecision::kMixed;
+  EXPECT_FALSE(model.Fit(trace_, ws, options));
+  options.precision = FitPrecision::kDouble;
+#ifndef MCSS_NO_FIT_OBSERVER
+  options.eps = 0;
+  int calls = 0;
+  options.observer = [&calls](const FitIteration &iteration) {
+    EXPECT_EQ(iteration.iter, ++calls);
+    return calls < 3;
+  };
+  EXPECT_TRUE(model.Fit(trace_, ws, options));
+  EXPECT_EQ(calls, 3);
+  EXPECT_EQ(ws.last_iter(), 3);
+#endif
+}
+
+TEST_F(TestHsmm, TestDecodeRecoversSegments) {
+  Eigen::VectorXd init_p(2);
+  init_p << 1.0, 0.0;
+  Eigen::MatrixXd trans_p(2, 2);
+  trans_p << 0.0, 1.0, 1.0, 0.0;
+  Eigen::MatrixXd emit_p(2, 2);
+  emit_p << 0.99, 0.01, 0.01, 0.99;
+  Eigen::MatrixXd dur_p(2, 3);
+  dur_p << 0.0, 0.0, 1.0, 0.0, 1.0, 0.0;
+  Hsmm model(2, 2, init_p, trans_p, emit_p, dur_p);
+  // the fourth symbol is noise, a one-step segment is not allowed
+  LabelTrace trace("0,0,0,0,1,0,0,0,1,1");
+  HsmmWorkspace ws;
+  auto path = model.Decode(trace, ws);
+  EXPECT_EQ(path.container(),
+            LabelTrace("0,0,0,1,1,0,0,0,1,1").container());
+}
+
+}  // namespace
@@ -0,0 +1,88 @@
+#include "labelled_dtmc.hh"
+
+#include <gtest/gtest.h>
+
+#include <vector>
+
+using namespace org::mcss;
+
+namespace {
+
+class TestLabelledDtmc : public testing::Test {
+protected:
+  LabelTrace state_trace_;
+  void SetUp() override {
+    Eigen::VectorXd init_p(3);
+    init_p << 1.0, 0, 0;
+    Eigen::MatrixXd trans_p(3, 3);
+    trans_p << 0.1, 0.4, 0.5, 0.7, 0.3, 0, 0.8, 0, 0.2;
+    Dtmc dtmc(3, init_p, trans_p);
+    dtmc.rand().reset(1);
+    for (int i = 0; i < 500; i++) {
+      state_trace_.Append(dtmc.Next());
+    }
+  }
+};
+
+TEST_F(TestLabelledDtmc, TestFitKeepsLabelMapThroughBaseClass) {
+  LabelledDtmc model(3, 2, {0, 1, 1});
+  model.dtmc().rand().reset(2);
+  model.dtmc().InitRandom();
+  Eigen::MatrixXd label_map = model.emission_p();
+  Eigen::VectorXd init_p(3);
+  init_p << 1.0, 0, 0;
+  model.initial_p(init_p);
+
+  LabelTrace trace;
+  for (int t = 0; t < state_trace_.size(); t++) {
+    trace.Append(state_trace_[t] == 0 ? 0 : 1);
+  }
+  Hmm &base = model;
+  HmmWorkspace ws;
+  base.Fit(trace, ws, 20);
+  EXPECT_EQ(model.emission_p(), label_map);
+  EXPECT_EQ(model.dtmc().initial_p(), init_p);
+  EXPECT_GT(ws.em_steps(), 0);
+}
+
+TEST_F(TestLabelledDtmc, TestOneToOneLabelsFitByCounting) {
+  LabelledDtmc model(3, 3, {2, 0, 1});
+  Eigen::VectorXd init_p(3);
+  init_p << 1.0, 0, 0;
+  model.initial_p(init_p);
+
+  std::vector<int> label_of_state = {2, 0, 1};
+  LabelTrace trace;
+  Eigen::MatrixXd counts = Eigen::MatrixXd::Zero(3, 3);
+  for (int t = 0; t < state_trace_.size(); t++) {
+    trace.Append(label_of_state[state_trace_[t]]);
+    if (t > 0) {
+      counts(state_trace_[t - 1], state_trace_[t]) += 1;
+    }
+  }
+  HmmWorkspace ws;
+  model.Fit(trace, ws);
+  Eigen::MatrixXd expected =
+      counts.array().colwise() / counts.rowwise().sum().array();
+  EXPECT_TRUE(model.dtmc().transition_p().isApprox(expected));
+  EXPECT_EQ(ws.em_steps(), 0);
+
+  // the closed form agrees with the likelihood of the forward pass
+  LabelledDtmc general(3, 3, {2, 0, 1});
+  general.initial_p(init_p);
+  general.dtmc().transition_p(expected);
+  HmmWorkspace general_ws;
+  general.Hmm::Fit(trace, general_ws, FitOptions{0});
+  EXPECT_NEAR(ws.log_likelihood(), general_ws.log_likelihood(), 1e-8);
+}
+
+TEST_F(TestLabelledDtmc, TestCountingOnEmptyTraceKeepsModel) {
+  LabelledDtmc model(3, 3, {2, 0, 1});
+  Eigen::MatrixXd transition_p = model.dtmc().transition_p();
+  HmmWorkspace ws;
+  model.Fit(LabelTrace(), ws);
+  EXPECT_EQ(model.dtmc().transition_p(), transition_p);
+  EXPECT_EQ(ws.last_iter(), 0);
+}
+
+} // namespace
@@ -0,0 +1,91 @@
+#include "logger.hh"
+
+#include <gtest/gtest.h>
+
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace org::mcss;
+
+namespace {
+
+class TestLogger : public testing::Test {
+protected:
+  std::string log_file_;
+  void SetUp() override {
+    // one file per test, ctest may run them in parallel
+    log_file_ = testing::TempDir() + "test_logger_" +
+                testing::UnitTest::GetInstance()->current_test_info()->name() +
+                ".log";
+    std::remove(log_file_.c_str());
+  }
+  void TearDown() override { std::remove(log_file_.c_str()); }
+
+  std::vector<std::string> ReadLines() {
+    std::ifstream ifs(log_file_);
+    std::vector<std::string> lines;
+    for (std::string line; std::getline(ifs, line);) {
+      lines.push_back(line);
+    }
+    return lines;
+  }
+};
+
+TEST_F(TestLogger, TestDeferredFormatting) {
+  Logger logger(log_file_);
+  logger.LogInfo("iteration ", 3, " loglik ", -12.5, " done ", true);
+  logger.LogError(std::string("bad"), ' ', 'x');
+  logger.Dump();
+  auto lines = ReadLines();
+  ASSERT_EQ(lines.size(), 2);
+  EXPECT_NE(lines[0].find(" : [INFO] iteration 3 loglik -12.5 done true"),
+            std::string::npos);
+  EXPECT_NE(lines[1].find(" : [ERROR] bad x"), std::string::npos);
+}
+
+TEST_F(TestLogger, TestLongMessageIsNotTruncated) {
+  Logger logger(log_file_);
+  std::string long_mesg(5000, 'a');
+  logger.LogInfo("head ", long_mesg, " tail ", 42);
+  logger.Dump();
+  auto lines = ReadLines();
+  ASSERT_EQ(lines.size(), 1);
+  EXPECT_NE(lines[0].find("head " + long_mesg + " tail 42"), std::string::npos);
+}
+
+TEST_F(TestLogger, TestConcurrentWritersLoseNothing) {
+  const int thread_count = 4;
+  const int mesg_count = 5000;
+  {
+    Logger logger(log_file_);
+    std::vector<std::thread> threads;
+    for (int i = 0; i < thread_count; i++) {
+      threads.emplace_back([&logger, i, mesg_count]() {
+        for (int j = 0; j < mesg_count; j++) {
+          logger.LogInfo("thread ", i, " mesg ", j);
+        }
+      });
+    }
+    for (auto &thread : threads) {
+      thread.join();
+    }
+  }
+  auto lines = ReadLines();
+  ASSERT_EQ(lines.size(), thread_count * mesg_count);
+  // each thread's messages keep their order
+  std::vector<int> next(thread_count, 0);
+  for (const auto &line : lines) {
+    auto pos = line.find("thread ");
+    ASSERT_NE(pos, std::string::npos);
+    int thread, mesg;
+    ASSERT_EQ(std::sscanf(line.c_str() + pos, "thread %d mesg %d", &thread,
+                          &mesg),
+              2);
+    EXPECT_EQ(mesg, next[thread]++);
+  }
+}
+
+} // namespace
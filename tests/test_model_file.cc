@@ -0,0 +1,201 @@
+#include "model_file.hh"
+
+#include <gtest/gtest.h>
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace org::mcss;
+
+namespace {
+
+class TestModelFile : public testing::Test {
+protected:
+  Eigen::VectorXd init_p_;
+  Eigen::MatrixXd trans_p_;
+  Eigen::MatrixXd emit_p_;
+  std::string path_;
+  void SetUp() override {
+    init_p_.resize(3);
+    init_p_ << 0.5, 0.3, 0.2;
+    trans_p_.resize(3, 3);
+    trans_p_ << 0.1, 0.6, 0.3, 0.0, 0.5, 0.5, 0.7, 0.2, 0.1;
+    emit_p_.resize(3, 2);
+    emit_p_ << 0.9, 0.1, 0.4, 0.6, 0.25, 0.75;
+    path_ = testing::TempDir() + "test_model_file.bin";
+  }
+  void TearDown() override { std::remove(path_.c_str()); }
+};
+
+TEST_F(TestModelFile, TestDtmcRoundTrip) {
+  Dtmc dtmc(3, init_p_, trans_p_);
+  ASSERT_TRUE(ModelFile::Save(path_, dtmc));
+  ModelFile file;
+  ASSERT_TRUE(file.Open(path_));
+  EXPECT_EQ(file.kind(), ModelKind::kDtmc);
+  EXPECT_EQ(file.state_count(), 3);
+  EXPECT_EQ(file.alphabet_count(), 0);
+  EXPECT_EQ(file.initial_p(), init_p_);
+  EXPECT_EQ(file.transition_p(), trans_p_);
+  EXPECT_EQ(file.log_transition_p(), Eigen::MatrixXd(trans_p_.array().log()));
+  EXPECT_EQ(file.emission_p().size(), 0);
+  EXPECT_EQ(file.LoadHmm(), nullptr);
+  auto loaded = file.LoadDtmc();
+  EXPECT_EQ(loaded->transition_p(), trans_p_);
+}
+
+TEST_F(TestModelFile, TestHmmRoundTrip) {
+  Hmm hmm(3, 2, init_p_, trans_p_, emit_p_);
+  ASSERT_TRUE(ModelFile::Save(path_, hmm));
+  ModelFile file;
+  ASSERT_TRUE(file.Open(path_));
+  EXPECT_EQ(file.kind(), ModelKind::kHmm);
+  EXPECT_EQ(file.emission_p(), emit_p_);
+  EXPECT_EQ(file.log_emission_p(), Eigen::MatrixXd(emit_p_.array().log()));
+  EXPECT_EQ(file.LoadLabelledDtmc(), nullptr);
+  auto loaded = file.LoadHmm();
+  ASSERT_NE(loaded, nullptr);
+  EXPECT_EQ(loaded->dtmc().initial_p(), init_p_);
+  EXPECT_EQ(loaded->dtmc().transition_p(), trans_p_);
+  EXPECT_EQ(loaded->emission_p(), emit_p_);
+}
+
+TEST_F(TestModelFile, TestLabelledDtmcRoundTrip) {
+  LabelledDtmc model(3, 2, {0, 1, 1});
+  model.initial_p(init_p_);
+  model.dtmc().transition_p(trans_p_);
+  ASSERT_TRUE(ModelFile::Save(path_, model));
+  ModelFile file;
+  ASSERT_TRUE(file.Open(path_));
+  EXPECT_EQ(file.kind(), ModelKind::kLabelledDtmc);
+  EXPECT_EQ(std::vector<int>(file.labels().data(),
+                             file.labels().data() + file.labels().size()),
+            std::vector<int>({0, 1, 1}));
+  auto loaded = file.LoadLabelledDtmc();
+  ASSERT_NE(loaded, nullptr);
+  EXPECT_EQ(loaded->dtmc().transition_p(), trans_p_);
+  EXPECT_EQ(loaded->emission_p(), model.emission_p());
+}
+
+TEST_F(TestModelFile, TestAliasSamplingMatchesDistribution) {
+  Hmm hmm(3, 2, init_p_, trans_p_, emit_p_);
+  ASSERT_TRUE(ModelFile::Save(path_, hmm));
+  ModelFile file;
+  ASSERT_TRUE(file.Open(path_));
+  MarkovRandom rand(7);
+  const int n = 100000;
+  Eigen::MatrixXd frequency = Eigen::MatrixXd::Zero(3, 3);
+  Eigen::VectorXd initial = Eigen::VectorXd::Zero(3);
+  for (int i = 0; i < n; i++) {
+    initial(file.SampleInitial(rand)) += 1.0 / n;
+    for (int s = 0; s < 3; s++) {
+      frequency(s, file.SampleTransition(s, rand)) += 1.0 / n;
+    }
+  }
+  EXPECT_TRUE(initial.isApprox(init_p_, 1e-2));
+  EXPECT_LT((frequency - trans_p_).cwiseAbs().maxCoeff(), 1e-2);
+  EXPECT_EQ(frequency(1, 0), 0);
+}
+
+TEST_F(TestModelFile, TestRejectsDamagedFiles) {
+  ModelFile file;
+  EXPECT_FALSE(file.Open(path_ + ".missing"));
+
+  Hmm hmm(3, 2, init_p_, trans_p_, emit_p_);
+  ASSERT_TRUE(ModelFile::Save(path_, hmm));
+  std::vector<char> bytes;
+  {
+    std::ifstream in(path_, std::ios::binary);
+    bytes.assign(std::istreambuf_iterator<char>(in), {});
+  }
+  auto rewrite = [this](const std::vector<char> &b) {
+    std::ofstream out(path_, std::ios::binary | std::ios::trunc);
+    out.write(b.data(), b.size());
+  };
+
+  auto truncated = bytes;
+  truncated.resize(bytes.size() - 64);
+  rewrite(truncated);
+  EXPECT_FALSE(file.Open(path_));
+
+  auto other_version = bytes;
+  other_version[offsetof(ModelHeader, version)] += 1;
+  rewrite(other_version);
+  EXPECT_FALSE(file.Open(path_));
+
+  auto bad_magic = bytes;
+  bad_magic[0] = 'X';
+  rewrite(bad_magic);
+  EXPECT_FALSE(file.Open(path_));
+  EXPECT_FALSE(file.is_open());
+
+  rewrite(bytes);
+  EXPECT_TRUE(file.Open(path_));
+}
+
+TEST_F(TestModelFile, TestRejectsIndicesOutOfRange) {
+  LabelledDtmc model(3, 2, {0, 1, 1});
+  model.initial_p(init_p_);
+  model.dtmc().transition_p(trans_p_);
+  ASSERT_TRUE(ModelFile::Save(path_, model));
+  std::vector<char> bytes;
+  {
+    std::ifstream in(path_, std::ios::binary);
+    bytes.assign(std::istreambuf_iterator<char>(in), {});
+  }
+  // overwrite the first entry of a section of the saved file
+  auto corrupt = [this, &bytes](const SectionId &id, const int32_t &value) {
+    ModelHeader header;
+    std::memcpy(&header, bytes.data(), sizeof(header));
+    auto damaged = bytes;
+    for (uint32_t i = 0; i < header.section_count; i++) {
+      ModelSection section;
+      std::memcpy(&section,
+                  bytes.data() + sizeof(header) + i * sizeof(section),
+                  sizeof(section));
+      if (section.id == static_cast<uint32_t>(id)) {
+        std::memcpy(damaged.data() + section.offset, &value, sizeof(value));
+      }
+    }
+    std::ofstream out(path_, std::ios::binary | std::ios::trunc);
+    out.write(damaged.data(), damaged.size());
+  };
+
+  ModelFile file;
+  corrupt(SectionId::kLabels, 2);
+  EXPECT_FALSE(file.Open(path_));
+  corrupt(SectionId::kLabels, -1);
+  EXPECT_FALSE(file.Open(path_));
+  corrupt(SectionId::kTransitionAlias, 3);
+  EXPECT_FALSE(file.Open(path_));
+  corrupt(SectionId::kEmissionAlias, 2);
+  EXPECT_FALSE(file.Open(path_));
+  corrupt(SectionId::kLabels, 1);
+  EXPECT_TRUE(file.Open(path_));
+}
+
+TEST_F(TestModelFile, TestConcurrentSavesToOnePath) {
+  Hmm hmm(3, 2, init_p_, trans_p_, emit_p_);
+  std::vector<std::thread> writers;
+  std::vector<int> saved(4, 0);
+  for (int k = 0; k < 4; k++) {
+    writers.emplace_back([&, k]() {
+      for (int i = 0; i < 20; i++) {
+        saved[k] += ModelFile::Save(path_, hmm);
+      }
+    });
+  }
+  for (auto &writer : writers) {
+    writer.join();
+  }
+  EXPECT_EQ(saved, std::vector<int>(4, 20));
+  ModelFile file;
+  ASSERT_TRUE(file.Open(path_));
+  EXPECT_EQ(file.emission_p(), emit_p_);
+}
+
+}  // namespace
@@ -0,0 +1,174 @@
+#include "model_registry.hh"
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <cmath>
+#include <memory>
+#include <thread>
+#include <vector>
+
+using namespace org::mcss;
+
+namespace {
+
+// counts the models still alive
+class CountedHmm : public Hmm {
+public:
+  static std::atomic<int> alive;
+  CountedHmm(const Hmm &model) : Hmm(model) { alive++; }
+  ~CountedHmm() override { alive--; }
+};
+std::atomic<int> CountedHmm::alive = 0;
+
+class TestModelRegistry : public testing::Test {
+protected:
+  Hmm model_{3, 2};
+  LabelTrace trace_;
+  void SetUp() override {
+    model_.InitRandom();
+    HmmWorkspace ws(5);
+    for (int t = 0; t < 200; t++) {
+      trace_.Append(model_.Next(ws));
+    }
+  }
+};
+
+TEST_F(TestModelRegistry, TestPublishAndRemove) {
+  ModelRegistry registry;
+  EXPECT_EQ(registry.Acquire().version(), 0);
+  registry.Publish("a", std::make_shared<Hmm>(model_));
+  registry.Publish("b", std::make_shared<Hmm>(model_));
+  {
+    auto snapshot = registry.Acquire();
+    EXPECT_EQ(snapshot.version(), 2);
+    ASSERT_NE(snapshot.find("a"), nullptr);
+    EXPECT_EQ(snapshot.find("a")->state_count(), 3);
+    EXPECT_EQ(snapshot.find("c"), nullptr);
+  }
+  EXPECT_TRUE(registry.Remove("a"));
+  EXPECT_FALSE(registry.Remove("a"));
+  auto snapshot = registry.Acquire();
+  EXPECT_EQ(snapshot.version(), 3);
+  EXPECT_EQ(snapshot.find("a"), nullptr);
+  EXPECT_NE(snapshot.find("b"), nullptr);
+}
+
+TEST_F(TestModelRegistry, TestConditionalPublish) {
+  ModelRegistry registry;
+  // 0 expects no model under the name
+  EXPECT_EQ(registry.Publish("a", std::make_shared<Hmm>(model_), 0), 1);
+  EXPECT_EQ(registry.Publish("a", std::make_shared<Hmm>(model_), 0), 0);
+  registry.Publish("b", std::make_shared<Hmm>(model_));
+  // other names do not matter
+  EXPECT_EQ(registry.Acquire().version("a"), 1);
+  EXPECT_EQ(registry.Publish("a", std::make_shared<Hmm>(model_), 1), 3);
+  EXPECT_EQ(registry.Publish("a", std::make_shared<Hmm>(model_), 1), 0);
+  EXPECT_TRUE(registry.Remove("a"));
+  EXPECT_EQ(registry.Acquire().version("a"), 0);
+  EXPECT_EQ(registry.Publish("a", std::make_shared<Hmm>(model_), 3), 0);
+}
+
+TEST_F(TestModelRegistry, TestRacingWritersLoseNoUpdate) {
+  ModelRegistry registry;
+  registry.Publish("a", std::make_shared<Hmm>(model_));
+  // every writer reads the model, releases the snapshot and publishes on
+  // top of what it read; a publish that lands is never lost
+  std::atomic<int> published = 0;
+  std::atomic<int> lost = 0;
+  std::vector<std::thread> writers;
+  for (int k = 0; k < 4; k++) {
+    writers.emplace_back([&]() {
+      for (int i = 0; i < 200; i++) {
+        std::shared_ptr<Hmm> next;
+        uint64_t expected;
+        {
+          auto snapshot = registry.Acquire();
+          next = std::make_shared<Hmm>(*snapshot.find("a"));
+          expected = snapshot.version("a");
+        }
+        auto version = registry.Publish("a", next, expected);
+        if (version) {
+          // nothing was published in between
+          lost += version != expected + 1;
+          published++;
+        }
+      }
+    });
+  }
+  for (auto &writer : writers) {
+    writer.join();
+  }
+  EXPECT_GT(published, 0);
+  EXPECT_EQ(lost, 0);
+  auto snapshot = registry.Acquire();
+  EXPECT_EQ(snapshot.version(), published + 1);
+  EXPECT_EQ(snapshot.version("a"), snapshot.version());
+}
+
+TEST_F(TestModelRegistry, TestSnapshotKeepsReplacedModel) {
+  CountedHmm::alive = 0;
+  {
+    ModelRegistry registry;
+    registry.Publish("a", std::make_shared<CountedHmm>(model_));
+    auto snapshot = registry.Acquire();
+    const auto *old_model = snapshot.find("a");
+    registry.Publish("a", std::make_shared<CountedHmm>(model_));
+    EXPECT_EQ(CountedHmm::alive, 2);
+    EXPECT_EQ(snapshot.find("a"), old_model);
+    EXPECT_NE(registry.Acquire().find("a"), old_model);
+    EXPECT_EQ(registry.Reclaim(), 1);
+    { auto released = std::move(snapshot); }
+    EXPECT_EQ(registry.Reclaim(), 0);
+    EXPECT_EQ(CountedHmm::alive, 1);
+  }
+  EXPECT_EQ(CountedHmm::alive, 0);
+}
+
+TEST_F(TestModelRegistry, TestReadersDuringRefits) {
+  CountedHmm::alive = 0;
+  {
+    ModelRegistry registry;
+    registry.Publish("a", std::make_shared<CountedHmm>(model_));
+    std::atomic<bool> done = false;
+    std::atomic<int> failures = 0;
+    std::vector<std::thread> readers;
+    for (int k = 0; k < 4; k++) {
+      readers.emplace_back([&]() {
+        HmmWorkspace ws;
+        uint64_t last_version = 0;
+        while (!done) {
+          auto snapshot = registry.Acquire();
+          const auto *model = snapshot.find("a");
+          if (!model || snapshot.version() < last_version ||
+              !std::isfinite(model->LogLikelihood(trace_, ws))) {
+            failures++;
+          }
+          last_version = snapshot.version();
+        }
+      });
+    }
+    // refit a copy of the published model and swap it in
+    HmmWorkspace ws;
+    for (int i = 0; i < 50; i++) {
+      std::shared_ptr<CountedHmm> next;
+      {
+        auto snapshot = registry.Acquire();
+        next = std::make_shared<CountedHmm>(*snapshot.find("a"));
+      }
+      next->Fit(trace_, ws, 2, 0);
+      registry.Publish("a", next);
+    }
+    done = true;
+    for (auto &reader : readers) {
+      reader.join();
+    }
+    EXPECT_EQ(failures, 0);
+    EXPECT_EQ(registry.Acquire().version(), 51);
+    EXPECT_EQ(registry.Reclaim(), 0);
+    EXPECT_EQ(CountedHmm::alive, 1);
+  }
+  EXPECT_EQ(CountedHmm::alive, 0);
+}
+
+}  // namespace
@@ -2,9 +2,16 @@
 
 #include <gtest/gtest.h>
 
+#ifdef __linux__
+#include <sched.h>
+#endif
+
 #include <chrono>
 #include <memory>
+#include <mutex>
+#include <set>
 #include <thread>
+#include <vector>
 
 namespace {
 
@@ -55,4 +62,122 @@ TEST_F(TestMyThreadPool, TestSubmitTaskCaptureReference) {
   EXPECT_EQ(sum_1, sum_2);
 }
 
+TEST(TestThreadPoolPlacement, TestParseCpuList) {
+  EXPECT_EQ(Mylibpp::ParseCpuList("0-3,8,10-11\n"),
+            std::vector<int>({0, 1, 2, 3, 8, 10, 11}));
+  EXPECT_EQ(Mylibpp::ParseCpuList("5"), std::vector<int>({5}));
+  EXPECT_TRUE(Mylibpp::ParseCpuList("\n").empty());
+}
+
+TEST(TestThreadPoolPlacement, TestWorkerStartHookRunsOnEveryWorker) {
+  std::mutex lock;
+  std::vector<std::thread::id> hook_threads(3);
+  std::set<int> nodes;
+  Mylibpp::PoolOptions options;
+  options.pool_size = 3;
+  options.numa = true;
+  options.on_worker_start = [&](const int &worker, const int &node) {
+    std::lock_guard<std::mutex> guard(lock);
+    hook_threads[worker] = std::this_thread::get_id();
+    nodes.insert(node);
+  };
+  Mylibpp::ThreadPool pool(options);
+  // every hook has run once the constructor returns
+  std::set<std::thread::id> distinct(hook_threads.begin(), hook_threads.end());
+  EXPECT_EQ(distinct.size(), 3);
+  EXPECT_EQ(distinct.count(std::thread::id()), 0);
+  EXPECT_LE(*nodes.rbegin(), pool.node_count() - 1);
+
+  // tasks run on the thread that ran the worker's hook
+  EXPECT_EQ(Mylibpp::ThreadPool::CurrentWorker(), -1);
+  for (int i = 0; i < 10; i++) {
+    auto worker = pool.SubmitTask([&]() {
+      auto worker = Mylibpp::ThreadPool::CurrentWorker();
+      EXPECT_EQ(hook_threads[worker], std::this_thread::get_id());
+      return worker;
+    });
+    auto index = worker.get();
+    EXPECT_GE(index, 0);
+    EXPECT_LT(index, 3);
+  }
+}
+
+TEST(TestThreadPoolPlacement, TestSubmitTaskOnEveryNode) {
+  Mylibpp::PoolOptions options;
+  options.pool_size = 2;
+  options.numa = true;
+  Mylibpp::ThreadPool pool(options);
+  ASSERT_GE(pool.node_count(), 1);
+  std::vector<std::future<int>> results;
+  for (int node = 0; node < pool.node_count(); node++) {
+    for (int i = 0; i < 4; i++) {
+      results.push_back(pool.SubmitTaskOnNode(node, [](int i) { return i; }, i));
+    }
+  }
+  auto sum = 0;
+  for (auto &result : results) {
+    sum += result.get();
+  }
+  EXPECT_EQ(sum, 6 * pool.node_count());
+  EXPECT_EQ(pool.GetTaskCount(), 0);
+}
+
+TEST(TestThreadPoolPlacement, TestZeroMeansAllCpusOnlyWithOptions) {
+  Mylibpp::ThreadPool legacy(0);
+  EXPECT_EQ(legacy.pool_size(), 0);
+  Mylibpp::ThreadPool placed{Mylibpp::PoolOptions()};
+  EXPECT_EQ(placed.pool_size(), Mylibpp::AllowedCpus().size());
+}
+
+TEST(TestThreadPoolPlacement, TestEveryNodeHasAWorker) {
+  Mylibpp::PoolOptions options;
+  options.pool_size = 1;
+  options.numa = true;
+  Mylibpp::ThreadPool pool(options);
+  EXPECT_EQ(pool.node_count(), 1);
+  // tasks for any node still run
+  EXPECT_EQ(pool.SubmitTaskOnNode(3, []() { return 7; }).get(), 7);
+}
+
+TEST(TestThreadPoolPlacement, TestManySubmittersAndNodes) {
+  Mylibpp::PoolOptions options;
+  options.pool_size = 4;
+  Mylibpp::ThreadPool pool(options);
+  std::atomic<int> sum = 0;
+  std::vector<std::thread> submitters;
+  for (int k = 0; k < 4; k++) {
+    submitters.emplace_back([&pool, &sum, k]() {
+      std::vector<std::future<void>> done;
+      for (int i = 0; i < 500; i++) {
+        done.push_back(pool.SubmitTaskOnNode(k + i, [&sum]() { sum++; }));
+      }
+      for (auto &d : done) {
+        d.get();
+      }
+    });
+  }
+  for (auto &submitter : submitters) {
+    submitter.join();
+  }
+  EXPECT_EQ(sum, 2000);
+  EXPECT_EQ(pool.GetTaskCount(), 0);
+}
+
+#ifdef __linux__
+TEST(TestThreadPoolPlacement, TestPinnedWorkersStayOnTheirCpu) {
+  Mylibpp::PoolOptions options;
+  options.pin = true;
+  options.numa = true;
+  Mylibpp::ThreadPool pool(options);
+  EXPECT_EQ(pool.pool_size(), Mylibpp::AllowedCpus().size());
+  for (int i = 0; i < 2 * pool.pool_size(); i++) {
+    auto placed = pool.SubmitTask([&pool]() {
+      auto worker = Mylibpp::ThreadPool::CurrentWorker();
+      return pool.worker_cpu(worker) == sched_getcpu();
+    });
+    EXPECT_TRUE(placed.get());
+  }
+}
+#endif
+
 } // namespace
\ No newline at end of file
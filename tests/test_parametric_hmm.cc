@@ -0,0 +1,160 @@
+#include "birth_death_chain.hh"
+#include "dtmc.hh"
+#include "my_thread_pool.h"
+#include "parametric_hmm.hh"
+#include "trace_pipeline.hh"
+
+#include <gtest/gtest.h>
+
+#include <cmath>
+#include <vector>
+
+using namespace org::mcss;
+
+namespace {
+
+LabelTrace SimulateChain(const Eigen::VectorXd &theta, const int &T,
+                         const int &seed) {
+  HmmParameters value;
+  value.Resize(3, 2);
+  BuildBirthDeathChain(theta, value, nullptr);
+  Dtmc dtmc(3, value.initial_p, value.transition_p);
+  dtmc.rand().reset(seed);
+  LabelTrace states;
+  for (int t = 0; t < T; t++) {
+    states.Append(dtmc.Next());
+  }
+  TracePipeline pipeline({0, 1, 1}, 2);
+  LabelTrace labels;
+  TraceStats stats;
+  pipeline.Run(states, labels, stats);
+  return labels;
+}
+
+class TestParametricHmm : public testing::Test {
+protected:
+  std::unique_ptr<Hmm> model_;
+  LabelTrace trace_;
+  void SetUp() override {
+    Eigen::VectorXd init_p(3);
+    init_p << 0.5, 0.3, 0.2;
+    Eigen::MatrixXd trans_p(3, 3);
+    // the zero entry still gets a gradient
+    trans_p << 0.7, 0.3, 0, 0.2, 0.5, 0.3, 0.1, 0.4, 0.5;
+    Eigen::MatrixXd emit_p(3, 4);
+    emit_p << 0.4, 0.3, 0.2, 0.1, 0.1, 0.2, 0.3, 0.4, 0.25, 0.25, 0.25, 0.25;
+    model_ = std::make_unique<Hmm>(3, 4, init_p, trans_p, emit_p);
+    HmmWorkspace ws(7);
+    for (int i = 0; i < 1000; i++) {
+      trace_.Append(model_->Next(ws));
+    }
+  }
+
+  // central difference of log P(O) along one raw entry
+  template <typename TGet, typename TSet>
+  double Difference(TGet get, TSet set, const int &i, const int &j) {
+    const double h = 1e-6;
+    HmmWorkspace ws;
+    auto m = get();
+    m(i, j) += h;
+    set(m);
+    auto up = model_->LogLikelihood(trace_, ws);
+    m(i, j) -= 2 * h;
+    set(m);
+    auto down = model_->LogLikelihood(trace_, ws);
+    m(i, j) += h;
+    set(m);
+    return (up - down) / (2 * h);
+  }
+};
+
+TEST_F(TestParametricHmm, TestGradientMatchesFiniteDifferences) {
+  HmmWorkspace ws;
+  auto log_likelihood = model_->LogLikelihoodGradient(trace_, ws);
+  EXPECT_NEAR(log_likelihood, model_->LogLikelihood(trace_, ws), 1e-9);
+  auto gradient = ws.grad_initial();
+  auto grad_transition = ws.grad_transition();
+  auto grad_emission = ws.grad_emission();
+
+  auto &dtmc = model_->dtmc();
+  for (int i = 0; i < 3; i++) {
+    EXPECT_NEAR(gradient(i),
+                Difference([&]() -> Eigen::MatrixXd { return dtmc.initial_p(); },
+                           [&](const Eigen::MatrixXd &m) { dtmc.initial_p(m); },
+                           i, 0),
+                1e-4 * std::abs(gradient(i)) + 1e-4);
+    for (int j = 0; j < 3; j++) {
+      EXPECT_NEAR(
+          grad_transition(i, j),
+          Difference([&]() -> Eigen::MatrixXd { return dtmc.transition_p(); },
+                     [&](const Eigen::MatrixXd &m) { dtmc.transition_p(m); },
+                     i, j),
+          1e-4 * std::abs(grad_transition(i, j)));
+    }
+    for (int o = 0; o < 4; o++) {
+      EXPECT_NEAR(
+          grad_emission(i, o),
+          Difference([&]() -> Eigen::MatrixXd { return model_->emission_p(); },
+                     [&](const Eigen::MatrixXd &m) { model_->emission_p(m); },
+                     i, o),
+          1e-4 * std::abs(grad_emission(i, o)));
+    }
+  }
+}
+
+TEST_F(TestParametricHmm, TestSegmentedGradientMatchesSequential) {
+  HmmWorkspace sequential;
+  auto expected = model_->LogLikelihoodGradient(trace_, sequential);
+  Mylibpp::ThreadPool pool(3);
+  HmmWorkspace ws;
+  ws.Parallelize(&pool, 3);
+  EXPECT_NEAR(model_->LogLikelihoodGradient(trace_, ws), expected, 1e-9);
+  EXPECT_TRUE(ws.grad_initial().isApprox(sequential.grad_initial(), 1e-9));
+  EXPECT_TRUE(
+      ws.grad_transition().isApprox(sequential.grad_transition(), 1e-9));
+  EXPECT_TRUE(ws.grad_emission().isApprox(sequential.grad_emission(), 1e-9));
+}
+
+TEST(TestParametricChain, TestChainedGradientMatchesFiniteDifferences) {
+  Eigen::Vector4d truth(0.1, 0.3, 0.2, 0.7);
+  auto trace = SimulateChain(truth, 500, 1);
+  ParametricHmm model(3, 2, 4, BuildBirthDeathChain);
+  HmmWorkspace ws;
+  Eigen::Vector4d theta(0.2, 0.2, 0.4, 0.6);
+  Eigen::VectorXd gradient;
+  model.LogLikelihood(theta, trace, ws, &gradient);
+  ASSERT_EQ(gradient.size(), 4);
+  const double h = 1e-6;
+  for (int k = 0; k < 4; k++) {
+    Eigen::VectorXd step = Eigen::Vector4d::Zero();
+    step(k) = h;
+    auto difference = (model.LogLikelihood(theta + step, trace, ws) -
+                       model.LogLikelihood(theta - step, trace, ws)) /
+                      (2 * h);
+    EXPECT_NEAR(gradient(k), difference, 1e-4 * std::abs(difference));
+  }
+  // outside the domain
+  EXPECT_TRUE(std::isinf(
+      model.LogLikelihood(Eigen::Vector4d(0.6, 0.6, 0.5, 0.5), trace, ws)));
+}
+
+TEST(TestParametricChain, TestFitRecoversRates) {
+  Eigen::Vector4d truth(0.1, 0.3, 0.2, 0.7);
+  auto trace = SimulateChain(truth, 20000, 1);
+  ParametricHmm model(3, 2, 4, BuildBirthDeathChain);
+  HmmWorkspace ws;
+  auto truth_log_likelihood = model.LogLikelihood(truth, trace, ws);
+
+  // mu_1 != mu_2 at the start, the likelihood is symmetric under swapping
+  // states 1 and 2
+  Eigen::VectorXd theta = Eigen::Vector4d(0.2, 0.2, 0.3, 0.6);
+  ASSERT_TRUE(model.Fit(trace, ws, theta));
+  EXPECT_TRUE(model.converged());
+  EXPECT_GE(model.log_likelihood(), truth_log_likelihood);
+  EXPECT_LT((theta - truth).cwiseAbs().maxCoeff(), 0.05);
+  // the model is left at the fitted rates
+  EXPECT_NEAR(model.model().dtmc().transition_p()(1, 0), theta(2), 1e-12);
+  EXPECT_LT(model.evaluations(), 100);
+}
+
+} // namespace
@@ -0,0 +1,98 @@
+#include "birth_death_chain.hh"
+#include "labelled_dtmc.hh"
+#include "my_thread_pool.h"
+#include "sweep.hh"
+
+#include <gtest/gtest.h>
+
+#include <memory>
+#include <sstream>
+#include <string>
+
+using namespace org::mcss;
+
+namespace {
+
+std::unique_ptr<Hmm> TwoStateModel(MarkovRandom &) {
+  auto model = std::make_unique<LabelledDtmc>(2, 2, std::vector<int>{0, 1});
+  Eigen::VectorXd init(2);
+  init << 1, 0;
+  Eigen::MatrixXd trans(2, 2);
+  trans << 0.5, 0.5, 0.5, 0.5;
+  model->initial_p(init);
+  model->dtmc().transition_p(trans);
+  return model;
+}
+
+class TestSweep : public testing::Test {
+protected:
+  std::vector<std::string> names_{"lambda_1", "lambda_2", "mu_1", "mu_2"};
+  Eigen::VectorXd lower_, upper_;
+  void SetUp() override {
+    lower_.resize(4);
+    lower_ << 0.1, 0.1, 0.2, 0.2;
+    upper_.resize(4);
+    upper_ << 0.4, 0.4, 0.8, 0.8;
+  }
+};
+
+TEST_F(TestSweep, TestGridEnumeratesAllPoints) {
+  auto design = SweepDesign::Grid(names_, lower_, upper_, {2, 3, 1, 2});
+  ASSERT_EQ(design.points.rows(), 12);
+  EXPECT_EQ(design.points.row(0), lower_.transpose());
+  EXPECT_DOUBLE_EQ(design.points(1, 3), 0.8);
+  EXPECT_DOUBLE_EQ(design.points(2, 1), 0.25);
+  EXPECT_DOUBLE_EQ(design.points(11, 0), 0.4);
+  EXPECT_DOUBLE_EQ(design.points(11, 2), 0.2);
+}
+
+TEST_F(TestSweep, TestRandomDesignIsInsideTheBox) {
+  auto design = SweepDesign::Random(names_, lower_, upper_, 100, 5);
+  ASSERT_EQ(design.points.rows(), 100);
+  for (int i = 0; i < 100; i++) {
+    EXPECT_TRUE((design.points.row(i).transpose().array() >= lower_.array())
+                    .all());
+    EXPECT_TRUE((design.points.row(i).transpose().array() <= upper_.array())
+                    .all());
+  }
+  EXPECT_EQ(SweepDesign::Random(names_, lower_, upper_, 100, 5).points,
+            design.points);
+}
+
+TEST_F(TestSweep, TestRunDoesNotDependOnWorkers) {
+  auto design = SweepDesign::Random(names_, lower_, upper_, 24, 3);
+  Sweep sweep(3, BuildBirthDeathTransitions, {0, 1, 1}, TwoStateModel);
+  SweepOptions options;
+  options.trace_length = 200;
+  options.seed = 11;
+  options.chunk = 5;
+  options.fit.max_iters = 50;
+  Mylibpp::ThreadPool pool(3);
+
+  options.workers = 1;
+  auto serial = sweep.Run(design, options, pool);
+  options.workers = 3;
+  auto parallel = sweep.Run(design, options, pool);
+
+  ASSERT_EQ(serial.rows(), 24);
+  ASSERT_EQ(serial.names().size(), 4u + 3u + 4u);
+  for (size_t k = 0; k < serial.names().size(); k++) {
+    EXPECT_EQ(serial.column(k), parallel.column(k)) << serial.names()[k];
+  }
+  const auto &ll = *serial.column("log_likelihood");
+  EXPECT_TRUE((ll.array() < 0).all());
+  Eigen::VectorXd row_sum = *serial.column("p_0_0") + *serial.column("p_0_1");
+  EXPECT_TRUE(row_sum.isOnes(1e-9));
+  EXPECT_EQ(*serial.column("mu_2"), design.points.col(3));
+}
+
+TEST_F(TestSweep, TestWriteCsv) {
+  SweepTable table({"a", "b"}, 2);
+  table.column(0) << 1, 2;
+  table.column(1) << 0.5, -1;
+  std::ostringstream out;
+  table.WriteCsv(out);
+  EXPECT_EQ(out.str(), "a,b\n1,0.5\n2,-1\n");
+}
+
+}  // namespace
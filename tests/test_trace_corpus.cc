@@ -0,0 +1,134 @@
+#include "hmm.hh"
+#include "trace_corpus.hh"
+
+#include <gtest/gtest.h>
+
+#include <cstdio>
+#include <fstream>
+#include <string>
+
+using namespace org::mcss;
+
+namespace {
+
+class TestTraceCorpus : public testing::Test {
+protected:
+  Hmm source_{3, 6};
+  LabelTrace trace_;
+  void SetUp() override {
+    Eigen::VectorXd init_p(3);
+    init_p << 0.5, 0.3, 0.2;
+    Eigen::MatrixXd trans_p(3, 3);
+    trans_p << 0.8, 0.15, 0.05, 0.1, 0.7, 0.2, 0.1, 0.1, 0.8;
+    Eigen::MatrixXd emit_p(3, 6);
+    emit_p << 0.5, 0.3, 0.05, 0.05, 0.05, 0.05, 0.05, 0.05, 0.4, 0.4, 0.05,
+        0.05, 0.05, 0.05, 0.05, 0.05, 0.2, 0.6;
+    source_ = Hmm(3, 6, init_p, trans_p, emit_p);
+    HmmWorkspace ws(1);
+    for (int t = 0; t < 2000; t++) {
+      trace_.Append(source_.Next(ws));
+    }
+  }
+};
+
+TEST_F(TestTraceCorpus, TestCountsAndPositions) {
+  TraceCorpus corpus;
+  ASSERT_TRUE(corpus.Assign(trace_, 6));
+  Eigen::VectorXd counts = Eigen::VectorXd::Zero(6);
+  Eigen::MatrixXd bigrams = Eigen::MatrixXd::Zero(6, 6);
+  for (size_t t = 0; t < trace_.size(); t++) {
+    counts(trace_[t]) += 1;
+    if (t > 0) {
+      bigrams(trace_[t - 1], trace_[t]) += 1;
+    }
+  }
+  EXPECT_EQ(corpus.symbol_counts(), counts);
+  EXPECT_EQ(corpus.transitions(), bigrams);
+  for (int o = 0; o < 6; o++) {
+    auto positions = corpus.positions(o);
+    ASSERT_EQ(positions.size(), counts(o));
+    for (int k = 0; k < positions.size(); k++) {
+      EXPECT_EQ(trace_[positions(k)], o);
+      if (k > 0) {
+        EXPECT_LT(positions(k - 1), positions(k));
+      }
+    }
+  }
+}
+
+TEST_F(TestTraceCorpus, TestRejectsBadTraces) {
+  TraceCorpus corpus;
+  EXPECT_FALSE(corpus.Assign(LabelTrace("0,1,6"), 6));
+  EXPECT_FALSE(corpus.Assign(LabelTrace(""), 6));
+  EXPECT_FALSE(corpus.Load("/nonexistent/trace.txt"));
+}
+
+TEST_F(TestTraceCorpus, TestLoadsTraceFile) {
+  auto path = testing::TempDir() + "test_trace_corpus.txt";
+  {
+    std::ofstream out(path);
+    out << 6 << "\n" << trace_.ToStr() << "\n";
+  }
+  TraceCorpus corpus;
+  ASSERT_TRUE(corpus.Load(path));
+  EXPECT_EQ(corpus.alphabet_count(), 6);
+  EXPECT_EQ(corpus.trace().container(), trace_.container());
+  std::remove(path.c_str());
+}
+
+TEST_F(TestTraceCorpus, TestCorpusFitMatchesTraceFit) {
+  TraceCorpus corpus;
+  ASSERT_TRUE(corpus.Assign(trace_, 6));
+  Hmm start(3, 6);
+  start.InitRandom();
+  FitOptions options;
+  options.max_iters = 20;
+  options.eps = 0;
+  Hmm on_trace(start), on_corpus(start);
+  HmmWorkspace ws;
+  on_trace.Fit(trace_, ws, options);
+  on_corpus.Fit(corpus, ws, options);
+  EXPECT_LT((on_corpus.emission_p() - on_trace.emission_p()).cwiseAbs().maxCoeff(),
+            1e-12);
+  EXPECT_LT((on_corpus.dtmc().transition_p() - on_trace.dtmc().transition_p())
+                .cwiseAbs()
+                .maxCoeff(),
+            1e-12);
+}
+
+TEST_F(TestTraceCorpus, TestCountInitialisationIsAheadOfRandom) {
+  TraceCorpus corpus;
+  ASSERT_TRUE(corpus.Assign(trace_, 6));
+  FitOptions options;
+  options.max_iters = 10;
+  options.eps = 0;
+  HmmWorkspace ws;
+  Hmm model(3, 6);
+  // fixed seeds, for the perturbation and the random starts alike
+  model.rand().reset(1);
+  ASSERT_TRUE(model.InitFromCounts(corpus));
+  ASSERT_TRUE(model.Fit(corpus, ws, options));
+  auto from_counts = ws.log_likelihood();
+  for (int k = 0; k < 4; k++) {
+    Hmm random(3, 6);
+    random.rand().reset(k + 2);
+    random.dtmc().rand().reset(k + 2);
+    random.InitRandom();
+    random.Fit(corpus, ws, options);
+    EXPECT_GT(from_counts, ws.log_likelihood());
+  }
+}
+
+TEST_F(TestTraceCorpus, TestRejectsOtherAlphabet) {
+  TraceCorpus corpus;
+  ASSERT_TRUE(corpus.Assign(trace_, 6));
+  Hmm model(3, 7);
+  model.InitRandom();
+  Hmm before(model);
+  HmmWorkspace ws;
+  EXPECT_FALSE(model.InitFromCounts(corpus));
+  EXPECT_FALSE(model.Fit(corpus, ws));
+  EXPECT_EQ(model.emission_p(), before.emission_p());
+}
+
+}  // namespace
@@ -0,0 +1,141 @@
+#include "markov_random.hh"
+#include "trace_pipeline.hh"
+
+#include <gtest/gtest.h>
+
+#include <map>
+#include <vector>
+
+using namespace org::mcss;
+
+namespace {
+
+class TestTracePipeline : public testing::Test {
+protected:
+  std::vector<int> labels_{0, 1, 2, 2, 1};
+  LabelTrace states_;
+  void SetUp() override {
+    MarkovRandom rand(3);
+    for (int t = 0; t < 2000; t++) {
+      states_.Append(rand.ChooseUniform(5));
+    }
+  }
+};
+
+TEST_F(TestTracePipeline, TestMapsAndCountsTransitions) {
+  TracePipeline pipeline(labels_, 3);
+  LabelTrace out;
+  TraceStats stats;
+  ASSERT_TRUE(pipeline.Run(states_, out, stats));
+  ASSERT_EQ(out.size(), states_.size());
+  Eigen::MatrixXd transitions = Eigen::MatrixXd::Zero(3, 3);
+  for (size_t t = 0; t < states_.size(); t++) {
+    EXPECT_EQ(out[t], labels_[states_[t]]);
+    if (t > 0) {
+      transitions(out[t - 1], out[t]) += 1;
+    }
+  }
+  EXPECT_EQ(stats.transitions(), transitions);
+  EXPECT_EQ(stats.label_counts().sum(), states_.size());
+  EXPECT_EQ(stats.position(), 2000);
+}
+
+TEST_F(TestTracePipeline, TestWindowAndStride) {
+  TracePipeline pipeline(labels_, 3);
+  pipeline.window(100, 1500);
+  pipeline.stride(7);
+  LabelTrace out;
+  TraceStats stats;
+  ASSERT_TRUE(pipeline.Run(states_, out, stats));
+  std::vector<int> expected;
+  for (int t = 100; t < 1500; t += 7) {
+    expected.push_back(labels_[states_[t]]);
+  }
+  EXPECT_EQ(out.container(), expected);
+}
+
+TEST_F(TestTracePipeline, TestCountsNgrams) {
+  TracePipeline pipeline(labels_, 3);
+  pipeline.ngram(3);
+  LabelTrace out;
+  TraceStats stats;
+  ASSERT_TRUE(pipeline.Run(states_, out, stats));
+  ASSERT_EQ(stats.ngram_counts().size(), 27);
+  Eigen::VectorXd expected = Eigen::VectorXd::Zero(27);
+  for (size_t t = 2; t < out.size(); t++) {
+    expected(out[t - 2] * 9 + out[t - 1] * 3 + out[t]) += 1;
+  }
+  EXPECT_EQ(stats.ngram_counts(), expected);
+}
+
+TEST_F(TestTracePipeline, TestChunkedPushMatchesRun) {
+  TracePipeline pipeline(labels_, 3);
+  pipeline.window(3, 1990);
+  pipeline.stride(2);
+  pipeline.ngram(2);
+  LabelTrace whole, chunked;
+  TraceStats whole_stats, chunked_stats;
+  ASSERT_TRUE(pipeline.Run(states_, whole, whole_stats));
+  pipeline.Reset(chunked_stats);
+  const auto &container = states_.container();
+  for (size_t begin = 0; begin < container.size(); begin += 333) {
+    auto count = std::min<size_t>(333, container.size() - begin);
+    ASSERT_TRUE(
+        pipeline.Push(container.data() + begin, count, chunked, chunked_stats));
+  }
+  EXPECT_EQ(chunked.container(), whole.container());
+  EXPECT_EQ(chunked_stats.transitions(), whole_stats.transitions());
+  EXPECT_EQ(chunked_stats.ngram_counts(), whole_stats.ngram_counts());
+}
+
+TEST_F(TestTracePipeline, TestRejectsUnlabelledState) {
+  TracePipeline pipeline(labels_, 3);
+  LabelTrace out;
+  TraceStats stats;
+  EXPECT_FALSE(pipeline.Run(LabelTrace("0,1,5,2"), out, stats));
+  EXPECT_FALSE(pipeline.Run(LabelTrace("0,-1"), out, stats));
+}
+
+TEST_F(TestTracePipeline, TestRejectsLabelOutsideTable) {
+  // state 4 maps past label_count
+  TracePipeline pipeline({0, 1, 2, 2, 3}, 3);
+  EXPECT_FALSE(pipeline.valid());
+  LabelTrace out;
+  TraceStats stats;
+  EXPECT_FALSE(pipeline.Run(states_, out, stats));
+  EXPECT_EQ(out.size(), 0);
+  EXPECT_EQ(stats.label_counts().sum(), 0);
+  EXPECT_TRUE(TracePipeline(labels_, 3).valid());
+}
+
+TEST_F(TestTracePipeline, TestRejectsBadSettings) {
+  TracePipeline pipeline(labels_, 3);
+  EXPECT_FALSE(pipeline.stride(0));
+  EXPECT_FALSE(pipeline.stride(-2));
+  EXPECT_FALSE(pipeline.window(10, 5));
+  EXPECT_FALSE(pipeline.window(-1, 5));
+  EXPECT_FALSE(pipeline.ngram(-1));
+  // 3^40 overflows an int64_t
+  EXPECT_FALSE(pipeline.ngram(40));
+  EXPECT_TRUE(pipeline.ngram(2));
+  // the rejected settings left the defaults in place
+  LabelTrace out;
+  TraceStats stats;
+  ASSERT_TRUE(pipeline.Run(states_, out, stats));
+  EXPECT_EQ(out.size(), states_.size());
+  EXPECT_EQ(stats.ngram_counts().size(), 9);
+}
+
+TEST_F(TestTracePipeline, TestPushSizesDefaultStats) {
+  TracePipeline pipeline(labels_, 3);
+  pipeline.ngram(2);
+  LabelTrace out, whole;
+  TraceStats stats, whole_stats;
+  const auto &states = states_.container();
+  ASSERT_TRUE(pipeline.Push(states.data(), states.size(), out, stats));
+  ASSERT_TRUE(pipeline.Run(states_, whole, whole_stats));
+  EXPECT_EQ(stats.transitions(), whole_stats.transitions());
+  EXPECT_EQ(stats.ngram_counts(), whole_stats.ngram_counts());
+}
+
+}  // namespace